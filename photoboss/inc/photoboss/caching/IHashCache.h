@@ -1,9 +1,15 @@
 #pragma once
+#include <functional>
 #include <optional>
 #include <vector>
 #include "types/CacheTypes.h"
 
 namespace photoboss {
+    // Recomputes the image hashes of stored planes, planes[i] into digests[i]
+    using PlaneRehash = std::function<void(
+        const std::vector<const QByteArray*>& planes,
+        const std::vector<HashDigest*>& digests)>;
+
     class IHashCache {
 
     public:
@@ -13,6 +19,13 @@ namespace photoboss {
             const CacheQuery& query
         ) = 0;
 
+        // Hashes of any cached file whose content digest is content and which holds
+        // every method in hashMethods
+        virtual std::optional<ContentHashes> lookupContent(
+            const ContentDigest& content,
+            const QList<QString>& hashMethods
+        ) = 0;
+
         virtual void store(
             const HashedImageResult& result,
             const QMap<QString, int>& methodVersions
@@ -21,5 +34,14 @@ namespace photoboss {
         virtual void storeBatch(
             const std::vector<std::pair<HashedImageResult, QMap<QString, int>>>& batch
         ) = 0;
+
+        // Brings rows stored by another version of a method up to
+        // methodVersions: hashes rehash can rebuild from a file's stored
+        // plane are replaced, the rest are dropped so that file misses and
+        // is read again. Returns the number of files rehashed.
+        virtual int upgradeMethods(
+            const QMap<QString, int>& methodVersions,
+            const PlaneRehash& rehash
+        ) = 0;
     };
 }
\ No newline at end of file
@@ -10,6 +10,10 @@ namespace photoboss
             return { CacheLookupResult() };
         }
 
+        std::optional<ContentHashes> lookupContent(const ContentDigest&, const QList<QString>&) override {
+            return std::nullopt;
+        }
+
         void store(const HashedImageResult&, const QMap<QString, int>&) override {
             // no-op
         }
@@ -17,5 +21,9 @@ namespace photoboss
         void storeBatch(const std::vector<std::pair<HashedImageResult, QMap<QString, int>>>&) override {
             // no-op
         }
+
+        int upgradeMethods(const QMap<QString, int>&, const PlaneRehash&) override {
+            return 0;
+        }
     };
 }
\ No newline at end of file
@@ -13,6 +13,10 @@ namespace photoboss {
         ~SqliteHashCache();
 
         CacheLookupResult lookup(const CacheQuery& query);
+
+        std::optional<ContentHashes> lookupContent(
+            const ContentDigest& content,
+            const QList<QString>& hashMethods) override;
         
         void store(
             const HashedImageResult& result,
@@ -21,6 +25,10 @@ namespace photoboss {
         void storeBatch(
             const std::vector<std::pair<HashedImageResult, QMap<QString, int>>>& batch) override;
 
+        int upgradeMethods(
+            const QMap<QString, int>& methodVersions,
+            const PlaneRehash& rehash) override;
+
         void prune(const QString& root);
 
         // Thumbnail cache
@@ -40,10 +48,20 @@ namespace photoboss {
         int readSchemaVersion();
         bool migrateStep(int version);
         bool migrate_0_to_1();
+        bool migrate_1_to_2();
+        bool migrate_2_to_3();
+        bool migrate_3_to_4();
+        bool migrate_4_to_5();
+        bool migrate_5_to_6();
+        bool migrate_6_to_7();
+        bool migrate_7_to_8();
+        bool migrate_8_to_9();
         bool ensureMethod(const QString& key, int version, int& outMethodId);
         void updateScanIdForFile(int fileId);
         void ensureOpen();
         bool storeItem(QSqlQuery& q, const HashedImageResult& result,
             const QMap<QString, int>& methodVersions);
+        bool storeFailure(QSqlQuery& q, const HashedImageResult& result);
+        std::optional<FileFailure> lookupFailure(const FileIdentity& fileIdentity);
     };
 }
@@ -1,16 +1,32 @@
 #pragma once
 #include "hashing/HashMethod.h"
+#include <algorithm>
+#include <bit>
 
 namespace photoboss {
 
     class AverageHash : public HashMethod
     {
     public:
-        QString compute(const PerceptualImage& image) override;
-        double compare(const QString& hash1, const QString& hash2) const override;
-        QString key() const override { return "Average Hash"; }
+        static constexpr HashKind Kind = HashKind::Average;
+        static constexpr HashInput Input = HashInput::Image;
+        static constexpr int Version = 0;   // bump when the output changes
+        static constexpr bool Lazy = true;  // only scored once pHash has matched
+
+        // Static interface used by the compile-time registry
+        static void hash(const PerceptualImage& image, HashDigest& digest);
+        static double similarity(const HashDigest& a, const HashDigest& b)
+        {
+            constexpr double MaxBits = 32.0;
+            const double distance = static_cast<double>(std::popcount(a.aHash ^ b.aHash));
+            return std::clamp(1.0 - (distance / MaxBits), 0.0, 1.0);
+        }
 
         // Inherited via HashMethod
-        HashInput inputType() const override;
+        HashKind kind() const override { return Kind; }
+        HashInput inputType() const override { return Input; }
+        int version() const override { return Version; }
+        void compute(const PerceptualImage& image, HashDigest& digest) override { hash(image, digest); }
+        double compare(const HashDigest& a, const HashDigest& b) const override { return similarity(a, b); }
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <QtTypes>
+
+namespace photoboss::dct {
+
+    // Low-frequency 8x8 corner of the orthonormal 32x32 DCT-II of an 8-bit
+    // plane, written row-major (vertical frequency major) into out[64].
+    //
+    // Computed in fixed point: integer arithmetic is exact, so the scalar,
+    // AVX2 and NEON paths produce bit-identical coefficients and a hash never
+    // depends on the CPU it was computed on. The SIMD path is picked once at
+    // runtime from CpuFeatures.
+    void lowFrequency8x8(const uchar* plane, int stride, qint32* out);
+
+    // Batched form: the DCTs of count planes (sharing one stride) computed
+    // as a single blocked matrix product, plane n written to out + 64 * n.
+    // Results are identical to calling lowFrequency8x8() per plane.
+    void lowFrequency8x8Batch(const uchar* const* planes, int stride, int count, qint32* out);
+
+    // The 8 symmetries of the square act on DCT-II coefficients without
+    // touching pixels: a left-right mirror negates the odd horizontal
+    // frequencies, a top-bottom mirror the odd vertical ones, and a
+    // transpose swaps the two axes. Every rotation is a composition of these.
+    enum Dihedral : int {
+        FlipHorizontal = 1,
+        FlipVertical = 2,
+        Transpose = 4   // applied before the flips
+    };
+
+    // out[64] = coefficients of the plane transformed by pose (Dihedral bits)
+    void dihedral8x8(const qint32* in, int pose, qint32* out);
+
+    // Pose that brings coeffs to a canonical orientation. All 8 orientations
+    // of one plane map to the same canonical coefficients, up to rounding.
+    int canonicalPose(const qint32* coeffs);
+
+}
@@ -2,6 +2,7 @@
 
 #include "types/DataTypes.h"
 #include "hashing/PerceptualImage.h"
+#include <vector>
 namespace photoboss
 {
     // Base class for hash / fileIdentity algorithms
@@ -10,20 +11,50 @@ namespace photoboss
     public:
         virtual ~HashMethod() = default;
 
-        virtual QString key() const = 0;
+        // Slot this method fills in HashDigest
+        virtual HashKind kind() const = 0;
         virtual HashInput inputType() const = 0;
 
-        virtual QString compute(const QByteArray&) {
+        // Persisted name (hash_methods.key)
+        virtual QString key() const { return hashKindKey(kind()); }
+
+        // Revision of this method's output (hash_methods.version). Stored
+        // rows of another version are rehashed from their planes.
+        virtual int version() const = 0;
+
+        // HashKind bits this method writes; more than kind() when one pass
+        // yields several hashes
+        virtual quint8 produces() const { return HashDigest::bit(kind()); }
+
+        // Computes this method's hash and stores it in digest
+        virtual void compute(const QByteArray&, HashDigest&) {
             throw std::logic_error("Byte input not supported");
         }
 
-        virtual QString compute(const PerceptualImage&) {
+        virtual void compute(const PerceptualImage&, HashDigest&) {
             throw std::logic_error("Image input not supported");
         }
 
-		// Compare two hashes, returning a similarity score in [0.0, 1.0]
+        // Hash several byte buffers in one call, data[i] into digests[i].
+        // The default loops over compute().
+        virtual void computeBatch(const std::vector<const QByteArray*>& data,
+            const std::vector<HashDigest*>& digests) {
+            for (size_t i = 0; i < data.size(); ++i)
+                compute(*data[i], *digests[i]);
+        }
+
+        // Hash several images in one call, images[i] into digests[i].
+        // Methods with a vectorised path override this; the default simply
+        // loops over compute().
+        virtual void computeBatch(const std::vector<const PerceptualImage*>& images,
+            const std::vector<HashDigest*>& digests) {
+            for (size_t i = 0; i < images.size(); ++i)
+                compute(*images[i], *digests[i]);
+        }
+
+		// Compare this method's slot of two digests that both hold it
         // Return similarity (1.0 = identical, 0.0 = completely different)
-		virtual double compare(const QString& hash1, const QString& hash2) const = 0;
+		virtual double compare(const HashDigest& a, const HashDigest& b) const = 0;
 
     };
-}
\ No newline at end of file
+}
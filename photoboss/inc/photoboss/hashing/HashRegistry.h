@@ -0,0 +1,191 @@
+#pragma once
+#include "hashing/Sha256Hash.h"
+#include "hashing/Xxh3Hash.h"
+#include "hashing/PerceptualHash.h"
+#include "hashing/DifferenceHash.h"
+#include "hashing/AverageHash.h"
+#include "hashing/PyramidHash.h"
+#include "util/AppSettings.h"
+#include <QList>
+#include <QMap>
+#include <type_traits>
+
+namespace photoboss::registry {
+
+    // Compile-time list of hash methods. Each method type provides
+    //   static constexpr HashKind Kind; static constexpr HashInput Input;
+    //   static constexpr int Version;
+    //   static void hash(const QByteArray& | const PerceptualImage&, HashDigest&);
+    //   static double similarity(const HashDigest&, const HashDigest&);
+    // and optionally a static hashBatch() over several inputs, a Produces mask
+    // when it writes more than its own Kind, and Lazy = true for an image
+    // method that is only computed when a comparison first needs it. The
+    // runtime HashMethod / HashCatalog path stays available for experiments.
+    template <typename... Methods>
+    struct MethodList {
+        static constexpr size_t size = sizeof...(Methods);
+
+        // Calls f.template operator()<Method>() for every method, in order
+        template <typename F>
+        static void forEach(F&& f) {
+            (f.template operator()<Methods>(), ...);
+        }
+    };
+
+    // Scoring policy per method: weight in the confidence average and a hard
+    // gate below which two images are never similar. Methods without a
+    // specialisation (the content digest) take no part in similarity scoring.
+    template <typename Method>
+    struct Scoring {
+        static constexpr bool scored = false;
+        static constexpr double weight = 0.0;
+        static constexpr double gate = 0.0;
+    };
+
+    template <>
+    struct Scoring<PerceptualHash> {
+        static constexpr bool scored = true;
+        static constexpr double weight = 0.60;
+        static constexpr double gate = settings::SimilarityPHashGate;
+    };
+
+    template <>
+    struct Scoring<DifferenceHash> {
+        static constexpr bool scored = true;
+        static constexpr double weight = 0.30;
+        static constexpr double gate = settings::SimilarityDHashGate;
+    };
+
+    template <>
+    struct Scoring<AverageHash> {
+        static constexpr bool scored = true;
+        static constexpr double weight = 0.05;
+        static constexpr double gate = 0.0;
+    };
+
+    // HashKind bits written by Method
+    template <typename Method>
+    constexpr quint8 produces()
+    {
+        if constexpr (requires { Method::Produces; })
+            return Method::Produces;
+        else
+            return HashDigest::bit(Method::Kind);
+    }
+
+    // Whether Method is left out of HashEngine's up-front pass and computed
+    // from the retained plane on demand (HashEngine::completeLazy)
+    template <typename Method>
+    constexpr bool lazy()
+    {
+        if constexpr (requires { Method::Lazy; })
+            return Method::Lazy;
+        else
+            return false;
+    }
+
+    // Exact-duplicate digest of this build
+    using ContentMethod = std::conditional_t<settings::ContentDigestXxh3, Xxh3Hash, Sha256Hash>;
+    static_assert(ContentMethod::Algorithm == ActiveContentAlgorithm);
+
+    using DefaultMethods = MethodList<ContentMethod, PerceptualHash, DifferenceHash, AverageHash, PyramidHash>;
+
+    // Persisted keys of the methods in List for which pred<Method>() holds
+    template <typename List, typename Pred>
+    QList<QString> keysWhere(Pred pred)
+    {
+        QList<QString> out;
+        List::forEach([&]<typename Method>() {
+            if (!pred.template operator()<Method>())
+                return;
+            for (int k = 0; k < HashKindCount; ++k) {
+                const auto kind = static_cast<HashKind>(k);
+                if (produces<Method>() & HashDigest::bit(kind))
+                    out.append(hashKindKey(kind));
+            }
+        });
+        return out;
+    }
+
+    // Persisted keys of every method in List
+    template <typename List>
+    QList<QString> keys()
+    {
+        return keysWhere<List>([]<typename>() { return true; });
+    }
+
+    // Keys HashEngine fills up front; a result is complete without the lazy ones
+    template <typename List>
+    QList<QString> eagerKeys()
+    {
+        return keysWhere<List>([]<typename Method>() { return !lazy<Method>(); });
+    }
+
+    template <typename List>
+    QList<QString> lazyKeys()
+    {
+        return keysWhere<List>([]<typename Method>() { return lazy<Method>(); });
+    }
+
+    // Stored version of every persisted key in List, for hash_methods.version
+    template <typename List>
+    QMap<QString, int> versions()
+    {
+        QMap<QString, int> out;
+        List::forEach([&]<typename Method>() {
+            for (int k = 0; k < HashKindCount; ++k) {
+                const auto kind = static_cast<HashKind>(k);
+                if (produces<Method>() & HashDigest::bit(kind))
+                    out.insert(hashKindKey(kind), Method::Version);
+            }
+        });
+        return out;
+    }
+
+    // Weighted similarity of two digests, 0.0 if any gate fails. Expands to
+    // straight-line code per method: no virtual calls, no key lookups.
+    // completeLazy() runs before the first lazy method is scored, i.e. only
+    // once every earlier gate has passed, and may fill in a and b.
+    template <typename List, typename CompleteLazy>
+    double confidence(const HashDigest& a, const HashDigest& b, CompleteLazy&& completeLazy)
+    {
+        double score = 0.0;
+        double weightSum = 0.0;
+        bool gated = false;
+        bool completed = false;
+
+        List::forEach([&]<typename Method>() {
+            using Policy = Scoring<Method>;
+            if constexpr (Policy::scored) {
+                if (gated)
+                    return;
+                if constexpr (lazy<Method>()) {
+                    if (!completed) {
+                        completeLazy();
+                        completed = true;
+                    }
+                }
+                if (!a.has(Method::Kind) || !b.has(Method::Kind))
+                    return;
+
+                const double sim = Method::similarity(a, b);
+                if (sim < Policy::gate) {
+                    gated = true;
+                    return;
+                }
+                score += sim * Policy::weight;
+                weightSum += Policy::weight;
+            }
+        });
+
+        if (gated) return 0.0;
+        return weightSum > 0.0 ? score / weightSum : 0.0;
+    }
+
+    template <typename List>
+    double confidence(const HashDigest& a, const HashDigest& b)
+    {
+        return confidence<List>(a, b, [] {});
+    }
+
+}
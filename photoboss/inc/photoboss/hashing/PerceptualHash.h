@@ -1,16 +1,47 @@
 #pragma once
 #include "hashing/HashMethod.h"
+#include <QtMath>
 
 namespace photoboss {
 
     class PerceptualHash : public HashMethod
     {
     public:
-        QString compute(const PerceptualImage& image) override;
-        double compare(const QString& hash1, const QString& hash2) const override;
-        QString key() const override { return "Perceptual Hash"; }
+        static constexpr HashKind Kind = HashKind::Perceptual;
+        static constexpr HashInput Input = HashInput::Image;
+        static constexpr int Version = 0;   // bump when the output changes
+
+        // The canonical-orientation pHash comes out of the same DCT
+        static constexpr quint8 Produces =
+            HashDigest::bit(HashKind::Perceptual) | HashDigest::bit(HashKind::PerceptualCanonical);
+
+        // Static interface used by the compile-time registry
+        static void hash(const PerceptualImage& image, HashDigest& digest);
+        static void hashBatch(const std::vector<const PerceptualImage*>& images,
+            const std::vector<HashDigest*>& digests);
+        static double similarity(const HashDigest& a, const HashDigest& b)
+        {
+            // XOR finds differing bits, qPopulationCount counts them
+            const int distance = qPopulationCount(a.pHash ^ b.pHash);
+            return 1.0 - (static_cast<double>(distance) / 64.0);
+        }
+
+        // Similarity regardless of rotation / mirroring. Only meaningful
+        // once similarity() has ruled out a match in the stored orientation.
+        static double canonicalSimilarity(const HashDigest& a, const HashDigest& b)
+        {
+            const int distance = qPopulationCount(a.pHashCanonical ^ b.pHashCanonical);
+            return 1.0 - (static_cast<double>(distance) / 64.0);
+        }
 
         // Inherited via HashMethod
-        HashInput inputType() const override;
+        HashKind kind() const override { return Kind; }
+        HashInput inputType() const override { return Input; }
+        int version() const override { return Version; }
+        quint8 produces() const override { return Produces; }
+        void compute(const PerceptualImage& image, HashDigest& digest) override { hash(image, digest); }
+        void computeBatch(const std::vector<const PerceptualImage*>& images,
+            const std::vector<HashDigest*>& digests) override { hashBatch(images, digests); }
+        double compare(const HashDigest& a, const HashDigest& b) const override { return similarity(a, b); }
     };
-}
\ No newline at end of file
+}
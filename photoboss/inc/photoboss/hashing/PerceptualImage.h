@@ -1,5 +1,8 @@
 #pragma once
+#include <QByteArray>
 #include <QImage>
+#include "util/AppSettings.h"
+#include "hashing/QualityKernel.h"
 
 namespace photoboss {
 
@@ -9,12 +12,30 @@ namespace photoboss {
         PerceptualImage() = delete;
 
         explicit PerceptualImage(const QImage& src);
+
+        // Bytes in plane(): the HashSampleSize x HashSampleSize luma square
+        static constexpr int PlaneSize = settings::HashSampleSize * settings::HashSampleSize;
+
+        // The normalised plane every image hash reads, row-major. Persisted
+        // so a changed method can rehash without going back to the file.
+        QByteArray plane() const;
+        // Rebuilds the image from a stored plane(); plane must be PlaneSize bytes
+        static PerceptualImage fromPlane(const QByteArray& plane);
+
+        // Sharpness and clipping of the source image, measured alongside the
+        // plane; not measured for fromPlane()
+        const quality::LumaStats& stats() const { return m_stats_; }
+
         const QImage& image() const { return m_paddedSquare_; }
         const uchar* bits() const { return m_paddedSquare_.constBits(); }
         int bytesPerLine() const { return m_paddedSquare_.bytesPerLine(); }
         double pixel(int x, int y) const;
     private:
+        struct FromPlane {};
+        PerceptualImage(FromPlane, const QByteArray& plane);
+
         QImage m_paddedSquare_;
+        quality::LumaStats m_stats_;
     };
 
 } // namespace photoboss
\ No newline at end of file
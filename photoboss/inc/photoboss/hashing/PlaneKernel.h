@@ -0,0 +1,18 @@
+#pragma once
+#include <QtTypes>
+
+namespace photoboss::plane {
+
+    // Builds the HashSampleSize x HashSampleSize Grayscale8 plane shared by
+    // the image hashes, in one pass over the decoded buffer: luma conversion,
+    // area-average downscale (aspect ratio kept) and black letterboxing are
+    // fused, so no intermediate images are allocated.
+    //
+    // src is either 32-bit xRGB (QImage::Format_RGB32 / ARGB32, alpha
+    // ignored) when bytesPerPixel == 4, or 8-bit grey when bytesPerPixel == 1.
+    // out receives HashSampleSize rows of HashSampleSize bytes. Integer-only,
+    // so the scalar, AVX2 and NEON paths agree exactly.
+    void buildLumaPlane(const uchar* src, int width, int height, int stride,
+        int bytesPerPixel, uchar* out);
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "hashing/HashMethod.h"
+#include <bit>
+
+namespace photoboss {
+
+    // Block-mean hashes over a pyramid of windows of the hash plane: the
+    // whole plane, four overlapping three-quarter windows and nine
+    // overlapping half windows (layout in PyramidDigest). Every window is
+    // cut into 8x8 blocks and each block compared with the median block, so
+    // the hash of a window and the global hash of a crop showing only that
+    // window line up bit for bit. That lets crops, bordered screenshots and
+    // re-framed exports match where the centred pHash cannot.
+    class PyramidHash : public HashMethod
+    {
+    public:
+        static constexpr HashKind Kind = HashKind::Pyramid;
+        static constexpr HashInput Input = HashInput::Image;
+        static constexpr int Version = 0;   // bump when the output changes
+
+        // Window of pyramid entry i, in plane pixels
+        struct Window { int x, y, size; };
+        static constexpr Window window(int i);
+
+        // Whether a block hash carries structure: a flat window (sky, the
+        // letterbox bars) puts nearly every block on one side of the median
+        static bool informative(quint64 hash)
+        {
+            const int bits = std::popcount(hash);
+            return bits >= 16 && bits <= 48;
+        }
+
+        // Best match of either global hash against a sub-window of the
+        // other; 0.0 if no informative pair exists. Globals are not compared
+        // with each other: same framing is the pHash's job.
+        struct CropMatch {
+            double similarity = 0.0;
+            int window = -1;           // pyramid entry that matched
+            bool aInsideB = false;     // a's global matched a window of b
+        };
+        static CropMatch cropMatch(const HashDigest& a, const HashDigest& b);
+
+        // Fine check of a cropMatch(): normalised cross-correlation of the
+        // inner image's plane with the matched window of the outer one, both
+        // resampled to 16x16. Catches block hashes that agree by accident on
+        // smooth images. Planes as PerceptualImage::plane(); -1.0 if either
+        // is missing.
+        static double planeCorrelation(const QByteArray& inner, const QByteArray& outer, int window);
+
+        // Static interface used by the compile-time registry
+        static void hash(const PerceptualImage& image, HashDigest& digest);
+        static double similarity(const HashDigest& a, const HashDigest& b)
+        {
+            return cropMatch(a, b).similarity;
+        }
+
+        // Inherited via HashMethod
+        HashKind kind() const override { return Kind; }
+        HashInput inputType() const override { return Input; }
+        int version() const override { return Version; }
+        void compute(const PerceptualImage& image, HashDigest& digest) override { hash(image, digest); }
+        double compare(const HashDigest& a, const HashDigest& b) const override { return similarity(a, b); }
+    };
+
+    constexpr PyramidHash::Window PyramidHash::window(int i)
+    {
+        constexpr int S = settings::HashSampleSize;
+        constexpr int Step = S / 4;
+        if (i == 0)
+            return { 0, 0, S };
+        if (i < 5)
+            return { ((i - 1) % 2) * Step, ((i - 1) / 2) * Step, S - Step };
+        return { ((i - 5) % 3) * Step, ((i - 5) / 3) * Step, S / 2 };
+    }
+}
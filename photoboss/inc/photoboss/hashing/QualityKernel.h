@@ -0,0 +1,19 @@
+#pragma once
+#include <QtTypes>
+
+namespace photoboss::quality {
+
+    struct LumaStats {
+        double sharpness = -1.0;   // variance of the 4-neighbour Laplacian; < 0 if too small to measure
+        double clipped = 0.0;      // fraction of pixels crushed to black or blown to white
+    };
+
+    // Sharpness and exposure clipping of a decoded image, read from the
+    // same buffer PerceptualImage builds its plane from. src is 32-bit xRGB
+    // (bytesPerPixel == 4, converted with the qGray() weights) or 8-bit grey
+    // (bytesPerPixel == 1). The border rows and columns have no full
+    // neighbourhood and are left out. Integer accumulation, so the scalar,
+    // AVX2 and NEON paths agree exactly.
+    LumaStats measure(const uchar* src, int width, int height, int stride, int bytesPerPixel);
+
+}
@@ -5,12 +5,24 @@ namespace photoboss {
     class Sha256Hash : public HashMethod
     {
     public:
-        HashInput inputType() const override { return HashInput::Bytes; }
-        QString compute(const QByteArray& data) { return computeSHA256(data); }
-        QString key() const override { return "SHA256"; }
-        double compare(const QString& hash1, const QString& hash2) const override;
-    private:
-        QString computeSHA256(const QByteArray& data);
+        static constexpr HashKind Kind = HashKind::Content;
+        static constexpr HashInput Input = HashInput::Bytes;
+        static constexpr int Version = 0;   // bump when the output changes
+        static constexpr ContentAlgorithm Algorithm = ContentAlgorithm::Sha256;
+
+        // Static interface used by the compile-time registry
+        static void hash(const QByteArray& data, HashDigest& digest);
+        static void hashBatch(const std::vector<const QByteArray*>& data,
+            const std::vector<HashDigest*>& digests);
+        static double similarity(const HashDigest& a, const HashDigest& b) { return (a.content == b.content) ? 1.0 : 0.0; }
+
+        // Inherited via HashMethod
+        HashKind kind() const override { return Kind; }
+        HashInput inputType() const override { return Input; }
+        int version() const override { return Version; }
+        void compute(const QByteArray& data, HashDigest& digest) override { hash(data, digest); }
+        void computeBatch(const std::vector<const QByteArray*>& data,
+            const std::vector<HashDigest*>& digests) override { hashBatch(data, digests); }
+        double compare(const HashDigest& a, const HashDigest& b) const override { return similarity(a, b); }
     };
 }
-
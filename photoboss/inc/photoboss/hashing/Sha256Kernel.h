@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+#include <QtTypes>
+#include "types/HashDigest.h"
+
+namespace photoboss::sha256 {
+
+    // SHA-256 (FIPS 180-4) of size bytes. Uses the SHA-NI instructions where
+    // the CPU has them and a portable scalar path otherwise; the output never
+    // depends on the path taken.
+    ContentDigest digest(const uchar* data, size_t size);
+
+    // Digests of count buffers, buffer n written to out[n]. Without SHA-NI
+    // but with AVX2, up to 8 buffers are compressed side by side, one per
+    // 32-bit lane, for as long as at least two of them still have blocks
+    // left; the remainder of the longest buffers finishes on the single
+    // buffer path.
+    void digestBatch(const uchar* const* data, const size_t* sizes, int count, ContentDigest* out);
+
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "hashing/HashMethod.h"
+#include "types/DataTypes.h"
+namespace photoboss {
+    // XXH3-128 content fingerprint: an alternative to Sha256Hash for exact
+    // duplicate detection when collision resistance against crafted input
+    // is not needed. Picked with settings::ContentDigestXxh3.
+    class Xxh3Hash : public HashMethod
+    {
+    public:
+        static constexpr HashKind Kind = HashKind::Content;
+        static constexpr HashInput Input = HashInput::Bytes;
+        static constexpr int Version = 0;   // bump when the output changes
+        static constexpr ContentAlgorithm Algorithm = ContentAlgorithm::Xxh3_128;
+
+        // Static interface used by the compile-time registry
+        static void hash(const QByteArray& data, HashDigest& digest);
+        static double similarity(const HashDigest& a, const HashDigest& b) { return (a.content == b.content) ? 1.0 : 0.0; }
+
+        // Inherited via HashMethod
+        HashKind kind() const override { return Kind; }
+        HashInput inputType() const override { return Input; }
+        int version() const override { return Version; }
+        void compute(const QByteArray& data, HashDigest& digest) override { hash(data, digest); }
+        double compare(const HashDigest& a, const HashDigest& b) const override { return similarity(a, b); }
+    };
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <cstddef>
+#include <QtTypes>
+#include "types/HashDigest.h"
+
+namespace photoboss::xxh3 {
+
+    // XXH3-128 (xxHash 0.8, seed 0, default secret) of size bytes, in the
+    // canonical big-endian order - high 64 bits first, as xxhsum prints it -
+    // in the first 16 bytes of the digest, the rest zero. Inputs past 240
+    // bytes stream through an AVX2 accumulator where the CPU has one;
+    // results are identical to the scalar path.
+    ContentDigest digest128(const uchar* data, size_t size);
+
+}
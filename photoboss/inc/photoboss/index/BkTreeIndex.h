@@ -0,0 +1,45 @@
+#pragma once
+#include <vector>
+#include "index/HashSlots.h"
+#include "index/ICandidateIndex.h"
+#include "util/AppSettings.h"
+
+namespace photoboss {
+
+    // Burkhard-Keller tree under Hamming distance: each node keeps its
+    // children by their distance to it, so a query at distance d from a node
+    // only descends into children d - r .. d + r. One node per stored hash,
+    // kept in an arena parallel to the slots, and no tables to size, so it
+    // stays small where banded buckets would fill with burst shots.
+    class BkTreeIndex : public ICandidateIndex
+    {
+    public:
+        explicit BkTreeIndex(int radius = settings::SimilarityIndexRadius);
+
+        // Inherited via ICandidateIndex
+        int radius() const override { return m_radius_; }
+        size_t size() const override { return m_slots_.liveCount(); }
+        void insert(quint32 id, quint64 hash) override;
+        void remove(quint32 id) override;
+        void clear() override;
+        void query(quint64 hash, std::vector<Match>& out) const override;
+
+    private:
+        static constexpr quint32 None = HashSlots::None;
+
+        // Node of slot i is m_nodes_[i]; slot 0 is the root. Removed slots
+        // stay as routing nodes until the next compaction.
+        struct Node {
+            quint32 firstChild = None;
+            quint32 nextSibling = None;
+            int edge = 0;               // distance to the parent
+        };
+
+        void compact();
+
+        int m_radius_;
+        HashSlots m_slots_;
+        std::vector<Node> m_nodes_;
+    };
+
+}
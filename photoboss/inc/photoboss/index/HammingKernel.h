@@ -0,0 +1,18 @@
+#pragma once
+#include <QtTypes>
+#include <cstddef>
+
+namespace photoboss::hamming {
+
+    // Hashes per mask word: a block is 64 consecutive hashes and its result
+    // one bit per hash
+    inline constexpr size_t BlockSize = 64;
+
+    // For each of `blocks` blocks of hashes, sets masks[b] bit i when hash
+    // b * BlockSize + i is within maxDistance bits of query. hashes holds
+    // blocks * BlockSize values; 64-byte alignment keeps the vector loads
+    // on one cache line. AVX-512 VPOPCNTDQ, AVX2 (nibble table) and NEON
+    // paths, picked once at startup.
+    void withinMask(const quint64* hashes, size_t blocks, quint64 query, int maxDistance, quint64* masks);
+
+}
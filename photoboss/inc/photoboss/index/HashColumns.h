@@ -0,0 +1,57 @@
+#pragma once
+#include <array>
+#include <vector>
+#include "index/HammingKernel.h"
+#include "types/HashDigest.h"
+
+namespace photoboss {
+
+    // The 64-bit hashes of a set of rows (cluster representatives), one
+    // contiguous, 64-byte aligned column per method, so a gate over every
+    // row is a single pass of the Hamming kernel instead of a digest walk
+    // per row. Rows are cluster indices and grow on set().
+    class HashColumns
+    {
+    public:
+        struct Gate {
+            HashKind kind;
+            quint64 query;
+            int maxDistance;
+            // Rows without this hash pass: the scorer skips a method one
+            // side lacks, or fills it in lazily and gates it there
+            bool absentPasses;
+        };
+
+        // Stores the 64-bit hashes digest holds; the rest become absent
+        void set(quint32 row, const HashDigest& digest);
+        void clear();
+        size_t rows() const { return m_rows_; }
+
+        // One word per hamming::BlockSize rows, bit set where the row
+        // passes every gate. No gates passes every row.
+        void filter(const std::vector<Gate>& gates, std::vector<quint64>& masks) const;
+
+        // Same test for one row
+        bool passes(quint32 row, const std::vector<Gate>& gates) const;
+
+    private:
+        struct alignas(64) Block {
+            quint64 hashes[hamming::BlockSize];
+        };
+
+        struct Column {
+            std::vector<Block> blocks;
+            std::vector<quint64> present;   // one bit per row
+        };
+
+        static constexpr std::array<HashKind, 4> Kinds = {
+            HashKind::Perceptual, HashKind::PerceptualCanonical,
+            HashKind::Difference, HashKind::Average
+        };
+        static int columnOf(HashKind kind);
+
+        std::array<Column, Kinds.size()> m_columns_;
+        size_t m_rows_ = 0;
+    };
+
+}
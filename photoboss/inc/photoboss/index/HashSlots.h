@@ -0,0 +1,86 @@
+#pragma once
+#include <QtTypes>
+#include <utility>
+#include <vector>
+
+namespace photoboss {
+
+    // Arena of (id, hash) entries for the tree indexes. Slots are handed out
+    // in order and never move, so tree nodes refer to them by number;
+    // remove() only marks an id's slots dead, and the owner rebuilds from
+    // takeLive() once wantsCompaction() says the dead outweigh the living.
+    class HashSlots
+    {
+    public:
+        static constexpr quint32 None = 0xFFFFFFFFu;
+
+        quint32 add(quint32 id, quint64 hash)
+        {
+            const auto slot = static_cast<quint32>(m_hashes_.size());
+            m_hashes_.push_back(hash);
+            m_ids_.push_back(id);
+            m_live_.push_back(true);
+            if (id >= m_idHead_.size())
+                m_idHead_.resize(id + 1, None);
+            m_idNext_.push_back(m_idHead_[id]);
+            m_idHead_[id] = slot;
+            ++m_liveCount_;
+            return slot;
+        }
+
+        void remove(quint32 id)
+        {
+            if (id >= m_idHead_.size())
+                return;
+            for (quint32 slot = m_idHead_[id]; slot != None; slot = m_idNext_[slot]) {
+                m_live_[slot] = false;
+                --m_liveCount_;
+            }
+            m_idHead_[id] = None;
+        }
+
+        void clear()
+        {
+            m_hashes_.clear();
+            m_ids_.clear();
+            m_live_.clear();
+            m_idNext_.clear();
+            m_idHead_.clear();
+            m_liveCount_ = 0;
+        }
+
+        quint64 hash(quint32 slot) const { return m_hashes_[slot]; }
+        quint32 id(quint32 slot) const { return m_ids_[slot]; }
+        bool live(quint32 slot) const { return m_live_[slot]; }
+
+        size_t capacity() const { return m_hashes_.size(); }
+        size_t liveCount() const { return m_liveCount_; }
+
+        bool wantsCompaction() const
+        {
+            const size_t dead = capacity() - m_liveCount_;
+            return dead >= 64 && dead > m_liveCount_;
+        }
+
+        // Live entries in insertion order
+        std::vector<std::pair<quint32, quint64>> takeLive() const
+        {
+            std::vector<std::pair<quint32, quint64>> out;
+            out.reserve(m_liveCount_);
+            for (size_t slot = 0; slot < m_hashes_.size(); ++slot) {
+                if (m_live_[slot])
+                    out.emplace_back(m_ids_[slot], m_hashes_[slot]);
+            }
+            return out;
+        }
+
+    private:
+        std::vector<quint64> m_hashes_;
+        std::vector<quint32> m_ids_;
+        std::vector<bool> m_live_;
+        std::vector<quint32> m_idNext_;     // next slot of the same id
+        std::vector<quint32> m_idHead_;     // id -> most recent slot
+        size_t m_liveCount_ = 0;
+    };
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <QtTypes>
+#include <memory>
+#include <vector>
+
+namespace photoboss {
+
+    // Structures SimilarityEngine can find candidate representatives with
+    enum class CandidateIndexKind {
+        MultiIndex,     // MihIndex: fastest queries, one table per band to hold
+        BkTree,         // BkTreeIndex: one small node per hash, nothing to size
+        VpTree          // VpTreeIndex: cheapest inserts and removals
+    };
+
+    // Radius search over 64-bit hashes under Hamming distance. Every
+    // implementation is exact: query() returns every stored hash within
+    // radius() and nothing farther.
+    //
+    // Ids are small dense integers (cluster indices): an id may hold several
+    // hashes, and remove() drops them all. Queries are const and safe
+    // alongside other queries, not alongside insert() / remove().
+    class ICandidateIndex
+    {
+    public:
+        struct Match {
+            quint32 id;
+            int distance;
+        };
+
+        virtual ~ICandidateIndex() = default;
+
+        // Largest Hamming distance query() reports
+        virtual int radius() const = 0;
+        // Live hashes, removed ones excluded
+        virtual size_t size() const = 0;
+
+        virtual void insert(quint32 id, quint64 hash) = 0;
+        // Every hash stored under id; no-op for an unknown id
+        virtual void remove(quint32 id) = 0;
+        virtual void clear() = 0;
+
+        // Appends every stored hash within radius() of hash to out, once each
+        virtual void query(quint64 hash, std::vector<Match>& out) const = 0;
+
+        // bands only applies to CandidateIndexKind::MultiIndex
+        static std::unique_ptr<ICandidateIndex> create(CandidateIndexKind kind, int radius, int bands);
+    };
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <QtTypes>
+#include <vector>
+
+namespace photoboss::mih {
+
+    // One substring of a 64-bit hash in multi-index hashing, see MihIndex
+    struct Band {
+        int shift;
+        int width;
+        quint32 mask;
+
+        quint32 key(quint64 hash) const {
+            return static_cast<quint32>(hash >> shift) & mask;
+        }
+    };
+
+    // `count` bands (2..32) of near-equal width covering all 64 bits, low
+    // bits first
+    inline std::vector<Band> split(int count)
+    {
+        std::vector<Band> bands(count);
+        int shift = 0;
+        for (int b = 0; b < count; ++b) {
+            Band& band = bands[b];
+            band.width = 64 / count + (b < 64 % count ? 1 : 0);
+            band.shift = shift;
+            band.mask = band.width == 32 ? 0xFFFFFFFFu : (1u << band.width) - 1;
+            shift += band.width;
+        }
+        return bands;
+    }
+
+    // Calls fn(key) for every key of a `width`-bit band within `flips` bits
+    // of base, nearest first
+    template <typename Fn>
+    void forEachNeighbour(quint32 base, int width, int flips, Fn&& fn)
+    {
+        // k-bit masks in increasing order by Gosper's hack
+        for (int k = 0; k <= flips && k <= width; ++k) {
+            quint64 mask = k == 0 ? 0 : (1ULL << k) - 1;
+            while (mask < (1ULL << width)) {
+                fn(base ^ static_cast<quint32>(mask));
+                if (k == 0)
+                    break;
+                const quint64 low = mask & (~mask + 1);
+                const quint64 ripple = mask + low;
+                mask = (((ripple ^ mask) >> 2) / low) | ripple;
+            }
+        }
+    }
+
+}
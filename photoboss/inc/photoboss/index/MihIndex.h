@@ -0,0 +1,63 @@
+#pragma once
+#include <unordered_map>
+#include <vector>
+#include "index/ICandidateIndex.h"
+#include "index/MihBands.h"
+#include "util/AppSettings.h"
+
+namespace photoboss {
+
+    // Multi-index hashing over 64-bit hashes (Norouzi et al.): every hash is
+    // cut into `bands` substrings, each indexed in its own table. Two hashes
+    // within Hamming distance r agree to within floor(r / bands) bits on at
+    // least one band, so probing every band with that many bit flips finds
+    // every stored hash within r, and nothing farther once the full distance
+    // is checked. Lookup cost depends on the bucket sizes, not on how many
+    // hashes are stored; pick bands near 64 / log2(size) for the best of both.
+    //
+    // Removal unlinks slots at once, so a replaced representative leaves
+    // nothing behind.
+    class MihIndex : public ICandidateIndex
+    {
+    public:
+        explicit MihIndex(int radius = settings::SimilarityIndexRadius,
+            int bands = settings::SimilarityIndexBands);
+
+        int bands() const { return static_cast<int>(m_bands_.size()); }
+
+        // Inherited via ICandidateIndex
+        int radius() const override { return m_radius_; }
+        size_t size() const override { return m_size_; }
+        void insert(quint32 id, quint64 hash) override;
+        void remove(quint32 id) override;
+        void clear() override;
+        void query(quint64 hash, std::vector<Match>& out) const override;
+
+    private:
+        static constexpr quint32 None = 0xFFFFFFFFu;
+
+        struct Band : mih::Band {
+            // substring -> first slot; slots chain through m_next_
+            std::unordered_map<quint32, quint32> heads;
+        };
+
+        quint32 key(const Band& band, quint64 hash) const {
+            return band.key(hash);
+        }
+        void unlink(size_t band, quint32 slot);
+
+        int m_radius_;
+        int m_flips_;   // bit flips probed per band, floor(radius / bands)
+        std::vector<Band> m_bands_;
+
+        // Slot storage; freed slots are reused
+        std::vector<quint64> m_hashes_;
+        std::vector<quint32> m_ids_;
+        std::vector<quint32> m_next_;       // bands() per slot: next slot in that band's bucket
+        std::vector<quint32> m_idNext_;     // next slot of the same id
+        std::vector<quint32> m_idHead_;     // id -> first slot
+        std::vector<quint32> m_free_;
+        size_t m_size_ = 0;
+    };
+
+}
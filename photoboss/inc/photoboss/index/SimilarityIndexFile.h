@@ -0,0 +1,146 @@
+#pragma once
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <vector>
+#include "index/ICandidateIndex.h"
+#include "types/HashDigest.h"
+
+namespace photoboss {
+
+    // A SimilarityEngine's images and clusters as of the end of a scan, in
+    // one versioned file that is memory-mapped on open and read in place:
+    // fixed-size records, sections at 8-byte aligned offsets, no parsing.
+    //
+    //   Header
+    //   Image[imageCount]        digest, file size and time, path, cluster
+    //   Key[imageCount]          path key -> image, sorted by key
+    //   Cluster[clusterCount]    representative image
+    //   BandTable[bandCount]     one per multi-index band, see MihIndex:
+    //   BandEntry[...]           representatives' pHash and canonical pHash,
+    //                            sorted by band substring
+    //   paths                    UTF-8, referenced by Image
+    //
+    // Records are in host byte order; a file from another layout or other
+    // engine settings fails the magic or fingerprint check and is ignored.
+    class SimilarityIndexFile
+    {
+    public:
+        static constexpr quint32 Magic = 0x49534250;   // "PBSI"
+        static constexpr quint32 Version = 1;
+
+        struct Image {
+            HashDigest digest;
+            quint64 size;
+            quint64 modifiedTime;
+            quint64 path;           // offset into the path section
+            quint32 pathLength;     // bytes
+            quint32 cluster;
+        };
+        static_assert(std::is_trivially_copyable_v<Image>);
+
+        // Maps the file at path. Null when it is missing, truncated, of
+        // another version or written under another fingerprint.
+        static std::unique_ptr<SimilarityIndexFile> open(const QString& path, quint64 fingerprint);
+
+        // Where the index of the scan rooted at root lives, next to the
+        // hash cache
+        static QString defaultPath(const QString& root);
+
+        ~SimilarityIndexFile();
+
+        quint32 imageCount() const { return header().imageCount; }
+        quint32 clusterCount() const { return header().clusterCount; }
+        int radius() const { return header().radius; }
+
+        const Image& image(quint32 i) const { return images()[i]; }
+        quint32 representative(quint32 cluster) const { return clusters()[cluster].representative; }
+
+        // Image stored for the file at path, if any
+        std::optional<quint32> find(const QString& path) const;
+
+        // Clusters whose representative's pHash or canonical pHash is
+        // within radius() of hash. A cluster may be reported twice.
+        void query(quint64 hash, std::vector<ICandidateIndex::Match>& out) const;
+
+        // Collects a snapshot and writes it in one go; clusters are
+        // numbered in the order they are added
+        class Writer
+        {
+        public:
+            quint32 addCluster();
+            quint32 addImage(const QString& path, quint64 size, quint64 modifiedTime,
+                const HashDigest& digest, quint32 cluster);
+            void setRepresentative(quint32 cluster, quint32 image);
+
+            // Replaces the file at path atomically; false on I/O failure
+            bool save(const QString& path, quint64 fingerprint, int radius, int bands) const;
+
+        private:
+            std::vector<Image> m_images_;
+            std::vector<quint32> m_representatives_;
+            QByteArray m_paths_;
+        };
+
+    private:
+        struct Header {
+            quint32 magic;
+            quint32 version;
+            quint64 fingerprint;
+            quint64 fileSize;
+            quint32 imageCount;
+            quint32 clusterCount;
+            qint32 radius;
+            qint32 bandCount;
+            // Section offsets from the start of the file
+            quint64 images;
+            quint64 keys;
+            quint64 clusters;
+            quint64 bands;
+            quint64 paths;
+            quint64 pathsSize;
+        };
+
+        struct Key {
+            quint64 key;
+            quint32 image;
+            quint32 reserved;
+        };
+
+        struct Cluster {
+            quint32 representative;
+            quint32 reserved;
+        };
+
+        struct BandTable {
+            quint64 entries;        // offset of the first BandEntry
+            quint64 count;
+        };
+
+        struct BandEntry {
+            quint64 hash;
+            quint32 key;            // substring of hash in this band
+            quint32 cluster;
+        };
+
+        static quint64 pathKey(const QByteArray& utf8);
+
+        SimilarityIndexFile() = default;
+
+        template <typename T>
+        const T* at(quint64 offset) const { return reinterpret_cast<const T*>(m_data_ + offset); }
+
+        const Header& header() const { return *at<Header>(0); }
+        const Image* images() const { return at<Image>(header().images); }
+        const Key* keys() const { return at<Key>(header().keys); }
+        const Cluster* clusters() const { return at<Cluster>(header().clusters); }
+        const BandTable* bands() const { return at<BandTable>(header().bands); }
+
+        QFile m_file_;
+        const uchar* m_data_ = nullptr;
+    };
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <vector>
+#include "index/HashSlots.h"
+#include "index/ICandidateIndex.h"
+#include "util/AppSettings.h"
+
+namespace photoboss {
+
+    // Vantage-point tree under Hamming distance, grown online: hashes land
+    // in leaf buckets, and a full bucket splits around one of its hashes at
+    // the median distance, so every split halves its bucket whatever order
+    // the hashes arrive in. A query at distance d from a vantage point only
+    // enters the side that can hold hashes within r of it.
+    class VpTreeIndex : public ICandidateIndex
+    {
+    public:
+        explicit VpTreeIndex(int radius = settings::SimilarityIndexRadius);
+
+        // Inherited via ICandidateIndex
+        int radius() const override { return m_radius_; }
+        size_t size() const override { return m_slots_.liveCount(); }
+        void insert(quint32 id, quint64 hash) override;
+        void remove(quint32 id) override;
+        void clear() override;
+        void query(quint64 hash, std::vector<Match>& out) const override;
+
+    private:
+        static constexpr quint32 None = HashSlots::None;
+        static constexpr quint32 LeafSize = 32;
+
+        // Internal when inside != None: hashes closer than mu to vantage go
+        // inside, the rest outside. A leaf chains its slots through
+        // m_leafNext_ from head.
+        struct Node {
+            quint64 vantage = 0;
+            int mu = 0;
+            quint32 inside = None;
+            quint32 outside = None;
+            quint32 head = None;
+            quint32 count = 0;
+            quint32 splitAt = LeafSize;   // raised when every hash is equidistant
+        };
+
+        void split(quint32 leaf);
+        void compact();
+
+        int m_radius_;
+        HashSlots m_slots_;
+        std::vector<quint32> m_leafNext_;   // per slot
+        std::vector<Node> m_nodes_;         // m_nodes_[0] is the root
+    };
+
+}
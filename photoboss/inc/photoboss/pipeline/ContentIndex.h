@@ -0,0 +1,27 @@
+#pragma once
+
+#include <optional>
+#include <shared_mutex>
+#include <unordered_map>
+
+#include "types/CacheTypes.h"
+
+namespace photoboss {
+
+/**
+ * Image hashes of the content hashed so far in this scan, keyed by the
+ * content digest and shared by every HashWorker. A copy of a file already seen - at another
+ * path, or read by another worker - takes its hashes from here instead of
+ * being decoded again.
+ */
+class ContentIndex {
+public:
+    std::optional<ContentHashes> find(const ContentDigest &content) const;
+    void insert(const ContentDigest &content, const ContentHashes &hashes);
+
+private:
+    mutable std::shared_mutex m_mutex_;
+    std::unordered_map<ContentDigest, ContentHashes, ContentDigestHasher> m_entries_;
+};
+
+} // namespace photoboss
@@ -6,7 +6,9 @@
 #include <QImage>
 
 #include "hashing/HashCatalog.h"
+#include "hashing/HashRegistry.h"
 #include "types/DataTypes.h"   // HashedImageResult, DiskReadResult, HashSource, etc.
+#include "types/CacheTypes.h"
 
 namespace photoboss {
 
@@ -18,6 +20,11 @@ namespace photoboss {
  */
 class HashEngine {
 public:
+    // Hashes with registry::DefaultMethods, dispatched at compile time.
+    HashEngine();
+
+    // Hashes with an arbitrary runtime set of HashMethod objects through
+    // virtual calls. Slower; meant for experimenting with method sets.
     explicit HashEngine(std::vector<HashCatalog::Entry> methods);
 
     // Compute hashes for a single file.  The optional QImage may be empty on
@@ -26,7 +33,62 @@ public:
     std::shared_ptr<HashedImageResult>
     compute(const DiskReadResult &item, const std::optional<QImage> &image) const;
 
+    // Compute hashes for several files at once. items[i] pairs with
+    // images[i]; results come back in the same order. Image methods see the
+    // whole batch of decoded images in one computeBatch() call, so methods
+    // with a vectorised batch path (e.g. pHash) amortise their setup.
+    std::vector<std::shared_ptr<HashedImageResult>>
+    computeBatch(const std::vector<const DiskReadResult*> &items,
+                 const std::vector<std::optional<QImage>> &images) const;
+
+    // The two halves of computeBatch(), for callers that decide whether to
+    // decode only once the content digest is known. computeContent() runs
+    // the byte methods (the content digest), computeContentBatch() over
+    // several files so multi-buffer digests can run; computeImages() fills
+    // results[i] from images[i] with the eager image methods and keeps the
+    // plane for the lazy ones.
+    std::shared_ptr<HashedImageResult> computeContent(const DiskReadResult &item) const;
+    std::vector<std::shared_ptr<HashedImageResult>>
+    computeContentBatch(const std::vector<const DiskReadResult*> &items) const;
+    void computeImages(const std::vector<HashedImageResult*> &results,
+                       const std::vector<std::optional<QImage>> &images) const;
+
+    // Copies the image hashes and resolution of byte-identical content
+    // hashed earlier. Returns false, leaving result untouched, unless known
+    // holds every image hash this engine computes.
+    bool reuseImageHashes(HashedImageResult &result, const ContentHashes &known) const;
+
+    // Image hashes of stored PerceptualImage planes, planes[i] into
+    // digests[i], with no decode. Lazy methods included; planes of the wrong
+    // size are skipped.
+    void hashPlanes(const std::vector<const QByteArray*> &planes,
+                    const std::vector<HashDigest*> &digests) const;
+
+    // Computes the lazy image hashes (registry::lazy) of result from its
+    // plane, once: afterwards each is either present or marked failed.
+    void completeLazy(HashedImageResult &result) const;
+
+    // Same for a digest kept apart from its result
+    void completeLazy(HashDigest &digest, const QByteArray &plane) const;
+
+    // HashKind bits left to completeLazy(); none for runtime method sets
+    quint8 lazyKinds() const;
+
+    // HashKind bits of the eager image methods
+    quint8 imageKinds() const;
+
 private:
+    using Methods = registry::DefaultMethods;
+
+    // Each returns false if a method threw; its slot is marked failed.
+    bool hashBytes(const std::vector<const QByteArray*> &data,
+                   const std::vector<HashDigest*> &digests) const;
+    bool hashImages(const std::vector<const PerceptualImage*> &images,
+                    const std::vector<HashDigest*> &digests,
+                    bool withLazy = false) const;
+    void markImageHashesFailed(HashDigest &digest) const;
+
+    bool m_runtimeMethods = false;
     std::vector<HashCatalog::Entry> m_byteMethods;
     std::vector<HashCatalog::Entry> m_imageMethods;
 };
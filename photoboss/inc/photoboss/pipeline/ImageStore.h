@@ -0,0 +1,90 @@
+#pragma once
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <memory>
+#include <vector>
+#include "types/DataTypes.h"
+#include "types/GroupTypes.h"
+
+namespace photoboss {
+
+    // What a SimilarityEngine keeps of the images it was given, one column
+    // per field and numbered in arrival order, so no HashedImageResult has
+    // to outlive the call that handed it over. Directories and formats are
+    // interned and names packed back to back; a path is only put together
+    // again for an ImageGroup. Planes sit in fixed-size slots of a chunked
+    // arena and are released once an image no longer represents a cluster.
+    //
+    // Not thread-safe; SimilarityEngine's lock covers it.
+    class ImageStore
+    {
+    public:
+        using Id = quint32;
+        static constexpr Id None = 0xFFFFFFFFu;
+
+        // Copies the digest, plane, file details and score inputs of result
+        Id add(const HashedImageResult& result);
+        void clear();
+        size_t size() const { return m_digests_.size(); }
+
+        // Lazy hashes are completed in place
+        HashDigest& digest(Id id) { return m_digests_[id]; }
+        const HashDigest& digest(Id id) const { return m_digests_[id]; }
+
+        // Plane the image hashes came from, without a copy; empty if the
+        // image had none or it was released
+        QByteArray plane(Id id) const;
+        void releasePlane(Id id);
+
+        quint64 fileSize(Id id) const { return m_fileSizes_[id]; }
+        quint64 modifiedTime(Id id) const { return m_modifiedTimes_[id]; }
+        QString path(Id id) const;
+
+        // Whether a is the better copy to keep than b
+        bool better(Id a, Id b) const;
+
+        // The ImageGroup entry of id, isBest left false
+        ImageEntry entry(Id id) const;
+
+        // Bytes held by the columns, strings and plane arena
+        size_t memoryUsage() const;
+
+    private:
+        static constexpr quint32 NoPlane = 0xFFFFFFFFu;
+        static constexpr quint32 PlanesPerChunk = 256;
+
+        quint32 intern(const QString& value);
+        char* planeAt(quint32 slot) const;
+
+        static double score(const HashedImageResult& result);
+
+        // Multiplier in (0, 1] for sharpness, clipping and JPEG quality
+        static double qualityFactor(const ImageQuality& quality);
+
+        std::vector<HashDigest> m_digests_;
+        std::vector<QSize> m_resolutions_;
+        std::vector<quint64> m_fileSizes_;
+        std::vector<quint64> m_modifiedTimes_;
+        std::vector<double> m_scores_;          // score(): pixels, size, format, EXIF date
+        std::vector<double> m_qualityFactors_;  // < 0 if quality was not measured
+        std::vector<quint8> m_rotations_;       // EXIF orientation
+
+        // Path: interned directory, then the name in m_names_ between this
+        // image's offset and the next one's. Format is interned too.
+        std::vector<quint32> m_directories_;
+        std::vector<quint32> m_formats_;
+        std::vector<quint32> m_nameOffsets_;
+        QString m_names_;
+        std::vector<QString> m_strings_;
+        QHash<QString, quint32> m_stringIds_;
+
+        // Slot of each image's plane, NoPlane if none. Chunks never move, so
+        // a plane stays put while it is compared; freed slots are reused.
+        std::vector<quint32> m_planeSlots_;
+        std::vector<quint32> m_freePlanes_;
+        std::vector<std::unique_ptr<char[]>> m_planeChunks_;
+        quint32 m_planeCount_ = 0;     // slots handed out so far
+    };
+
+}
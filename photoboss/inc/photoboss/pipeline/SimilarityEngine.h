@@ -1,13 +1,23 @@
 #pragma once
 
 #include <set>
+#include <optional>
+#include <shared_mutex>
 #include <map>
 #include <array>
+#include <atomic>
 #include <unordered_map>
 
 #include "types/DataTypes.h"
 #include "types/GroupTypes.h"
 #include "util/AppSettings.h"
+#include "hashing/HashRegistry.h"
+#include "pipeline/HashEngine.h"
+#include "index/HashColumns.h"
+#include "index/ICandidateIndex.h"
+#include "index/SimilarityIndexFile.h"
+#include "pipeline/ImageStore.h"
+#include "util/UnionFind.h"
 
 namespace photoboss {
     class HashMethod;
@@ -18,59 +28,132 @@ namespace photoboss {
             double strongThreshold = settings::SimilarityStrongThreshold;
             double weakThreshold = settings::SimilarityWeakThreshold;
 
+            // Score through runtime HashMethod objects and the weights / gates
+            // below instead of the compile-time registry. For experiments;
+            // the default path inlines registry::Scoring.
+            bool runtimeMethods = false;
+
+            // addImage() may be called from several threads at once. Each
+            // image then computes its lazy hashes (dHash, aHash) on arrival
+            // instead of on its first comparison.
+            bool concurrent = false;
+
+            // Also group rotated / mirrored copies through the canonical pHash
+            bool matchRotated = true;
+
+            // Also group crops and bordered copies through the pyramid hash,
+            // for images no pHash match placed
+            bool matchCrops = true;
+            double cropGate = settings::SimilarityCropGate;
+            double cropCorrelation = settings::SimilarityCropCorrelation;
+
+            // Candidate indexes over representatives' hashes. The pHash index
+            // finds every representative within indexRadius bits, never fewer
+            // than pHashGate admits; indexBands only applies to MultiIndex.
+            CandidateIndexKind index = CandidateIndexKind::MultiIndex;
+            int indexRadius = settings::SimilarityIndexRadius;
+            int indexBands = settings::SimilarityIndexBands;
+
             // Hard gate thresholds - images must exceed BOTH to be considered similar
-            double pHashGate = settings::SimilarityPHashGate;
-            double dHashGate = settings::SimilarityDHashGate;
+            double pHashGate = registry::Scoring<PerceptualHash>::gate;
+            double dHashGate = registry::Scoring<DifferenceHash>::gate;
 
-            double pHashWeight = 0.60;
-            double dHashWeight = 0.30;
-            double aHashWeight = 0.05;
+            double pHashWeight = registry::Scoring<PerceptualHash>::weight;
+            double dHashWeight = registry::Scoring<DifferenceHash>::weight;
+            double aHashWeight = registry::Scoring<AverageHash>::weight;
             double ratioWeight = 0.05;
         };
 
         explicit SimilarityEngine(Config cfg = {});
 
+        // Safe to call from several threads at once with Config::concurrent.
+        // The engine copies what it needs; img is not referenced afterwards.
         void addImage(const std::shared_ptr<HashedImageResult>& img);
 
+        // Offline mode: clusters images all at once on `threads` threads (0:
+        // one per core), replacing whatever the engine held. Candidate pairs
+        // come from the pHash index and are verified in parallel; verified
+        // pairs are merged transitively. Crops are then placed by
+        // addImage()'s rule, one image at a time in path order. The groups
+        // depend only on the images, not on their order or the thread
+        // count. getGroups() and getGroupDelta() report the result, and
+        // addImage() may follow.
+        void addBatch(const std::vector<std::shared_ptr<HashedImageResult>>& images, int threads = 0);
+
         std::vector<ImageGroup> getGroups() const;
 
+        // Resumes from a previous scan's index (see save()), before the
+        // first addImage(). A file it holds unchanged - same path, size,
+        // time and content - rejoins its stored cluster without a probe;
+        // new and changed files also probe the stored representatives.
+        // Ignored with Config::runtimeMethods; null detaches.
+        void attach(std::shared_ptr<const SimilarityIndexFile> stored);
+
+        // Writes every image and cluster to path for the next scan's
+        // attach(). Returns false if the file could not be written.
+        bool save(const QString& path);
+
+        // Settings and hash method versions the groups depend on; an index
+        // saved under another fingerprint does not open
+        quint64 fingerprint() const;
+
         struct GroupDelta {
             std::vector<ImageGroup> newlyFormed;  // Clusters that just crossed from 1 to >1 members
-            std::vector<ImageGroup> grown;        // Clusters that were already multi-image and grew
+            std::vector<GroupGrowth> grown;       // Images clusters already multi-image gained
+            std::vector<GroupMerge> merged;       // Multi-image clusters absorbed into another one
         };
 
         GroupDelta getGroupDelta();
 
+        // Bytes held for the images taken in so far: the image store,
+        // exact groups and cluster member lists
+        size_t memoryUsage() const;
+        size_t imageCount() const;
+
     private:
-        struct ImageNode {
-            HashedImageResult* result;
-            QSize resolution;
-            quint64 fileSize;
-        };
+        using ImageId = ImageStore::Id;
 
         struct ExactGroup {
-            QString sha;
-            std::vector<ImageNode*> images;
-            ImageNode* representative;
+            ContentDigest sha;
+            std::vector<ImageId> images;
+            ImageId representative = ImageStore::None;
+            size_t cluster = 0;     // index in m_clusters_; m_clusterSets_ follows merges
         };
 
         struct SimilarityGroup {
             quint64 id = 0;
-            std::vector<ImageNode*> members;
-            ImageNode* representative;
+            std::vector<ImageId> members;
+            ImageId representative = ImageStore::None;  // None once absorbed into another cluster
+
+            bool absorbed() const { return representative == ImageStore::None; }
+        };
+
+        // An image's digest and plane, in the store or still in the
+        // caller's result
+        struct Hashes {
+            HashDigest& digest;
+            QByteArray plane;
         };
 
     private:
+        using Methods = registry::DefaultMethods;
+
         Config m_cfg_;
         quint64 m_nextGroupId_ = 1;
 
-        std::list<ImageNode> m_nodes_;
-        std::unordered_map<QString, ExactGroup> m_exactGroups_;
+        // Every image taken in; only representatives keep their planes
+        ImageStore m_store_;
+        std::unordered_map<ContentDigest, ExactGroup, ContentDigestHasher> m_exactGroups_;
         std::vector<SimilarityGroup> m_clusters_;
 
-        // Delta tracking for incremental updates
+        // Delta tracking for incremental updates: what the caller was last
+        // shown of each multi-image cluster
+        struct ShownCluster {
+            size_t size = 0;
+            int bestIndex = 0;
+        };
         std::set<quint64> m_previouslyMultiImageClusterIds;
-        std::map<quint64, size_t> m_previousClusterSizes;
+        std::map<quint64, ShownCluster> m_previousClusters;
 
         struct WeightedHash {
             std::unique_ptr<HashMethod> method;
@@ -79,32 +162,143 @@ namespace photoboss {
 
         std::vector<WeightedHash> m_hashes_;
 
-        // Inverted index: 16-bit sub-hash → cluster indices in m_clusters_
-        std::unordered_map<quint16, std::vector<size_t>> m_subHashIndex_;
+        // Fills lazy hashes (dHash, aHash) of a candidate pair on first use
+        HashEngine m_hashEngine_;
+
+        // Representatives' pHash and canonical pHash, keyed by cluster index
+        // in m_clusters_
+        std::unique_ptr<ICandidateIndex> m_pHashIndex_;
+
+        // Same over representatives' pyramid hashes: the global hash and the
+        // sub-window hashes in separate indexes, so a crop is only ever
+        // looked up against the other level
+        std::unique_ptr<ICandidateIndex> m_cropGlobalIndex_;
+        std::unique_ptr<ICandidateIndex> m_cropWindowIndex_;
+
+        // Representatives' 64-bit hashes by cluster index, for the
+        // vectorised pHash / dHash gates ahead of full scoring
+        HashColumns m_repColumns_;
 
         // Tracks cluster indices modified since last getGroupDelta() call
         std::set<size_t> m_dirtyClusterIndices_;
 
+        // Clusters merged into one, by cluster index; the root is the
+        // cluster that holds the members. Weighted by member count.
+        UnionFind m_clusterSets_;
+
+        // Cluster ids absorbed since last getGroupDelta() call, with the
+        // index of the cluster that took them in
+        std::vector<std::pair<quint64, size_t>> m_absorbed_;
+
+        // Clusters in the order they were created or changed representative.
+        // A caller that probed before an entry was added checks it again
+        // before committing, so concurrent inserts never miss each other.
+        // Positions count from m_changeLogBase_; the log is emptied whenever
+        // the last caller between probe and commit is done with it.
+        std::vector<quint32> m_changeLog_;
+        size_t m_changeLogBase_ = 0;
+        std::atomic<int> m_probing_{ 0 };
+
+        // The attach()ed index; its clusters are numbered as in the file.
+        // m_storedLive_ maps each to the cluster here that took in its
+        // first image this scan (Unclaimed until then; m_clusterSets_
+        // follows merges). A stored cluster whose representative changed
+        // on disk is stale and no longer matched.
+        static constexpr quint32 Unclaimed = 0xFFFFFFFFu;
+        std::shared_ptr<const SimilarityIndexFile> m_stored_;
+        std::vector<quint32> m_storedLive_;
+        std::vector<char> m_storedStale_;
+
+        // addImage() probes under a shared lock and commits under an
+        // exclusive one; the other public calls take the one they need
+        mutable std::shared_mutex m_mutex_;
+
     private:
         void initHashes();
 
+        Hashes hashes(HashedImageResult& result) { return { result.digest, result.plane }; }
+        Hashes hashes(ImageId id) { return { m_store_.digest(id), m_store_.plane(id) }; }
+        Hashes repHashes(size_t ci) { return hashes(m_clusters_[ci].representative); }
+
+        // Lazy hashes are memoised in the digests on first use
         double confidence(
-            const HashedImageResult& a,
-            const HashedImageResult& b
+            const Hashes& a,
+            const Hashes& b
         ) const;
 
+        double runtimeConfidence(
+            const Hashes& a,
+            const Hashes& b
+        ) const;
+
+        double rotatedConfidence(
+            const HashDigest& a,
+            const HashDigest& b
+        ) const;
+
+        // confidence() against a stored representative, whose lazy hashes
+        // were completed before it was saved
+        double storedConfidence(
+            const Hashes& img,
+            const HashDigest& stored
+        ) const;
+
+        // Adds image to cluster ci, promoting it to representative if better
+        void joinCluster(size_t ci, ImageId image);
+
+        // Makes image the representative of cluster ci. The one it replaces
+        // is never compared again and gives up its plane.
+        void represent(size_t ci, ImageId image);
+
+        // Merges clusters a and b, both roots; the heavier one keeps its id
+        // and takes the other's members. Returns its index.
+        size_t mergeClusters(size_t a, size_t b);
+
+        // Clusters a new image joins: every one whose representative it
+        // matches, else the crop cluster, else none. Several get merged.
+        // Matching stored clusters go to `stored`. The shared lock is
+        // enough; without Config::concurrent this also fills in lazy hashes.
+        std::vector<size_t> findClusters(const Hashes& img, std::vector<quint32>& stored);
+
+        // Same over the clusters created or re-represented since log
+        // position `seen`, leaving out `known`. Exclusive lock.
+        std::vector<size_t> findChangedClusters(const Hashes& img, size_t seen,
+            const std::vector<size_t>& known);
+
+        // Cluster whose representative img is a crop of, or that is a crop
+        // of it; none if nothing clears cropGate and cropCorrelation
+        std::optional<size_t> findCropCluster(const Hashes& img);
+
+        // Adds image to the cluster of eg, a copy of image's content
+        void addExactCopy(ExactGroup& eg, ImageId image);
+
+        // Ends a caller's probe; the last one out empties m_changeLog_.
+        // Exclusive lock.
+        void endProbe();
+
+        // Similarity of a crop match between a and b that clears cropGate
+        // and cropCorrelation; 0.0 otherwise
+        double cropSimilarity(const Hashes& a, const Hashes& b) const;
+
+        // Adds digest's pHash and pyramid sub-hashes to the indexes under ci
+        void indexCluster(const HashDigest& digest, size_t ci);
+
         ImageGroup buildGroup(
             const SimilarityGroup& group
         ) const;
 
-        static bool better(
-            const ImageNode& a,
-            const ImageNode& b
-        );
-
-        static double score(const ImageNode& img);
+        // The members of group past what the caller was shown. Only the
+        // new entries are built: members are only ever appended, and a
+        // representative that changed since is one of them.
+        GroupGrowth buildGrowth(
+            const SimilarityGroup& group,
+            const ShownCluster& shown
+        ) const;
 
-        static std::array<quint16, 4> extractSubHashes(
-            const QString& phashHex);
+        // Gates confidence() applies before scoring, as column gates for a
+        // query digest: the direct pHash / dHash gates, or the rotated
+        // canonical pHash gate (empty when the digest cannot match rotated)
+        std::vector<HashColumns::Gate> directGates(const HashDigest& digest) const;
+        std::vector<HashColumns::Gate> rotatedGates(const HashDigest& digest) const;
     };
 }
\ No newline at end of file
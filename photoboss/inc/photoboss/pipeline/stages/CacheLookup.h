@@ -3,7 +3,8 @@
 #include "util/Queue.h"
 #include "types/DataTypes.h"
 #include "caching/IHashCache.h"
-#include "hashing/HashCatalog.h"
+#include "hashing/HashRegistry.h"
+#include "pipeline/HashEngine.h"
 #include "pipeline/StageBase.h"
 
 namespace photoboss
@@ -12,10 +13,14 @@ namespace photoboss
 	{
 		Q_OBJECT
 	public:
+		// Hits go to resultOut. A partial hit whose missing methods can be
+		// computed from the stored plane is completed here and goes to
+		// storeOut; any other partial hit rides along to DiskReader.
 		CacheLookup(
 			Queue<FileIdentity>& input,
-			Queue<FileIdentity>& diskOut,
+			Queue<DiskReadRequest>& diskOut,
 			Queue< std::shared_ptr<HashedImageResult>>& resultOut,
+			Queue< std::shared_ptr<HashedImageResult>>& storeOut,
 			quint64 scanId,
 			QObject* parent = nullptr
 		);
@@ -24,11 +29,18 @@ namespace photoboss
 		void doRun() override;
 
 	private:
+		// Fills the missing image hashes of a partial hit from its plane;
+		// false if it needs the file
+		bool completeFromPlane(HashedImageResult& partial, const QList<QString>& missing) const;
+
 		Queue<FileIdentity>& m_inputQueue_;
-		Queue<FileIdentity>& m_diskReadQueue_;
+		Queue<DiskReadRequest>& m_diskReadQueue_;
 		Queue< std::shared_ptr<HashedImageResult>>& m_resultQueue_;
+		Queue< std::shared_ptr<HashedImageResult>>& m_storeQueue_;
 		std::unique_ptr<IHashCache> m_cache_;
+		HashEngine m_hashEngine_;
 		QList<QString> m_methods_;
+		QList<QString> m_lazyMethods_;   // computed from the plane if not stored
 
 		// Inherited via StageBase
 		void onStop() override;
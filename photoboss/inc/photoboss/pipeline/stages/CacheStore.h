@@ -6,6 +6,7 @@
 #include "types/DataTypes.h"
 #include "pipeline/StageBase.h"
 #include "caching/IHashCache.h"
+#include "hashing/HashRegistry.h"
 
 namespace photoboss
 {
@@ -29,6 +30,7 @@ namespace photoboss
 		Queue<std::shared_ptr<HashedImageResult>>& m_input_;
 		Queue<std::shared_ptr<HashedImageResult>>& m_output_;
 		std::vector<std::pair<HashedImageResult, QMap<QString, int>>> m_batch_;
+		QMap<QString, int> m_versions_;
 
 		// Inherited via StageBase
 		void doRun() override;
@@ -12,7 +12,7 @@ namespace photoboss {
         Q_OBJECT
     public:
         explicit DiskReader(
-			Queue<FileIdentity>& input,
+			Queue<DiskReadRequest>& input,
             Queue<std::unique_ptr<DiskReadResult>>& output, 
             QObject* parent = nullptr
         );
@@ -23,7 +23,7 @@ namespace photoboss {
         void finished();
 
     private:
-        Queue<FileIdentity>& m_input_queue_; 
+        Queue<DiskReadRequest>& m_input_queue_; 
         Queue<std::unique_ptr<DiskReadResult>>& m_output_queue_;
 
         // Inherited via StageBase
@@ -9,6 +9,8 @@
 #include "types/DataTypes.h"
 #include "pipeline/stages/ImageLoader.h"
 #include "pipeline/HashEngine.h"
+#include "pipeline/ContentIndex.h"
+#include "caching/IHashCache.h"
 #include "util/Queue.h"
 
 namespace photoboss {
@@ -17,6 +19,8 @@ namespace photoboss {
  * Orchestrator used by the factory pipeline. It pulls DiskReadResult items from
  * the input queue, obtains a QImage via ImageLoader, delegates the actual hash
  * computation to HashEngine, and finally emits the HashedImageResult downstream.
+ * Content already hashed - earlier in this scan or in the cache under another
+ * path - is recognised by its content digest and never decoded.
  *
  * The class mirrors the public interface of the legacy HashWorker (run() and
  * onStop()) so that PipelineFactory can use it interchangeably.
@@ -26,6 +30,8 @@ class HashWorker : public StageBase {
 public:
     HashWorker(Queue<std::unique_ptr<DiskReadResult>>& inputQueue,
                      Queue<std::shared_ptr<HashedImageResult>>& outputQueue,
+                     std::shared_ptr<ContentIndex> contentIndex,
+                     quint64 scanId,
                      QObject* parent = nullptr);
     ~HashWorker() override;
 
@@ -33,10 +39,19 @@ public:
     void onStop() override;
 
 private:
+    // Takes the hashes, resolution and plane a partial cache hit already has
+    static void adoptCached(HashedImageResult& result, const HashedImageResult& cached);
+
+    // Fills result's image hashes from byte-identical content hashed before
+    bool reuseKnownContent(HashedImageResult& result);
+
     Queue<std::unique_ptr<DiskReadResult>>& m_inputQueue_;
     Queue<std::shared_ptr<HashedImageResult>>& m_outputQueue_;
     ImageLoader m_imageLoader_;
     HashEngine m_hashEngine_;
+    std::shared_ptr<ContentIndex> m_contentIndex_;
+    std::unique_ptr<IHashCache> m_cache_;
+    QList<QString> m_methods_;
 };
 
 } // namespace photoboss
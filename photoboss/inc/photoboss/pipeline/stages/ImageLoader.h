@@ -16,12 +16,26 @@ namespace photoboss {
  */
 class ImageLoader {
 public:
+    // Colour is needed for anything shown to the user (thumbnails); Luma is
+    // enough for hashing and lets JPEGs skip chroma decoding entirely.
+    enum class Decode {
+        Colour,
+        Luma
+    };
+
     ImageLoader() = default;
 
     // Decode a single result.  Returns std::nullopt if the image cannot be read.
-    // targetSize controls the IDCT-scaled decode size (pass ThumbnailWidth to get a
-    // thumbnail-suitable QImage, or HashSampleSize to get a hash-suitable one).
-    std::optional<QImage> load(const DiskReadResult &item, int targetSize = -1) const;
+    // targetSize is the minimum long side of the decoded image (pass ThumbnailWidth
+    // to get a thumbnail-suitable QImage, or HashSampleSize to get a hash-suitable
+    // one); the aspect ratio is always kept. JPEGs go through JpegDecoder's
+    // IDCT-scaled path, everything else through QImageReader. With Decode::Luma
+    // a JPEG comes back as Format_Grayscale8; other formats stay in colour.
+    // On failure, *failure (if given) tells a format nothing can decode from
+    // damaged data.
+    std::optional<QImage> load(const DiskReadResult &item, int targetSize = -1,
+                               Decode mode = Decode::Colour,
+                               FileFailure *failure = nullptr) const;
 
     // Decode a whole batch (vector of pointers to results).  Returns a vector
     // with the same ordering; each entry is either a valid QImage or nullopt.
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <QByteArray>
+#include <QImage>
+#include <optional>
+
+namespace photoboss {
+
+/**
+ * JPEG-only decode path on libjpeg-turbo. The IDCT itself is scaled
+ * (1/1, 1/2, 1/4 or 1/8), so a large photo is never reconstructed at full
+ * resolution, and Luma output decodes only the Y component: the chroma
+ * planes are neither upsampled nor colour-converted.
+ *
+ * Anything libjpeg cannot turn into the requested colour space (CMYK,
+ * corrupt streams, ...) yields std::nullopt so callers can fall back to
+ * QImageReader.
+ */
+class JpegDecoder {
+public:
+    enum class Output {
+        Colour,  // QImage::Format_RGB32
+        Luma     // QImage::Format_Grayscale8
+    };
+
+    // True if the buffer starts with a JPEG SOI marker.
+    static bool isJpeg(const QByteArray& bytes);
+
+    // Decode at the smallest IDCT scale whose long side is still at least
+    // minLongSide (full size if the image is smaller than that).
+    static std::optional<QImage> decode(const QByteArray& bytes, int minLongSide, Output output);
+
+    // The scale denominator decode() picks for a given long side.
+    static int scaleDenominator(int longSide, int minLongSide);
+
+    // IJG quality (1-100) the luminance quantisation table was scaled from,
+    // read from the DQT segments before the first scan; 0 if bytes is not a
+    // JPEG or carries no luminance table. Needs no decode.
+    static int estimateQuality(const QByteArray& bytes);
+};
+
+} // namespace photoboss
@@ -8,6 +8,9 @@
 
 #include <QSet>
 #include <QMap>
+#include <QHash>
+#include <QImage>
+#include <mutex>
 
 namespace photoboss {
     class ResultProcessor : public StageBase
@@ -35,25 +38,38 @@ namespace photoboss {
         explicit ResultProcessor(
             Queue<std::shared_ptr<HashedImageResult>>& queue,
             Queue<ThumbnailRequestPtr>& thumbnailQueue,
+            bool batch = false,     // group once all results are in, see SimilarityEngine::addBatch()
+            int threads = 1,        // threads feeding the engine in online mode
+            QString indexPath = {}, // SimilarityIndexFile resumed from and saved to; none if empty
             QObject* parent = nullptr
         );
 
     signals:
         void groupingFinished(const std::vector<ImageGroup> groups);
         void groupAdded(const ImageGroup& group);
-        void groupUpdated(const ImageGroup& group);
+        // Images a group already added gained since
+        void groupGrown(const GroupGrowth& growth);
+        // merge.absorbed is gone; merge.into follows as added or updated
+        void groupMerged(const GroupMerge& merge);
+        // Files that could not be read or decoded, once at the end of the scan
+        void failuresFound(const FailureSummary& failures);
     
     protected:
         void doRun() override;
 
     private:
+        void requestThumbnail(const ImageEntry& img);
+
+        bool m_batch_;
+        int m_threads_;
+        QString m_indexPath_;
         Queue<std::shared_ptr<HashedImageResult>>& m_input_;
         Queue<ThumbnailRequestPtr>& m_thumbnailOutput_;
-        std::vector<std::shared_ptr<HashedImageResult>> m_items_;
-        QMap<QString, std::shared_ptr<HashedImageResult>> m_pathToItem_;
-        QSet<quint64> m_emittedGroups_;
-        QMap<quint64, int> m_emittedSizes_;
+        std::vector<std::shared_ptr<HashedImageResult>> m_items_;   // batch mode only, until grouped
+        QHash<QString, QImage> m_decoded_;   // images HashWorker decoded, by path, until their thumbnail is requested
         QSet<QString> m_thumbnailRequested_; // Track which images have had thumbnails requested
+        FailureSummary m_failures_;          // Left out of grouping, reported instead
+        std::mutex m_itemsMutex_;            // m_items_, m_decoded_ and m_failures_, shared with the helpers
         
         // Inherited via StageBase
         void onStop() override;
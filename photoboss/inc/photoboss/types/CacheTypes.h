@@ -4,6 +4,8 @@ namespace photoboss
 {
     enum class Lookup {
         Hit,
+        Partial,   // file known, some requested methods missing
+        Failed,    // unchanged since it last failed; hashedImage.failure says why
         Miss,
         Error
 	};
@@ -11,6 +13,7 @@ namespace photoboss
     struct CacheLookupResult {
         Lookup hit;
         HashedImageResult hashedImage;
+        QList<QString> missingMethods;   // Partial: requested keys not stored
 
         CacheLookupResult()
             : hit(Lookup::Error)
@@ -24,9 +27,19 @@ namespace photoboss
         }
     };
 
+    // Image hashes and resolution stored for some file with a given content digest.
+    // Byte-identical files share them whatever their path.
+    struct ContentHashes {
+        HashDigest digest;
+        QSize resolution;
+        QByteArray plane;   // empty when none was stored
+        ImageQuality quality;
+    };
+
     struct CacheQuery {
         FileIdentity fileIdentity;
         QList<QString> hashMethods; // e.g. ["md5", "phash"]
+        QList<QString> optionalMethods; // read back when stored, not needed for a hit
 
         explicit CacheQuery(FileIdentity id)
             : fileIdentity(std::move(id))
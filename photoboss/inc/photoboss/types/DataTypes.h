@@ -1,8 +1,12 @@
 #pragma once
+#include <algorithm>
+#include <memory>
+#include <vector>
 #include <QDateTime>
 #include <QSize>
 #include <QImage>
 #include "types/FileIdentity.h"
+#include "types/HashDigest.h"
 
 namespace photoboss {
 
@@ -17,9 +21,52 @@ namespace photoboss {
        Image
    };
 
+    // Why a file produced no image hashes. Persisted (failures.kind), so a
+    // file is not retried until its size or modification time changes.
+    enum class FileFailure : quint8 {
+        None = 0,
+        Unreadable = 1,    // could not be opened or read
+        Undecodable = 2,   // a format we read, but the data is damaged
+        Unsupported = 3    // no decoder for the format
+    };
+
+    struct FailedFile {
+        QString path;
+        FileFailure kind;
+    };
+
+    // Files left out of grouping in one scan, for the end-of-scan report
+    struct FailureSummary {
+        std::vector<FailedFile> files;
+
+        int count(FileFailure kind) const {
+            return static_cast<int>(std::count_if(files.begin(), files.end(),
+                [kind](const FailedFile& f) { return f.kind == kind; }));
+        }
+    };
+
+    // Cheap cues for which copy of a group to keep, measured while hashing
+    struct ImageQuality {
+        float sharpness = -1.0f;  // Laplacian variance of the decoded luma; < 0 if not measured
+        float clipped = 0.0f;     // fraction of pixels crushed to black or blown to white
+        int jpegQuality = 0;      // IJG quality from the DQT tables; 0 if not a JPEG
+
+        bool measured() const { return sharpness >= 0.0f; }
+    };
+
+    struct HashedImageResult;
+
+    // A file for DiskReader, with what the cache already holds for it
+    struct DiskReadRequest {
+        FileIdentity fileIdentity;
+        std::shared_ptr<HashedImageResult> cached;   // partial cache hit, or null
+    };
+
     struct DiskReadResult {
         FileIdentity fileIdentity;
         QByteArray imageBytes;
+        std::shared_ptr<HashedImageResult> cached;   // from DiskReadRequest
+        FileFailure failure = FileFailure::None;     // Unreadable: imageBytes is empty
 
         DiskReadResult(FileIdentity id, QByteArray bytes)
             : fileIdentity(std::move(id)), imageBytes(std::move(bytes)) {
@@ -31,21 +78,25 @@ namespace photoboss {
         HashSource source;
         QDateTime cachedAt;
         QSize resolution;
-        std::map<QString, QString> hashes;  // SHA256, pHash, etc.
+        HashDigest digest;  // SHA256, pHash, etc.
         std::optional<QImage> decodedImage;
+        QByteArray plane;   // PerceptualImage::plane() the image hashes came from, if any
+        quint8 storedKinds = 0;   // HashKind bits the cache already holds for this file
+        ImageQuality quality;
+        FileFailure failure = FileFailure::None;   // set with source == Error when skipped for good
 
 		// Constructor to initialize fileIdentity
         HashedImageResult(FileIdentity id,
             HashSource src = HashSource::Fresh,
             QDateTime time = QDateTime::currentDateTimeUtc(),
             QSize resolution = {0,0},
-            std::map<QString, QString> hashMap = {},
+            HashDigest hashDigest = {},
             std::optional<QImage> decodedImg = {})
             : fileIdentity(std::move(id))
             , source(src)
             , cachedAt(time)
             , resolution(resolution)
-            , hashes(std::move(hashMap))
+            , digest(hashDigest)
             , decodedImage(std::move(decodedImg))
         { }
     };
@@ -58,6 +109,10 @@ namespace photoboss {
     struct ScanRequest {
         QString directory;
         bool recursive;
+        // Group once every hash is in, in parallel and independent of
+        // arrival order, ignoring the saved index (Rescan and Regroup);
+        // no live groups
+        bool batchGrouping = false;
         ScanRequest(QString dir = {}, bool rec = false)
             : directory(std::move(dir)), recursive(rec) {
         }
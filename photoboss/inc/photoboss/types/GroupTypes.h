@@ -21,6 +21,22 @@ namespace photoboss {
         int bestIndex; // index into images
     };
 
+    // Images a group already shown gained, which follow its first
+    // `firstIndex` images; bestIndex is into the whole group
+    struct GroupGrowth {
+        quint64 id = 0;
+        int firstIndex = 0;
+        std::vector<ImageEntry> added;
+        int bestIndex = 0;
+    };
+
+    // Group `absorbed` was merged into group `into` and no longer exists;
+    // `into` arrives as a new or grown group with all of its images
+    struct GroupMerge {
+        quint64 into = 0;
+        quint64 absorbed = 0;
+    };
+
     struct HashScore {
         QString key;
         double similarity; // 1.0 ? 0.0
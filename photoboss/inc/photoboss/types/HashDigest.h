@@ -0,0 +1,163 @@
+#pragma once
+#include <array>
+#include <cstring>
+#include <optional>
+#include <QtTypes>
+#include <QString>
+#include "util/AppSettings.h"
+
+namespace photoboss {
+
+    // Slot of a hash inside HashDigest. The value is also its bit in
+    // HashDigest::present / failed.
+    enum class HashKind : quint8 {
+        Content = 0,   // exact-duplicate digest, see ContentAlgorithm
+        Perceptual = 1,
+        Difference = 2,
+        Average = 3,
+        PerceptualCanonical = 4,  // pHash in canonical orientation
+        Pyramid = 5               // global and sub-window block hashes, see PyramidHash
+    };
+
+    static inline constexpr int HashKindCount = 6;
+
+    // Algorithm behind HashKind::Content, fixed per build by
+    // settings::ContentDigestXxh3. The persisted key names the algorithm, so
+    // rows written under the other one are never read back as a match.
+    enum class ContentAlgorithm : quint8 {
+        Sha256,     // cryptographic, 32 bytes
+        Xxh3_128    // non-cryptographic, 16 bytes; duplicate detection only
+    };
+
+    static inline constexpr ContentAlgorithm ActiveContentAlgorithm =
+        settings::ContentDigestXxh3 ? ContentAlgorithm::Xxh3_128 : ContentAlgorithm::Sha256;
+
+    // Significant bytes of a content digest; the rest of ContentDigest is zero
+    static inline constexpr int ContentDigestSize =
+        ActiveContentAlgorithm == ContentAlgorithm::Xxh3_128 ? 16 : 32;
+
+    using ContentDigest = std::array<quint8, 32>;
+
+    // Block hashes of HashKind::Pyramid: the whole plane, then the 2x2
+    // three-quarter windows, then the 3x3 half windows (PyramidHash)
+    static inline constexpr int PyramidHashCount = 1 + 4 + 9;
+
+    using PyramidDigest = std::array<quint64, PyramidHashCount>;
+
+    // Every hash of one image in a fixed-size record: the raw content digest
+    // and the 64-bit perceptual fingerprints. Compared and indexed directly,
+    // with no string parsing on the hot path.
+    struct HashDigest {
+        ContentDigest content{};
+        quint64 pHash = 0;
+        quint64 dHash = 0;
+        quint64 aHash = 0;
+        quint64 pHashCanonical = 0;
+        PyramidDigest pyramid{};
+        quint8 present = 0;   // HashKind bits holding a valid value
+        quint8 failed = 0;    // HashKind bits whose computation failed
+
+        static constexpr quint8 bit(HashKind kind) {
+            return static_cast<quint8>(1u << static_cast<int>(kind));
+        }
+
+        bool has(HashKind kind) const { return (present & bit(kind)) != 0; }
+        bool hasFailed(HashKind kind) const { return (failed & bit(kind)) != 0; }
+        bool empty() const { return present == 0; }
+
+        void setContent(const ContentDigest& value) {
+            content = value;
+            present |= bit(HashKind::Content);
+            failed &= ~bit(HashKind::Content);
+        }
+
+        void setPyramid(const PyramidDigest& value) {
+            pyramid = value;
+            present |= bit(HashKind::Pyramid);
+            failed &= ~bit(HashKind::Pyramid);
+        }
+
+        // 64-bit kinds only (everything but Content and Pyramid)
+        void setValue(HashKind kind, quint64 value) {
+            switch (kind) {
+            case HashKind::Perceptual: pHash = value; break;
+            case HashKind::Difference: dHash = value; break;
+            case HashKind::Average: aHash = value; break;
+            case HashKind::PerceptualCanonical: pHashCanonical = value; break;
+            case HashKind::Content:
+            case HashKind::Pyramid: return;
+            }
+            present |= bit(kind);
+            failed &= ~bit(kind);
+        }
+
+        quint64 value(HashKind kind) const {
+            switch (kind) {
+            case HashKind::Perceptual: return pHash;
+            case HashKind::Difference: return dHash;
+            case HashKind::Average: return aHash;
+            case HashKind::PerceptualCanonical: return pHashCanonical;
+            case HashKind::Content:
+            case HashKind::Pyramid: break;
+            }
+            return 0;
+        }
+
+        // Takes kind from other, whatever its width; other must hold it
+        void copyValue(HashKind kind, const HashDigest& other) {
+            if (kind == HashKind::Content)
+                setContent(other.content);
+            else if (kind == HashKind::Pyramid)
+                setPyramid(other.pyramid);
+            else
+                setValue(kind, other.value(kind));
+        }
+
+        void markFailed(HashKind kind) {
+            present &= ~bit(kind);
+            failed |= bit(kind);
+        }
+
+        // kinds is a mask of HashKind bits
+        void markAllFailed(quint8 kinds) {
+            present &= ~kinds;
+            failed |= kinds;
+        }
+    };
+
+    // Persisted method names (hash_methods.key)
+    inline QString hashKindKey(HashKind kind)
+    {
+        switch (kind) {
+        case HashKind::Content:
+            return ActiveContentAlgorithm == ContentAlgorithm::Xxh3_128
+                ? QStringLiteral("XXH3-128") : QStringLiteral("SHA256");
+        case HashKind::Perceptual: return QStringLiteral("Perceptual Hash");
+        case HashKind::Difference: return QStringLiteral("Difference Hash");
+        case HashKind::Average: return QStringLiteral("Average Hash");
+        case HashKind::PerceptualCanonical: return QStringLiteral("Perceptual Hash (Canonical)");
+        case HashKind::Pyramid: return QStringLiteral("Pyramid Hash");
+        }
+        return {};
+    }
+
+    inline std::optional<HashKind> hashKindFromKey(const QString& key)
+    {
+        for (int i = 0; i < HashKindCount; ++i) {
+            const auto kind = static_cast<HashKind>(i);
+            if (key == hashKindKey(kind))
+                return kind;
+        }
+        return std::nullopt;
+    }
+
+    // SHA-256 and XXH3 output is uniformly distributed, so the leading bytes
+    // are already a good bucket hash.
+    struct ContentDigestHasher {
+        size_t operator()(const ContentDigest& digest) const noexcept {
+            size_t h;
+            std::memcpy(&h, digest.data(), sizeof(h));
+            return h;
+        }
+    };
+}
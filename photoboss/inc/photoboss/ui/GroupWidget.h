@@ -20,7 +20,8 @@ namespace photoboss {
 
         int countSelectedForDeletion() const;
  		QVector<ImageEntry> imagesMarkedForDeleteEntries() const;
-		void updateGroup(const ImageGroup& group);
+		// Appends the images the group gained; ones already shown are skipped
+		void addImages(const GroupGrowth& growth);
 		const QMap<QString, ImageThumbWidget*>& thumbsByPath() const { return m_thumbsByPath_; }
 	
 	signals:
@@ -32,11 +33,14 @@ namespace photoboss {
 		void onThumbSelectionChanged();
 
 	private:
+		void appendImages(const std::vector<ImageEntry>& images, int firstIndex, int bestIndex);
+
 		QVector<ImageThumbWidget*> m_thumbs_;
 		QMap<QString, ImageThumbWidget*> m_thumbsByPath_;
 		QLabel* m_header_;
 		QHBoxLayout* m_currentRow_;
 		QVBoxLayout* m_rootLayout_;
 		bool m_userModified_ = false;
+		int m_bestIndex_ = -1;
 	};
 }
\ No newline at end of file
@@ -2,7 +2,10 @@
 namespace photoboss
 {
 	struct ImageGroup;
+	struct GroupGrowth;
+	struct GroupMerge;
 	struct ThumbnailResult;
+	struct FailureSummary;
 	class Pipeline;
 
 	class IUiUpdateSink
@@ -10,11 +13,13 @@ namespace photoboss
 	public:
 		virtual ~IUiUpdateSink() = default;
 		virtual void addPendingGroup(const ImageGroup& group) = 0;
-		virtual void updateGroup(const ImageGroup& group) = 0;
+		virtual void growGroup(const GroupGrowth& growth) = 0;
+		virtual void mergeGroup(const GroupMerge& merge) = 0;
 		virtual void setThumbnail(const ThumbnailResult& result) = 0;
 		virtual void incrementPhaseProgress(Pipeline::Phase phase, int increment) = 0;
 		virtual void setFileTotal(int total) = 0;
 		virtual void setStatusMessage(const QString& message) = 0;
 		virtual void setPipelineState(Pipeline::PipelineState state) = 0;
+		virtual void setFailures(const FailureSummary& failures) = 0;
 	};
 }
\ No newline at end of file
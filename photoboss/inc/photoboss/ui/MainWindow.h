@@ -50,6 +50,7 @@ private:
     void init();
     void wireConnections();
     void onBrowse();
+    void startScan(bool batchGrouping);
     void setCurrentFolder(const QString& folder);
     void onCurrentFolderChanged();
     void clearResults();
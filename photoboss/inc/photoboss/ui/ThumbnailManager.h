@@ -4,6 +4,7 @@
 #include <QMap>
 #include <QMultiMap>
 #include <QPixmap>
+#include <QSet>
 #include <deque>
 
 #include "types/GroupTypes.h"
@@ -26,7 +27,10 @@ public:
     explicit ThumbnailManager(PreviewPane* previewPane, QObject* parent = nullptr);
 
     void processPendingGroup(const ImageGroup& group);
-    void processUpdatedGroups(const QMap<quint64, ImageGroup>& updatedGroups);
+    // Growth of a group still pending waits until its widget exists
+    void processGrownGroups(const QMap<quint64, GroupGrowth>& grownGroups);
+    // Groups merged into others; ids not shown yet are never shown
+    void removeGroups(const QSet<quint64>& ids);
     void distributeThumbnails(const QMap<QString, QPixmap>& thumbnails);
 
     void clearResults();
@@ -43,6 +47,7 @@ signals:
 
 private:
     void assignThumbnailToWidget(const QString& path, ImageThumbWidget* thumb);
+    void applyGrowth(GroupWidget* widget, const GroupGrowth& growth);
 
     PreviewPane* m_previewPane_;
     QScrollArea* m_scrollArea_;
@@ -51,6 +56,8 @@ private:
     int m_minimumWidth_ = 0;
 
     QMap<quint64, GroupWidget*> m_groupWidgets_;
+    QSet<quint64> m_retiredGroupIds_;
+    QMap<quint64, GroupGrowth> m_deferredGrowth_;
     QMultiMap<QString, ImageThumbWidget*> m_thumbnailWaiters_;
     QMap<QString, QPixmap> m_thumbnailCache_;
     bool m_scanFoundDuplicates_ = false;
@@ -3,6 +3,7 @@
 #include <QMap>
 #include <QMultiMap>
 #include <QPixmap>
+#include <QSet>
 #include <deque>
 #include <utility>
 
@@ -16,11 +17,13 @@ class ImageThumbWidget;
 
 struct UiSnapshot {
     std::deque<ImageGroup> pendingGroups;
-    QMap<quint64, ImageGroup> updatedGroups;
+    QMap<quint64, GroupGrowth> grownGroups;   // images added to groups since the last snapshot
+    QSet<quint64> removedGroups;        // merged into another group
     QMap<QString, QPixmap> thumbnailCache;
     QMultiMap<QString, ImageThumbWidget*> thumbnailWaiters;
     QMap<Pipeline::Phase, std::pair<int,int>> phaseProgress;
     QString statusMessage;
+    FailureSummary failures;
     Pipeline::PipelineState pipelineState = Pipeline::PipelineState::Stopped;
 
     bool operator==(const UiSnapshot& other) const;
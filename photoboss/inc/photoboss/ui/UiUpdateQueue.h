@@ -38,12 +38,14 @@ public:
 
     // Update methods – called from any thread (queued to UI thread)
     void addPendingGroup(const ImageGroup& group) override;
-    void updateGroup(const ImageGroup& group) override;
+    void growGroup(const GroupGrowth& growth) override;
+    void mergeGroup(const GroupMerge& merge) override;
     void setThumbnail(const ThumbnailResult& result) override;
     void incrementPhaseProgress(Pipeline::Phase phase, int increment) override;
     void setFileTotal(int total) override;
     void setStatusMessage(const QString& msg) override;
     void setPipelineState(Pipeline::PipelineState state) override;
+    void setFailures(const FailureSummary& failures) override;
 
     // Commit processed groups – removes them from the pending queue
     void commitProcessed(int count);
@@ -64,18 +66,19 @@ private:
     mutable QRecursiveMutex m_mutex;
     bool m_dirty = false;          // true when any mutator changed state
     QTimer m_throttleTimer_;
-    QSet<quint64> m_modifiedGroupIds_;
+    QSet<quint64> m_removedGroupIds_;
 
     // Track total files from Find phase for use in subsequent phases
     int m_totalFiles = 0;
 
     // internal storage – same layout as the original UiStatusModel
     std::deque<ImageGroup> m_pendingGroups;
-    QMap<quint64, ImageGroup> m_updatedGroups;
+    QMap<quint64, GroupGrowth> m_grownGroups_;   // since the last snapshot
     QMap<QString, QPixmap> m_thumbnailCache;
     QMultiMap<QString, ImageThumbWidget*> m_thumbnailWaiters;
     QMap<Pipeline::Phase, std::pair<int,int>> m_phaseProgress;
     QString m_statusMessage;
+    FailureSummary m_failures;
 	Pipeline::PipelineState m_pipelineState = Pipeline::PipelineState::Stopped;
 };
 
@@ -8,13 +8,15 @@ namespace photoboss::settings {
     static inline constexpr int MetaHeight = 40;
 
     // SQL Schema
-    static inline constexpr int SCHEMA_VERSION = 1;
+    static inline constexpr int SCHEMA_VERSION = 9;
 
     // Cache store
     static inline constexpr int CacheStoreBatchSize = 100;
 
     // Hashing
     static inline constexpr int HashSampleSize = 32;
+    static inline constexpr int HashBatchSize = 4;               // reads a HashWorker hashes together (held outside ReadQueue)
+    static inline constexpr bool ContentDigestXxh3 = false;     // exact duplicates by XXH3-128 instead of SHA-256 (faster, not collision-resistant)
 
     // Scanning / batching
     static inline constexpr int DirectoryScanBatchSize = 200;
@@ -53,5 +55,13 @@ namespace photoboss::settings {
     static inline constexpr double SimilarityWeakThreshold = 0.92;
     static inline constexpr double SimilarityPHashGate = 0.98;
     static inline constexpr double SimilarityDHashGate = 0.94;
+    // pHash candidate index (MihIndex): finds every pair within
+    // SimilarityIndexRadius bits, at least what SimilarityPHashGate admits
+    static inline constexpr int SimilarityIndexRadius = 1;
+    static inline constexpr int SimilarityIndexBands = 4;
+    static_assert(SimilarityIndexRadius >= static_cast<int>((1.0 - SimilarityPHashGate) * 64.0));
+    static inline constexpr double SimilarityCropGate = 0.92;          // pyramid window vs global hash, see PyramidHash
+    static inline constexpr double SimilarityCropCorrelation = 0.95;   // plane correlation confirming a crop match
+    static inline constexpr double QualitySharpnessKnee = 100.0;   // Laplacian variance at which sharpness counts half
 
 }
\ No newline at end of file
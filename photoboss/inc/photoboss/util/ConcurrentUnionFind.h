@@ -0,0 +1,62 @@
+#pragma once
+#include <QtTypes>
+#include <atomic>
+#include <utility>
+#include <vector>
+
+namespace photoboss {
+
+    // Disjoint sets over 0 .. size()-1 that any number of threads may unite
+    // and query at once, lock-free. The root of a set is always its smallest
+    // element, so the final partition and every root are the same whatever
+    // order the unions ran in.
+    class ConcurrentUnionFind
+    {
+    public:
+        explicit ConcurrentUnionFind(size_t count)
+            : m_parent_(count)
+        {
+            for (size_t i = 0; i < count; ++i)
+                m_parent_[i].store(static_cast<quint32>(i), std::memory_order_relaxed);
+        }
+
+        size_t size() const { return m_parent_.size(); }
+
+        quint32 find(quint32 x)
+        {
+            for (;;) {
+                quint32 parent = m_parent_[x].load(std::memory_order_acquire);
+                if (parent == x)
+                    return x;
+                const quint32 grand = m_parent_[parent].load(std::memory_order_acquire);
+                if (grand == parent)
+                    return parent;
+                // Path halving; losing the race only skips the shortcut
+                m_parent_[x].compare_exchange_weak(parent, grand, std::memory_order_acq_rel);
+                x = grand;
+            }
+        }
+
+        // Returns whether a and b were in different sets
+        bool unite(quint32 a, quint32 b)
+        {
+            for (;;) {
+                a = find(a);
+                b = find(b);
+                if (a == b)
+                    return false;
+                if (a < b)
+                    std::swap(a, b);
+                // Hang the larger root under the smaller; retry if a stopped
+                // being a root meanwhile
+                quint32 expected = a;
+                if (m_parent_[a].compare_exchange_strong(expected, b, std::memory_order_acq_rel))
+                    return true;
+            }
+        }
+
+    private:
+        std::vector<std::atomic<quint32>> m_parent_;
+    };
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+// Architecture detection for the hand-vectorised kernels.
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define PHOTOBOSS_X86 1
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define PHOTOBOSS_NEON 1
+#endif
+
+// MSVC accepts intrinsics for any ISA extension without per-function flags;
+// GCC/Clang need the target attribute on the function that uses them.
+#if defined(PHOTOBOSS_X86) && (defined(__GNUC__) || defined(__clang__))
+#define PHOTOBOSS_TARGET_AVX2 __attribute__((target("avx2")))
+#define PHOTOBOSS_TARGET_SHA __attribute__((target("sha,sse4.1")))
+#define PHOTOBOSS_TARGET_AVX512POPCNT __attribute__((target("avx512f,avx512vpopcntdq")))
+#else
+#define PHOTOBOSS_TARGET_AVX2
+#define PHOTOBOSS_TARGET_SHA
+#define PHOTOBOSS_TARGET_AVX512POPCNT
+#endif
+
+namespace photoboss {
+
+    // CPU capabilities queried once at startup. Kernels pick their
+    // implementation from this, so a single binary runs everywhere.
+    struct CpuFeatures {
+        bool avx2 = false;
+        bool sha = false;    // SHA-NI (x86 SHA extensions)
+        bool avx512popcnt = false;   // AVX-512F with VPOPCNTDQ
+        bool neon = false;
+
+        static const CpuFeatures& get();
+    };
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <QThread>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace photoboss {
+
+    // Calls fn(i) for every i in [0, count) on up to `threads` threads (0
+    // or less: one per core), handing indices out in chunks of `grain`.
+    // Returns once every call has; the first exception thrown is rethrown
+    // here. fn must be safe to call concurrently for different i, and
+    // results that have to come out in order belong in a slot per i.
+    template <typename Fn>
+    void parallelFor(size_t count, int threads, Fn&& fn, size_t grain = 16)
+    {
+        if (threads <= 0)
+            threads = QThread::idealThreadCount();
+        grain = std::max<size_t>(grain, 1);
+        const size_t chunks = (count + grain - 1) / grain;
+        const size_t workers = std::min<size_t>(static_cast<size_t>(std::max(threads, 1)), chunks);
+
+        std::atomic<size_t> next{ 0 };
+        std::exception_ptr error;
+        std::atomic_flag failed = ATOMIC_FLAG_INIT;
+        const auto work = [&] {
+            for (;;) {
+                const size_t begin = next.fetch_add(grain, std::memory_order_relaxed);
+                if (begin >= count)
+                    return;
+                const size_t end = std::min(begin + grain, count);
+                try {
+                    for (size_t i = begin; i < end; ++i)
+                        fn(i);
+                } catch (...) {
+                    if (!failed.test_and_set())
+                        error = std::current_exception();
+                    next.store(count, std::memory_order_relaxed);
+                    return;
+                }
+            }
+        };
+
+        if (workers <= 1) {
+            work();
+        } else {
+            std::vector<std::thread> pool;
+            pool.reserve(workers - 1);
+            for (size_t t = 1; t < workers; ++t)
+                pool.emplace_back(work);
+            work();
+            for (std::thread& thread : pool)
+                thread.join();
+        }
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+}
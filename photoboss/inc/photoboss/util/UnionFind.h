@@ -0,0 +1,72 @@
+#pragma once
+#include <QtTypes>
+#include <utility>
+#include <vector>
+
+namespace photoboss {
+
+    // Disjoint sets that grow one element at a time, for a single writer.
+    // Each set carries a weight (1 per element unless the caller adds to
+    // it) and the lighter set is linked under the heavier, so a root is at
+    // most log2(total weight) steps from any element even for readers that
+    // skip the path halving find() does.
+    class UnionFind
+    {
+    public:
+        // New singleton set; returns its element
+        quint32 add(quint32 weight = 1)
+        {
+            const auto x = static_cast<quint32>(m_parent_.size());
+            m_parent_.push_back(x);
+            m_weight_.push_back(weight);
+            return x;
+        }
+
+        quint32 weight(quint32 x) { return m_weight_[find(x)]; }
+        void addWeight(quint32 x, quint32 weight) { m_weight_[find(x)] += weight; }
+
+        size_t size() const { return m_parent_.size(); }
+        void clear()
+        {
+            m_parent_.clear();
+            m_weight_.clear();
+        }
+
+        quint32 find(quint32 x)
+        {
+            while (m_parent_[x] != x) {
+                m_parent_[x] = m_parent_[m_parent_[x]];
+                x = m_parent_[x];
+            }
+            return x;
+        }
+
+        // Same without shortening paths, for callers that only read
+        quint32 root(quint32 x) const
+        {
+            while (m_parent_[x] != x)
+                x = m_parent_[x];
+            return x;
+        }
+
+        // Joins the sets of a and b; returns the root of the result, which
+        // is the root of the heavier one (a's on a tie)
+        quint32 unite(quint32 a, quint32 b)
+        {
+            a = find(a);
+            b = find(b);
+            if (a == b)
+                return a;
+            if (m_weight_[a] < m_weight_[b])
+                std::swap(a, b);
+            m_parent_[b] = a;
+            m_weight_[a] += m_weight_[b];
+            return a;
+        }
+
+    private:
+        std::vector<quint32> m_parent_;
+        std::vector<quint32> m_weight_;
+    };
+
+}
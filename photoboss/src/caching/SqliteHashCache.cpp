@@ -50,6 +50,59 @@ namespace photoboss
         return true;
     }
 
+    // hashes.hash_value of kind: the raw bytes for the content digest and
+    // the pyramid, a signed integer for the 64-bit kinds
+    static QVariant storedValue(const HashDigest& digest, HashKind kind)
+    {
+        switch (kind) {
+        case HashKind::Content:
+            return QByteArray(reinterpret_cast<const char*>(digest.content.data()), ContentDigestSize);
+        case HashKind::Pyramid:
+            return QByteArray(reinterpret_cast<const char*>(digest.pyramid.data()), sizeof(PyramidDigest));
+        default:
+            return static_cast<qint64>(digest.value(kind));
+        }
+    }
+
+    // Inverse of storedValue(); false for a blob of the wrong size
+    static bool readStoredValue(const QVariant& value, HashKind kind, HashDigest& digest)
+    {
+        switch (kind) {
+        case HashKind::Content: {
+            const QByteArray bytes = value.toByteArray();
+            if (bytes.size() != ContentDigestSize) return false;
+            ContentDigest content{};
+            std::memcpy(content.data(), bytes.constData(), ContentDigestSize);
+            digest.setContent(content);
+            return true;
+        }
+        case HashKind::Pyramid: {
+            const QByteArray bytes = value.toByteArray();
+            if (bytes.size() != static_cast<qsizetype>(sizeof(PyramidDigest))) return false;
+            PyramidDigest pyramid;
+            std::memcpy(pyramid.data(), bytes.constData(), sizeof(PyramidDigest));
+            digest.setPyramid(pyramid);
+            return true;
+        }
+        default:
+            digest.setValue(kind, static_cast<quint64>(value.toLongLong()));
+            return true;
+        }
+    }
+
+    // sharpness, clipped, jpeg_quality starting at column first
+    static ImageQuality readQuality(const QSqlQuery& query, int first)
+    {
+        ImageQuality quality;
+        if (!query.isNull(first) && !query.isNull(first + 1)) {
+            quality.sharpness = static_cast<float>(query.value(first).toDouble());
+            quality.clipped = static_cast<float>(query.value(first + 1).toDouble());
+        }
+        if (!query.isNull(first + 2))
+            quality.jpegQuality = query.value(first + 2).toInt();
+        return quality;
+    }
+
     void SqliteHashCache::ensureOpen()
     {
         if (m_initialized_)
@@ -159,12 +212,13 @@ namespace photoboss
         )");
         if (!execOrLog(q, "create hash_methods")) { q.exec("ROLLBACK;"); return false; }
 
-        // hashes table
+        // hashes table: 64-bit fingerprints as INTEGER, SHA-256 as a 32-byte
+        // BLOB (BLOB affinity keeps SQLite from coercing either to text)
         q.prepare(R"(
             CREATE TABLE IF NOT EXISTS hashes (
                 file_id INTEGER NOT NULL,
                 method_id INTEGER NOT NULL,
-                hash_value TEXT NOT NULL,
+                hash_value BLOB NOT NULL,
                 computed_at INTEGER NOT NULL,
                 PRIMARY KEY (file_id, method_id),
                 FOREIGN KEY (file_id) REFERENCES files(id) ON DELETE CASCADE,
@@ -223,6 +277,14 @@ namespace photoboss
         switch (version)
         {
         case 0: return migrate_0_to_1();
+        case 1: return migrate_1_to_2();
+        case 2: return migrate_2_to_3();
+        case 3: return migrate_3_to_4();
+        case 4: return migrate_4_to_5();
+        case 5: return migrate_5_to_6();
+        case 6: return migrate_6_to_7();
+        case 7: return migrate_7_to_8();
+        case 8: return migrate_8_to_9();
         default:
             qWarning() << "[SqliteHashCache] Unknown migration step:" << version;
             return false;
@@ -261,17 +323,247 @@ namespace photoboss
         return true;
     }
 
+    bool SqliteHashCache::migrate_1_to_2()
+    {
+        QSqlQuery q(m_db_);
+        if (!q.exec("BEGIN IMMEDIATE TRANSACTION;")) return false;
+
+        // pHash moved from a double-precision DCT to the fixed-point kernel.
+        // Bits near the median can flip, so drop only the stale pHash rows;
+        // the byte and other image hashes are unaffected.
+        q.prepare(R"(
+            DELETE FROM hashes WHERE method_id IN
+                (SELECT id FROM hash_methods WHERE key='Perceptual Hash');
+        )");
+        if (!execOrLog(q, "delete perceptual hashes")) { q.exec("ROLLBACK;"); return false; }
+
+        q.prepare("UPDATE meta SET value='2' WHERE key='schema_version';");
+        if (!execOrLog(q, "bump schema_version")) { q.exec("ROLLBACK;"); return false; }
+
+        q.exec("COMMIT;");
+        return true;
+    }
+
+    bool SqliteHashCache::migrate_2_to_3()
+    {
+        QSqlQuery q(m_db_);
+        if (!q.exec("BEGIN IMMEDIATE TRANSACTION;")) return false;
+
+        // The 32x32 hash plane is now built by the fused area-average kernel
+        // instead of QImage smooth scaling, so every image-based hash can
+        // shift slightly. SHA256 is byte-based and stays.
+        q.prepare(R"(
+            DELETE FROM hashes WHERE method_id IN
+                (SELECT id FROM hash_methods
+                 WHERE key IN ('Perceptual Hash', 'Difference Hash', 'Average Hash'));
+        )");
+        if (!execOrLog(q, "delete image hashes")) { q.exec("ROLLBACK;"); return false; }
+
+        q.prepare("UPDATE meta SET value='3' WHERE key='schema_version';");
+        if (!execOrLog(q, "bump schema_version")) { q.exec("ROLLBACK;"); return false; }
+
+        q.exec("COMMIT;");
+        return true;
+    }
+
+    bool SqliteHashCache::migrate_3_to_4()
+    {
+        QSqlQuery q(m_db_);
+        if (!q.exec("BEGIN IMMEDIATE TRANSACTION;")) return false;
+
+        // Decodes used to be squeezed into a ThumbnailWidth square; JPEGs now
+        // come from the IDCT-scaled luma path and everything keeps its aspect
+        // ratio. Image hashes shift, and the stored thumbnails were distorted.
+        q.prepare(R"(
+            DELETE FROM hashes WHERE method_id IN
+                (SELECT id FROM hash_methods
+                 WHERE key IN ('Perceptual Hash', 'Difference Hash', 'Average Hash'));
+        )");
+        if (!execOrLog(q, "delete image hashes")) { q.exec("ROLLBACK;"); return false; }
+        q.exec("DELETE FROM thumbnails;");
+        if (!execOrLog(q, "delete thumbnails")) { q.exec("ROLLBACK;"); return false; }
+
+        q.prepare("UPDATE meta SET value='4' WHERE key='schema_version';");
+        if (!execOrLog(q, "bump schema_version")) { q.exec("ROLLBACK;"); return false; }
+
+        q.exec("COMMIT;");
+        return true;
+    }
+
+    bool SqliteHashCache::migrate_4_to_5()
+    {
+        QSqlQuery q(m_db_);
+        if (!q.exec("BEGIN IMMEDIATE TRANSACTION;")) return false;
+
+        // Hash values move from hex TEXT to INTEGER / BLOB. The old column has
+        // TEXT affinity, which would turn integers back into text, so the
+        // table is rebuilt and every row converted. Rows that do not parse
+        // (error strings stored by older builds) are dropped and recompute.
+        q.prepare(R"(
+            CREATE TABLE hashes_typed (
+                file_id INTEGER NOT NULL,
+                method_id INTEGER NOT NULL,
+                hash_value BLOB NOT NULL,
+                computed_at INTEGER NOT NULL,
+                PRIMARY KEY (file_id, method_id),
+                FOREIGN KEY (file_id) REFERENCES files(id) ON DELETE CASCADE,
+                FOREIGN KEY (method_id) REFERENCES hash_methods(id) ON DELETE CASCADE
+            );
+        )");
+        if (!execOrLog(q, "create hashes_typed")) { q.exec("ROLLBACK;"); return false; }
+
+        QSqlQuery rows(m_db_);
+        rows.prepare(R"(
+            SELECT h.file_id, h.method_id, hm.key, h.hash_value, h.computed_at
+            FROM hashes h JOIN hash_methods hm ON hm.id = h.method_id;
+        )");
+        if (!execOrLog(rows, "read text hashes")) { q.exec("ROLLBACK;"); return false; }
+
+        q.prepare(R"(
+            INSERT INTO hashes_typed(file_id, method_id, hash_value, computed_at)
+            VALUES(:file, :method, :value, :time);
+        )");
+        while (rows.next()) {
+            const auto kind = hashKindFromKey(rows.value(2).toString());
+            if (!kind) continue;
+
+            const QString hex = rows.value(3).toString();
+            QVariant value;
+            if (*kind == HashKind::Content) {
+                const QByteArray sha = QByteArray::fromHex(hex.toLatin1());
+                if (hex.size() != 64 || sha.size() != 32) continue;
+                value = sha;
+            } else {
+                bool ok = false;
+                const quint64 v = hex.toULongLong(&ok, 16);
+                if (!ok) continue;
+                value = static_cast<qint64>(v);
+            }
+
+            q.bindValue(":file", rows.value(0));
+            q.bindValue(":method", rows.value(1));
+            q.bindValue(":value", value);
+            q.bindValue(":time", rows.value(4));
+            if (!execOrLog(q, "convert hash")) { q.exec("ROLLBACK;"); return false; }
+        }
+
+        q.prepare("DROP TABLE hashes;");
+        if (!execOrLog(q, "drop text hashes")) { q.exec("ROLLBACK;"); return false; }
+        q.prepare("ALTER TABLE hashes_typed RENAME TO hashes;");
+        if (!execOrLog(q, "rename hashes_typed")) { q.exec("ROLLBACK;"); return false; }
+
+        q.prepare("UPDATE meta SET value='5' WHERE key='schema_version';");
+        if (!execOrLog(q, "bump schema_version")) { q.exec("ROLLBACK;"); return false; }
+
+        q.exec("COMMIT;");
+        return true;
+    }
+
+    bool SqliteHashCache::migrate_5_to_6()
+    {
+        QSqlQuery q(m_db_);
+        if (!q.exec("BEGIN IMMEDIATE TRANSACTION;")) return false;
+
+        // Image hashes are reused across byte-identical files, looked up by
+        // SHA-256 value rather than by file
+        q.prepare("CREATE INDEX IF NOT EXISTS idx_hashes_value ON hashes(method_id, hash_value);");
+        if (!execOrLog(q, "create hash value index")) { q.exec("ROLLBACK;"); return false; }
+
+        q.prepare("UPDATE meta SET value='6' WHERE key='schema_version';");
+        if (!execOrLog(q, "bump schema_version")) { q.exec("ROLLBACK;"); return false; }
+
+        q.exec("COMMIT;");
+        return true;
+    }
+
+    bool SqliteHashCache::migrate_6_to_7()
+    {
+        QSqlQuery q(m_db_);
+        if (!q.exec("BEGIN IMMEDIATE TRANSACTION;")) return false;
+
+        // The normalised luma plane behind the image hashes, kept so a method
+        // whose version changes is rehashed without reading the file again
+        // (see upgradeMethods). size is the HashSampleSize it was built at.
+        q.prepare(R"(
+            CREATE TABLE IF NOT EXISTS planes (
+                file_id INTEGER PRIMARY KEY,
+                size INTEGER NOT NULL,
+                data BLOB NOT NULL,
+                FOREIGN KEY (file_id) REFERENCES files(id) ON DELETE CASCADE
+            );
+        )");
+        if (!execOrLog(q, "create planes")) { q.exec("ROLLBACK;"); return false; }
+
+        q.prepare("UPDATE meta SET value='7' WHERE key='schema_version';");
+        if (!execOrLog(q, "bump schema_version")) { q.exec("ROLLBACK;"); return false; }
+
+        q.exec("COMMIT;");
+        return true;
+    }
+
+    bool SqliteHashCache::migrate_7_to_8()
+    {
+        QSqlQuery q(m_db_);
+        if (!q.exec("BEGIN IMMEDIATE TRANSACTION;")) return false;
+
+        // Image quality measured while hashing, for picking the copy to keep.
+        // Existing rows stay NULL (unknown) until the file is hashed again.
+        q.prepare("ALTER TABLE files ADD COLUMN sharpness REAL;");
+        if (!execOrLog(q, "add sharpness")) { q.exec("ROLLBACK;"); return false; }
+        q.prepare("ALTER TABLE files ADD COLUMN clipped REAL;");
+        if (!execOrLog(q, "add clipped")) { q.exec("ROLLBACK;"); return false; }
+        q.prepare("ALTER TABLE files ADD COLUMN jpeg_quality INTEGER;");
+        if (!execOrLog(q, "add jpeg_quality")) { q.exec("ROLLBACK;"); return false; }
+
+        q.prepare("UPDATE meta SET value='8' WHERE key='schema_version';");
+        if (!execOrLog(q, "bump schema_version")) { q.exec("ROLLBACK;"); return false; }
+
+        q.exec("COMMIT;");
+        return true;
+    }
+
+    bool SqliteHashCache::migrate_8_to_9()
+    {
+        QSqlQuery q(m_db_);
+        if (!q.exec("BEGIN IMMEDIATE TRANSACTION;")) return false;
+
+        // Files that could not be read or decoded (kind is a FileFailure),
+        // so an unchanged one is skipped instead of retried on every scan.
+        // Kept apart from files: a failed file has no hashes, and an
+        // unreadable one may never have had a row there.
+        q.prepare(R"(
+            CREATE TABLE IF NOT EXISTS failures (
+                name TEXT NOT NULL,
+                path TEXT NOT NULL,
+                size INTEGER NOT NULL,
+                modified_time INTEGER NOT NULL,
+                kind INTEGER NOT NULL,
+                last_seen_scan_id INTEGER,
+                PRIMARY KEY (name, path)
+            );
+        )");
+        if (!execOrLog(q, "create failures")) { q.exec("ROLLBACK;"); return false; }
+
+        q.prepare("UPDATE meta SET value='9' WHERE key='schema_version';");
+        if (!execOrLog(q, "bump schema_version")) { q.exec("ROLLBACK;"); return false; }
+
+        q.exec("COMMIT;");
+        return true;
+    }
+
     // -----------------------------
     // Ensure hash method exists
     // -----------------------------
 
+    // version is only recorded for a new key; an existing key's version
+    // describes its stored rows and moves in upgradeMethods()
     bool SqliteHashCache::ensureMethod(const QString& key, int version, int& outMethodId)
     {
         QSqlQuery q(m_db_);
         q.prepare(R"(
             INSERT INTO hash_methods(key, version)
             VALUES(:key, :version)
-            ON CONFLICT(key) DO UPDATE SET version=excluded.version;
+            ON CONFLICT(key) DO NOTHING;
         )");
         q.bindValue(":key", key);
         q.bindValue(":version", version);
@@ -334,36 +626,50 @@ namespace photoboss
         if (!m_valid_) return { Lookup::Error, cacheQuery.fileIdentity };
 
         QSqlQuery q(m_db_);
-        // single query: file, exif, all requested hashes
+        // single query: file, exif, plane, all requested hashes
+        const QList<QString> methods = cacheQuery.hashMethods + cacheQuery.optionalMethods;
         QString placeholders;
-        for (int i = 0; i < cacheQuery.hashMethods.size(); ++i) {
+        for (int i = 0; i < methods.size(); ++i) {
             if (i) placeholders += ",";
             placeholders += "?";
         }
 
+        // The method filter sits in the joins so a known file comes back
+        // even when none of its hashes are stored
         QString sql = QString(R"(
             SELECT f.id, f.width, f.height, e.orientation, e.datetime_original,
-                   e.camera_make, e.camera_model, hm.key, h.hash_value
+                   e.camera_make, e.camera_model, hm.key, h.hash_value, p.data,
+                   f.sharpness, f.clipped, f.jpeg_quality
             FROM files f
             LEFT JOIN file_exif e ON e.file_id=f.id
-            LEFT JOIN hashes h ON h.file_id=f.id
-            LEFT JOIN hash_methods hm ON hm.id=h.method_id
-            WHERE f.name=? AND f.path=? AND f.size=? AND f.modified_time=? AND hm.key IN (%1);
+            LEFT JOIN planes p ON p.file_id=f.id AND p.size=?
+            LEFT JOIN hash_methods hm ON hm.key IN (%1)
+            LEFT JOIN hashes h ON h.file_id=f.id AND h.method_id=hm.id
+            WHERE f.name=? AND f.path=? AND f.size=? AND f.modified_time=?;
         )").arg(placeholders);
 
         q.prepare(sql);
+        q.addBindValue(settings::HashSampleSize);
+        for (const auto& key : methods)
+            q.addBindValue(key);
         q.addBindValue(cacheQuery.fileIdentity.name());
         q.addBindValue(cacheQuery.fileIdentity.path());
         q.addBindValue(cacheQuery.fileIdentity.size());
         q.addBindValue(cacheQuery.fileIdentity.modifiedTime());
-        for (const auto& key : cacheQuery.hashMethods)
-            q.addBindValue(key);
 
         if (!q.exec()) return { Lookup::Error, cacheQuery.fileIdentity };
-        if (!q.next()) return { Lookup::Miss, cacheQuery.fileIdentity };
+        if (!q.next()) {
+            // Not hashed as it is now; it may have failed as it is now
+            if (const auto failure = lookupFailure(cacheQuery.fileIdentity)) {
+                CacheLookupResult failed{ Lookup::Failed, { cacheQuery.fileIdentity, HashSource::Error } };
+                failed.hashedImage.failure = *failure;
+                return failed;
+            }
+            return { Lookup::Miss, cacheQuery.fileIdentity };
+        }
 
         const int fileId = q.value(0).toInt();
-        HashedImageResult result{ cacheQuery.fileIdentity, HashSource::Cache, QDateTime{}, QSize{}, {} };
+        HashedImageResult result{ cacheQuery.fileIdentity, HashSource::Cache, QDateTime{}, QSize{}, HashDigest{} };
         if (!q.isNull(1) && !q.isNull(2)) result.resolution = { q.value(1).toInt(), q.value(2).toInt() };
 
         ExifData cachedExif;
@@ -371,41 +677,190 @@ namespace photoboss
         if (!q.isNull(4)) cachedExif.dateTimeOriginal = q.value(4).toULongLong();
         if (!q.isNull(5)) cachedExif.cameraMake = q.value(5).toString();
         if (!q.isNull(6)) cachedExif.cameraModel = q.value(6).toString();
+        if (!q.isNull(9)) result.plane = q.value(9).toByteArray();
+        result.quality = readQuality(q, 10);
         QSet<QString> requestedMethods{ cacheQuery.hashMethods.begin(), cacheQuery.hashMethods.end() };
         QSet<QString> foundMethods;
 
         do {
             if (!q.isNull(7) && !q.isNull(8)) {
                 const QString methodKey = q.value(7).toString();
-                const QString hashValue = q.value(8).toString();
-                result.hashes.emplace(methodKey, hashValue);
+                const auto kind = hashKindFromKey(methodKey);
+                if (!kind) continue;
+
+                if (!readStoredValue(q.value(8), *kind, result.digest)) continue;
                 foundMethods.insert(methodKey);
             }
         } while (q.next());
 
-        if (foundMethods == requestedMethods) {
+        result.storedKinds = result.digest.present;
+
+        if (foundMethods.contains(requestedMethods)) {
             // cache hit - mark as seen for this scan
             updateScanIdForFile(fileId);
             return { Lookup::Hit, result };
-        } 
-        
+        }
+
+        // Unchanged file missing some methods (new, or dropped by an upgrade):
+        // worth returning if anything stored saves work
+        if (!foundMethods.isEmpty() || !result.plane.isEmpty()) {
+            CacheLookupResult partial{ Lookup::Partial, result };
+            for (const auto& key : cacheQuery.hashMethods) {
+                if (!foundMethods.contains(key))
+                    partial.missingMethods.append(key);
+            }
+            return partial;
+        }
+
         return CacheLookupResult{ Lookup::Miss, cacheQuery.fileIdentity };
     }
 
+    std::optional<FileFailure> SqliteHashCache::lookupFailure(const FileIdentity& fileIdentity)
+    {
+        QSqlQuery q(m_db_);
+        q.prepare(R"(
+            SELECT kind FROM failures
+            WHERE name=:name AND path=:path AND size=:size AND modified_time=:mtime;
+        )");
+        q.bindValue(":name", fileIdentity.name());
+        q.bindValue(":path", fileIdentity.path());
+        q.bindValue(":size", fileIdentity.size());
+        q.bindValue(":mtime", fileIdentity.modifiedTime());
+        if (!execOrLog(q, "lookup failure") || !q.next())
+            return std::nullopt;
+
+        const auto kind = static_cast<FileFailure>(q.value(0).toInt());
+        if (kind == FileFailure::None)
+            return std::nullopt;
+
+        QSqlQuery seen(m_db_);
+        seen.prepare("UPDATE failures SET last_seen_scan_id=:scan WHERE name=:name AND path=:path;");
+        seen.bindValue(":scan", m_scanId_);
+        seen.bindValue(":name", fileIdentity.name());
+        seen.bindValue(":path", fileIdentity.path());
+        seen.exec();
+        return kind;
+    }
+
+    std::optional<ContentHashes> SqliteHashCache::lookupContent(
+        const ContentDigest& content, const QList<QString>& hashMethods)
+    {
+        ensureOpen();
+        if (!m_valid_ || hashMethods.isEmpty()) return std::nullopt;
+
+        QString placeholders;
+        for (int i = 0; i < hashMethods.size(); ++i) {
+            if (i) placeholders += ",";
+            placeholders += "?";
+        }
+
+        // Every file holding this content, each with its requested hashes;
+        // the first file that has all of them wins
+        QSqlQuery q(m_db_);
+        q.prepare(QString(R"(
+            SELECT s.file_id, f.width, f.height, hm.key, h.hash_value, p.data,
+                   f.sharpness, f.clipped, f.jpeg_quality
+            FROM hashes s
+            JOIN files f ON f.id = s.file_id
+            JOIN hashes h ON h.file_id = s.file_id
+            JOIN hash_methods hm ON hm.id = h.method_id
+            LEFT JOIN planes p ON p.file_id = s.file_id AND p.size = ?
+            WHERE s.method_id = (SELECT id FROM hash_methods WHERE key=?)
+              AND s.hash_value = ? AND hm.key IN (%1)
+            ORDER BY s.file_id;
+        )").arg(placeholders));
+        q.addBindValue(settings::HashSampleSize);
+        q.addBindValue(hashKindKey(HashKind::Content));
+        q.addBindValue(QByteArray(reinterpret_cast<const char*>(content.data()),
+            ContentDigestSize));
+        for (const auto& key : hashMethods)
+            q.addBindValue(key);
+
+        if (!execOrLog(q, "lookup content")) return std::nullopt;
+
+        const QSet<QString> requestedMethods{ hashMethods.begin(), hashMethods.end() };
+        QSet<QString> foundMethods;
+        ContentHashes found;
+        int fileId = -1;
+
+        while (q.next()) {
+            if (q.value(0).toInt() != fileId) {
+                if (fileId != -1 && foundMethods == requestedMethods)
+                    break;
+                fileId = q.value(0).toInt();
+                foundMethods.clear();
+                found = {};
+                if (!q.isNull(1) && !q.isNull(2))
+                    found.resolution = { q.value(1).toInt(), q.value(2).toInt() };
+                if (!q.isNull(5))
+                    found.plane = q.value(5).toByteArray();
+                found.quality = readQuality(q, 6);
+            }
+
+            const QString methodKey = q.value(3).toString();
+            const auto kind = hashKindFromKey(methodKey);
+            if (!kind) continue;
+
+            if (!readStoredValue(q.value(4), *kind, found.digest)) continue;
+            foundMethods.insert(methodKey);
+        }
+
+        if (fileId == -1 || foundMethods != requestedMethods)
+            return std::nullopt;
+        return found;
+    }
+
     // -----------------------------
     // Optimized Store
     // -----------------------------
 
+    bool SqliteHashCache::storeFailure(QSqlQuery& q, const HashedImageResult& result)
+    {
+        q.prepare(R"(
+            INSERT INTO failures(name, path, size, modified_time, kind, last_seen_scan_id)
+            VALUES(:name, :path, :size, :mtime, :kind, :scan)
+            ON CONFLICT(name, path) DO UPDATE SET
+                size=excluded.size, modified_time=excluded.modified_time,
+                kind=excluded.kind, last_seen_scan_id=excluded.last_seen_scan_id;
+        )");
+        q.bindValue(":name", result.fileIdentity.name());
+        q.bindValue(":path", result.fileIdentity.path());
+        q.bindValue(":size", result.fileIdentity.size());
+        q.bindValue(":mtime", result.fileIdentity.modifiedTime());
+        q.bindValue(":kind", static_cast<int>(result.failure));
+        q.bindValue(":scan", m_scanId_);
+        if (!execOrLog(q, "upsert failure")) return false;
+
+        // Whatever was stored for an earlier version of the file is stale
+        q.prepare("DELETE FROM files WHERE name=:name AND path=:path;");
+        q.bindValue(":name", result.fileIdentity.name());
+        q.bindValue(":path", result.fileIdentity.path());
+        return execOrLog(q, "drop failed file");
+    }
+
     bool SqliteHashCache::storeItem(QSqlQuery& q, const HashedImageResult& result,
         const QMap<QString, int>& methodVersions)
     {
+        if (result.failure != FileFailure::None)
+            return storeFailure(q, result);
+
+        // A file that hashes no longer needs its failure record
+        q.prepare("DELETE FROM failures WHERE name=:name AND path=:path;");
+        q.bindValue(":name", result.fileIdentity.name());
+        q.bindValue(":path", result.fileIdentity.path());
+        if (!execOrLog(q, "clear failure")) return false;
+
         // upsert file
         q.prepare(R"(
-            INSERT INTO files(name, path, size, modified_time, format, width, height, last_seen_scan_id)
-            VALUES(:name, :path, :size, :mtime, :format, :width, :height, :scan)
+            INSERT INTO files(name, path, size, modified_time, format, width, height,
+                              sharpness, clipped, jpeg_quality, last_seen_scan_id)
+            VALUES(:name, :path, :size, :mtime, :format, :width, :height,
+                   :sharpness, :clipped, :jpegq, :scan)
             ON CONFLICT(name, path) DO UPDATE SET
                 size=excluded.size, modified_time=excluded.modified_time,
                 format=excluded.format, width=excluded.width, height=excluded.height,
+                sharpness=excluded.sharpness, clipped=excluded.clipped,
+                jpeg_quality=excluded.jpeg_quality,
                 last_seen_scan_id=excluded.last_seen_scan_id;
         )");
         q.bindValue(":name", result.fileIdentity.name());
@@ -415,6 +870,10 @@ namespace photoboss
         q.bindValue(":format", result.fileIdentity.extension());
         q.bindValue(":width", result.resolution.width());
         q.bindValue(":height", result.resolution.height());
+        const ImageQuality& quality = result.quality;
+        q.bindValue(":sharpness", quality.measured() ? QVariant(double(quality.sharpness)) : QVariant());
+        q.bindValue(":clipped", quality.measured() ? QVariant(double(quality.clipped)) : QVariant());
+        q.bindValue(":jpegq", quality.jpegQuality ? QVariant(quality.jpegQuality) : QVariant());
         q.bindValue(":scan", m_scanId_);
 
         if (!execOrLog(q, "upsert file")) return false;
@@ -427,10 +886,14 @@ namespace photoboss
         const int fileId = q.value(0).toInt();
         const qint64 now = QDateTime::currentSecsSinceEpoch();
 
-        // upsert hashes
-        for (auto it = result.hashes.begin(); it != result.hashes.end(); ++it) {
+        // upsert hashes, skipping rows the cache already holds
+        for (int k = 0; k < HashKindCount; ++k) {
+            const auto kind = static_cast<HashKind>(k);
+            if (!result.digest.has(kind) || (result.storedKinds & HashDigest::bit(kind))) continue;
+
+            const QString key = hashKindKey(kind);
             int methodId;
-            if (!ensureMethod(it->first, methodVersions.value(it->first, 0), methodId)) return false;
+            if (!ensureMethod(key, methodVersions.value(key, 0), methodId)) return false;
 
             QSqlQuery hq(m_db_);
             hq.prepare(R"(
@@ -441,12 +904,45 @@ namespace photoboss
             )");
             hq.bindValue(":file", fileId);
             hq.bindValue(":method", methodId);
-            hq.bindValue(":value", it->second);
+            hq.bindValue(":value", storedValue(result.digest, kind));
             hq.bindValue(":time", now);
 
             if (!execOrLog(hq, "upsert hash")) return false;
         }
 
+        // Rows for kinds this result lacks (lazy hashes, failures) would
+        // describe the file's previous content
+        for (int k = 0; k < HashKindCount; ++k) {
+            const auto kind = static_cast<HashKind>(k);
+            if (result.digest.has(kind)) continue;
+
+            QSqlQuery dq(m_db_);
+            dq.prepare(R"(
+                DELETE FROM hashes WHERE file_id=:file
+                  AND method_id=(SELECT id FROM hash_methods WHERE key=:key);
+            )");
+            dq.bindValue(":file", fileId);
+            dq.bindValue(":key", hashKindKey(kind));
+            if (!execOrLog(dq, "delete stale hash")) return false;
+        }
+
+        // upsert plane; a result without one leaves nothing stale behind
+        QSqlQuery pq(m_db_);
+        if (!result.plane.isEmpty()) {
+            pq.prepare(R"(
+                INSERT INTO planes(file_id, size, data)
+                VALUES(:file, :size, :data)
+                ON CONFLICT(file_id) DO UPDATE SET
+                    size=excluded.size, data=excluded.data;
+            )");
+            pq.bindValue(":size", settings::HashSampleSize);
+            pq.bindValue(":data", result.plane);
+        } else {
+            pq.prepare("DELETE FROM planes WHERE file_id=:file;");
+        }
+        pq.bindValue(":file", fileId);
+        if (!execOrLog(pq, "upsert plane")) return false;
+
         // upsert exif
         const ExifData& exif = result.fileIdentity.exif();
         QSqlQuery ex(m_db_);
@@ -539,6 +1035,117 @@ namespace photoboss
         q.exec("COMMIT;");
     }
 
+    // -----------------------------
+    // Method versions
+    // -----------------------------
+
+    int SqliteHashCache::upgradeMethods(const QMap<QString, int>& methodVersions, const PlaneRehash& rehash)
+    {
+        ensureOpen();
+        if (!m_valid_) return 0;
+
+        // Methods whose stored rows came from another version
+        QSqlQuery q(m_db_);
+        q.prepare("SELECT id, key, version FROM hash_methods;");
+        if (!execOrLog(q, "read method versions")) return 0;
+
+        std::vector<std::pair<int, HashKind>> stale;   // method id, kind
+        QString methodIds;
+        while (q.next()) {
+            const QString key = q.value(1).toString();
+            const auto kind = hashKindFromKey(key);
+            if (!kind || !methodVersions.contains(key) || methodVersions.value(key) == q.value(2).toInt())
+                continue;
+            stale.emplace_back(q.value(0).toInt(), *kind);
+            if (!methodIds.isEmpty()) methodIds += ",";
+            methodIds += QString::number(q.value(0).toInt());
+        }
+        if (stale.empty()) return 0;
+
+        if (!q.exec("BEGIN IMMEDIATE TRANSACTION;")) return 0;
+
+        // Files holding a stale row, in id order and a page at a time so the
+        // planes in memory stay bounded
+        constexpr int PageSize = 256;
+        QSqlQuery page(m_db_);
+        page.prepare(QString(R"(
+            SELECT DISTINCT h.file_id, p.data
+            FROM hashes h
+            LEFT JOIN planes p ON p.file_id = h.file_id AND p.size = :size
+            WHERE h.method_id IN (%1) AND h.file_id > :after
+            ORDER BY h.file_id
+            LIMIT %2;
+        )").arg(methodIds).arg(PageSize));
+
+        QSqlQuery update(m_db_);
+        update.prepare(R"(
+            UPDATE hashes SET hash_value=:value, computed_at=:time
+            WHERE file_id=:file AND method_id=:method;
+        )");
+        QSqlQuery drop(m_db_);
+        drop.prepare("DELETE FROM hashes WHERE file_id=:file AND method_id=:method;");
+
+        const qint64 now = QDateTime::currentSecsSinceEpoch();
+        std::vector<int> fileIds;
+        std::vector<QByteArray> planes;
+        int rehashed = 0;
+        int after = -1;
+
+        while (true) {
+            page.bindValue(":size", settings::HashSampleSize);
+            page.bindValue(":after", after);
+            if (!execOrLog(page, "page stale hashes")) { q.exec("ROLLBACK;"); return 0; }
+
+            fileIds.clear();
+            planes.clear();
+            while (page.next()) {
+                fileIds.push_back(page.value(0).toInt());
+                planes.push_back(page.isNull(1) ? QByteArray() : page.value(1).toByteArray());
+            }
+            if (fileIds.empty()) break;
+            after = fileIds.back();
+
+            // Rehash whatever has a plane; the rest keeps an empty digest
+            std::vector<HashDigest> digests(fileIds.size());
+            std::vector<const QByteArray*> withPlane;
+            std::vector<HashDigest*> targets;
+            for (size_t i = 0; i < fileIds.size(); ++i) {
+                if (planes[i].isEmpty()) continue;
+                withPlane.push_back(&planes[i]);
+                targets.push_back(&digests[i]);
+            }
+            if (!withPlane.empty()) {
+                rehash(withPlane, targets);
+                rehashed += static_cast<int>(withPlane.size());
+            }
+
+            for (size_t i = 0; i < fileIds.size(); ++i) {
+                for (const auto& [methodId, kind] : stale) {
+                    QSqlQuery& row = digests[i].has(kind) ? update : drop;
+                    row.bindValue(":file", fileIds[i]);
+                    row.bindValue(":method", methodId);
+                    if (digests[i].has(kind)) {
+                        row.bindValue(":value", storedValue(digests[i], kind));
+                        row.bindValue(":time", now);
+                    }
+                    if (!execOrLog(row, "upgrade hash")) { q.exec("ROLLBACK;"); return 0; }
+                }
+            }
+        }
+
+        q.prepare("UPDATE hash_methods SET version=:version WHERE id=:id;");
+        for (const auto& [methodId, kind] : stale) {
+            q.bindValue(":version", methodVersions.value(hashKindKey(kind)));
+            q.bindValue(":id", methodId);
+            if (!execOrLog(q, "update method version")) { q.exec("ROLLBACK;"); return 0; }
+        }
+
+        q.exec("COMMIT;");
+        qDebug() << "[SqliteHashCache] Upgraded" << stale.size() << "hash methods,"
+            << rehashed << "files rehashed from planes";
+        return rehashed;
+    }
+
     std::optional<QImage> SqliteHashCache::getThumbnail(
         const FileIdentity& fi, int width, int rotation)
     {
@@ -618,8 +1225,17 @@ namespace photoboss
         q.bindValue(":scanId", m_scanId_);
 
         if (!execOrLog(q, "prune files")) return;
+        const int pruned = q.numRowsAffected();
+
+        q.prepare(R"(
+            DELETE FROM failures
+            WHERE path=:path AND (last_seen_scan_id IS NULL OR last_seen_scan_id!=:scanId);
+        )");
+        q.bindValue(":path", path);
+        q.bindValue(":scanId", m_scanId_);
+        if (!execOrLog(q, "prune failures")) return;
 
-        qDebug() << "[SqliteHashCache] Pruned" << q.numRowsAffected() << "stale entries for root" << path;
+        qDebug() << "[SqliteHashCache] Pruned" << pruned + q.numRowsAffected() << "stale entries for root" << path;
     }
 
 } // namespace photoboss
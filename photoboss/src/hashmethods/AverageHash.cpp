@@ -1,6 +1,6 @@
 #include "hashing/AverageHash.h"
 namespace photoboss {
-    QString AverageHash::compute(const PerceptualImage& image)
+    void AverageHash::hash(const PerceptualImage& image, HashDigest& digest)
     {
         // Sample offset to centre
         static constexpr int SampleWidth = 8;
@@ -32,24 +32,7 @@ namespace photoboss {
             }
         }
 
-        return QString("%1")
-            .arg(hash, 16, 16, QChar('0'))
-            .toUpper();
-    }
-
-    double AverageHash::compare(const QString& hash1, const QString& hash2) const
-    {
-        constexpr double MaxBits = 32.0;
-        uint64_t a = hash1.toULongLong(nullptr, 16);
-        uint64_t b = hash2.toULongLong(nullptr, 16);
-        uint64_t diff = a ^ b;
-        double distance = static_cast<double>(std::popcount(diff));
-        return std::clamp(1.0 - (distance / MaxBits), 0.0, 1.0);
-    }
-
-    HashInput AverageHash::inputType() const
-    {
-        return HashInput::Image;
+        digest.setValue(HashKind::Average, hash);
     }
 
 }
\ No newline at end of file
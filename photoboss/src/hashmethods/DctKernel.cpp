@@ -0,0 +1,443 @@
+#include "hashing/DctKernel.h"
+#include "util/AppSettings.h"
+#include "util/CpuFeatures.h"
+#include <cstring>
+#include <utility>
+
+#if defined(PHOTOBOSS_X86)
+#include <immintrin.h>
+#elif defined(PHOTOBOSS_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace photoboss::dct {
+
+    static_assert(settings::HashSampleSize == 32, "DCT kernel is specialised for a 32x32 plane");
+
+    static constexpr int N = 32;
+    static constexpr int K = 8;
+
+    // Basis coefficients are stored as round(c * 2^13), |c| <= 0.25, so they
+    // fit int16 and one pass over 32 pixels stays below 2^24. The row pass is
+    // rounded back down by 2^10 into int16 before the column pass, which
+    // keeps the final 32-term sums below 2^31.
+    static constexpr int BasisBits = 13;
+    static constexpr int RowPassShift = 10;
+    static constexpr qint32 RowPassRound = 1 << (RowPassShift - 1);
+
+    // ---------------------------------------------------------------
+    // Compile-time basis tables
+    // ---------------------------------------------------------------
+
+    static constexpr double Pi = 3.14159265358979323846;
+
+    static constexpr double constexprSqrt(double x)
+    {
+        double r = x > 1.0 ? x : 1.0;
+        for (int i = 0; i < 64; ++i)
+            r = 0.5 * (r + x / r);
+        return r;
+    }
+
+    static constexpr double constexprCos(double x)
+    {
+        while (x > Pi) x -= 2.0 * Pi;
+        while (x < -Pi) x += 2.0 * Pi;
+        double term = 1.0;
+        double sum = 1.0;
+        for (int n = 1; n < 24; ++n) {
+            term *= -x * x / ((2.0 * n - 1.0) * (2.0 * n));
+            sum += term;
+        }
+        return sum;
+    }
+
+    static constexpr qint16 toFixed(double v)
+    {
+        const double s = v * (1 << BasisBits);
+        return static_cast<qint16>(s >= 0.0 ? s + 0.5 : s - 0.5);
+    }
+
+    // Two int16 lanes packed the way madd_epi16 consumes them: lo is the
+    // even element, hi the odd one.
+    static constexpr qint32 packPair(qint16 lo, qint16 hi)
+    {
+        return static_cast<qint32>(
+            (static_cast<quint32>(static_cast<quint16>(hi)) << 16) |
+            static_cast<quint16>(lo));
+    }
+
+    struct Tables {
+        qint16 basis[K][N] = {};       // DCT-II rows 0..7
+        qint16 transposed[N][K] = {};  // basis^T, for the column pass
+        qint32 rowPairs[K][N / 2] = {};   // (basis[i][2p], basis[i][2p+1])
+        qint32 colPairs[N / 2][K] = {};   // (basis[j][2p], basis[j][2p+1])
+    };
+
+    static constexpr Tables makeTables()
+    {
+        Tables t;
+        for (int i = 0; i < K; ++i) {
+            const double alpha = (i == 0) ? constexprSqrt(1.0 / N) : constexprSqrt(2.0 / N);
+            for (int j = 0; j < N; ++j) {
+                t.basis[i][j] = toFixed(alpha * constexprCos((Pi * i * (2.0 * j + 1.0)) / (2.0 * N)));
+                t.transposed[j][i] = t.basis[i][j];
+            }
+        }
+        for (int i = 0; i < K; ++i)
+            for (int p = 0; p < N / 2; ++p) {
+                t.rowPairs[i][p] = packPair(t.basis[i][2 * p], t.basis[i][2 * p + 1]);
+                t.colPairs[p][i] = t.rowPairs[i][p];
+            }
+        return t;
+    }
+
+    alignas(32) static constexpr Tables kTables = makeTables();
+
+    // ---------------------------------------------------------------
+    // Scalar reference
+    // ---------------------------------------------------------------
+
+    static void lowFrequencyScalar(const uchar* plane, int stride, qint32* out)
+    {
+        // Row pass: temp = basis (8x32) * pixels (32x32)
+        qint32 temp[K][N];
+        for (int i = 0; i < K; ++i) {
+            qint32 acc[N] = {};
+            for (int k = 0; k < N; ++k) {
+                const qint32 coeff = kTables.basis[i][k];
+                const uchar* row = plane + k * stride;
+                for (int j = 0; j < N; ++j)
+                    acc[j] += coeff * static_cast<qint32>(row[j]);
+            }
+            for (int j = 0; j < N; ++j)
+                temp[i][j] = (acc[j] + RowPassRound) >> RowPassShift;
+        }
+
+        // Column pass: out = temp (8x32) * basis^T (32x8)
+        for (int i = 0; i < K; ++i) {
+            qint32 acc[K] = {};
+            for (int k = 0; k < N; ++k) {
+                const qint32 t = temp[i][k];
+                for (int j = 0; j < K; ++j)
+                    acc[j] += t * kTables.transposed[k][j];
+            }
+            for (int j = 0; j < K; ++j)
+                out[i * K + j] = acc[j];
+        }
+    }
+
+    // ---------------------------------------------------------------
+    // AVX2
+    // ---------------------------------------------------------------
+
+#if defined(PHOTOBOSS_X86)
+    PHOTOBOSS_TARGET_AVX2
+    static void lowFrequencyAvx2(const uchar* plane, int stride, qint32* out)
+    {
+        // Widen rows to int16 and interleave row 2p with row 2p+1, so one
+        // madd_epi16 applies two basis coefficients per column. unpacklo/hi
+        // permute columns within each 128-bit lane; packs_epi32 below undoes
+        // exactly that permutation.
+        __m256i lo[N / 2][2];
+        __m256i hi[N / 2][2];
+        for (int p = 0; p < N / 2; ++p) {
+            const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(plane + (2 * p) * stride));
+            const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(plane + (2 * p + 1) * stride));
+            for (int h = 0; h < 2; ++h) {
+                const __m256i a16 = _mm256_cvtepu8_epi16(h ? _mm256_extracti128_si256(a, 1) : _mm256_castsi256_si128(a));
+                const __m256i b16 = _mm256_cvtepu8_epi16(h ? _mm256_extracti128_si256(b, 1) : _mm256_castsi256_si128(b));
+                lo[p][h] = _mm256_unpacklo_epi16(a16, b16);
+                hi[p][h] = _mm256_unpackhi_epi16(a16, b16);
+            }
+        }
+
+        // Row pass
+        alignas(32) qint16 temp[K][N];
+        const __m256i round = _mm256_set1_epi32(RowPassRound);
+        for (int i = 0; i < K; ++i) {
+            for (int h = 0; h < 2; ++h) {
+                __m256i accLo = _mm256_setzero_si256();
+                __m256i accHi = _mm256_setzero_si256();
+                for (int p = 0; p < N / 2; ++p) {
+                    const __m256i c = _mm256_set1_epi32(kTables.rowPairs[i][p]);
+                    accLo = _mm256_add_epi32(accLo, _mm256_madd_epi16(lo[p][h], c));
+                    accHi = _mm256_add_epi32(accHi, _mm256_madd_epi16(hi[p][h], c));
+                }
+                accLo = _mm256_srai_epi32(_mm256_add_epi32(accLo, round), RowPassShift);
+                accHi = _mm256_srai_epi32(_mm256_add_epi32(accHi, round), RowPassShift);
+                _mm256_store_si256(reinterpret_cast<__m256i*>(&temp[i][16 * h]),
+                    _mm256_packs_epi32(accLo, accHi));
+            }
+        }
+
+        // Column pass: each madd yields the eight outputs of row i for one
+        // pair of k.
+        for (int i = 0; i < K; ++i) {
+            __m256i acc = _mm256_setzero_si256();
+            for (int p = 0; p < N / 2; ++p) {
+                qint32 pair;
+                std::memcpy(&pair, &temp[i][2 * p], sizeof(pair));
+                const __m256i basisT = _mm256_load_si256(reinterpret_cast<const __m256i*>(kTables.colPairs[p]));
+                acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_set1_epi32(pair), basisT));
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * K), acc);
+        }
+    }
+    // The batch is one matrix product, basis (8x32) times the 32 x 32N
+    // matrix [P0 | P1 | ...], walked in 16-column blocks of BatchGroup planes
+    // at a time. Each coefficient broadcast in the row pass and each basis^T
+    // load in the column pass is reused across the whole group instead of a
+    // single plane, and the independent accumulators keep the madd ports busy.
+    static constexpr int BatchGroup = 4;
+
+    PHOTOBOSS_TARGET_AVX2
+    static inline void storeRowAvx2(qint16* dst, __m256i accLo, __m256i accHi, __m256i round)
+    {
+        accLo = _mm256_srai_epi32(_mm256_add_epi32(accLo, round), RowPassShift);
+        accHi = _mm256_srai_epi32(_mm256_add_epi32(accHi, round), RowPassShift);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(dst), _mm256_packs_epi32(accLo, accHi));
+    }
+
+    PHOTOBOSS_TARGET_AVX2
+    static inline __m256i broadcastPairAvx2(const qint16* row, int p)
+    {
+        qint32 pair;
+        std::memcpy(&pair, row + 2 * p, sizeof(pair));
+        return _mm256_set1_epi32(pair);
+    }
+
+    PHOTOBOSS_TARGET_AVX2
+    static void lowFrequencyGroupAvx2(const uchar* const* planes, int stride, qint32* out)
+    {
+        constexpr int Blocks = 2 * BatchGroup;  // 16-column blocks in the group
+
+        __m256i lo[Blocks][N / 2];
+        __m256i hi[Blocks][N / 2];
+        for (int g = 0; g < BatchGroup; ++g) {
+            const uchar* plane = planes[g];
+            for (int p = 0; p < N / 2; ++p) {
+                const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(plane + (2 * p) * stride));
+                const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(plane + (2 * p + 1) * stride));
+                for (int h = 0; h < 2; ++h) {
+                    const __m256i a16 = _mm256_cvtepu8_epi16(h ? _mm256_extracti128_si256(a, 1) : _mm256_castsi256_si128(a));
+                    const __m256i b16 = _mm256_cvtepu8_epi16(h ? _mm256_extracti128_si256(b, 1) : _mm256_castsi256_si128(b));
+                    lo[2 * g + h][p] = _mm256_unpacklo_epi16(a16, b16);
+                    hi[2 * g + h][p] = _mm256_unpackhi_epi16(a16, b16);
+                }
+            }
+        }
+
+        // Row pass, four column blocks per coefficient broadcast. The four
+        // blocks are spelled out so the eight accumulators stay in registers.
+        alignas(32) qint16 temp[BatchGroup][K][N];
+        const __m256i round = _mm256_set1_epi32(RowPassRound);
+        for (int i = 0; i < K; ++i) {
+            for (int b = 0; b < Blocks; b += 4) {
+                __m256i lo0 = _mm256_setzero_si256(), hi0 = _mm256_setzero_si256();
+                __m256i lo1 = _mm256_setzero_si256(), hi1 = _mm256_setzero_si256();
+                __m256i lo2 = _mm256_setzero_si256(), hi2 = _mm256_setzero_si256();
+                __m256i lo3 = _mm256_setzero_si256(), hi3 = _mm256_setzero_si256();
+                for (int p = 0; p < N / 2; ++p) {
+                    const __m256i c = _mm256_set1_epi32(kTables.rowPairs[i][p]);
+                    lo0 = _mm256_add_epi32(lo0, _mm256_madd_epi16(lo[b + 0][p], c));
+                    hi0 = _mm256_add_epi32(hi0, _mm256_madd_epi16(hi[b + 0][p], c));
+                    lo1 = _mm256_add_epi32(lo1, _mm256_madd_epi16(lo[b + 1][p], c));
+                    hi1 = _mm256_add_epi32(hi1, _mm256_madd_epi16(hi[b + 1][p], c));
+                    lo2 = _mm256_add_epi32(lo2, _mm256_madd_epi16(lo[b + 2][p], c));
+                    hi2 = _mm256_add_epi32(hi2, _mm256_madd_epi16(hi[b + 2][p], c));
+                    lo3 = _mm256_add_epi32(lo3, _mm256_madd_epi16(lo[b + 3][p], c));
+                    hi3 = _mm256_add_epi32(hi3, _mm256_madd_epi16(hi[b + 3][p], c));
+                }
+                storeRowAvx2(&temp[(b + 0) / 2][i][16 * ((b + 0) % 2)], lo0, hi0, round);
+                storeRowAvx2(&temp[(b + 1) / 2][i][16 * ((b + 1) % 2)], lo1, hi1, round);
+                storeRowAvx2(&temp[(b + 2) / 2][i][16 * ((b + 2) % 2)], lo2, hi2, round);
+                storeRowAvx2(&temp[(b + 3) / 2][i][16 * ((b + 3) % 2)], lo3, hi3, round);
+            }
+        }
+
+        // Column pass over all 8 * BatchGroup rows of temp, four rows per
+        // basis^T load
+        constexpr int Rows = K * BatchGroup;
+        const qint16* rows = &temp[0][0][0];
+        for (int r = 0; r < Rows; r += 4) {
+            const qint16* r0 = rows + (r + 0) * N;
+            const qint16* r1 = rows + (r + 1) * N;
+            const qint16* r2 = rows + (r + 2) * N;
+            const qint16* r3 = rows + (r + 3) * N;
+            __m256i acc0 = _mm256_setzero_si256();
+            __m256i acc1 = _mm256_setzero_si256();
+            __m256i acc2 = _mm256_setzero_si256();
+            __m256i acc3 = _mm256_setzero_si256();
+            for (int p = 0; p < N / 2; ++p) {
+                const __m256i basisT = _mm256_load_si256(reinterpret_cast<const __m256i*>(kTables.colPairs[p]));
+                acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(broadcastPairAvx2(r0, p), basisT));
+                acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(broadcastPairAvx2(r1, p), basisT));
+                acc2 = _mm256_add_epi32(acc2, _mm256_madd_epi16(broadcastPairAvx2(r2, p), basisT));
+                acc3 = _mm256_add_epi32(acc3, _mm256_madd_epi16(broadcastPairAvx2(r3, p), basisT));
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + (r + 0) * K), acc0);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + (r + 1) * K), acc1);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + (r + 2) * K), acc2);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + (r + 3) * K), acc3);
+        }
+    }
+
+    PHOTOBOSS_TARGET_AVX2
+    static void lowFrequencyBatchAvx2(const uchar* const* planes, int stride, int count, qint32* out)
+    {
+        int n = 0;
+        for (; n + BatchGroup <= count; n += BatchGroup)
+            lowFrequencyGroupAvx2(planes + n, stride, out + n * K * K);
+        for (; n < count; ++n)
+            lowFrequencyAvx2(planes[n], stride, out + n * K * K);
+    }
+#endif
+
+    // ---------------------------------------------------------------
+    // NEON
+    // ---------------------------------------------------------------
+
+#if defined(PHOTOBOSS_NEON)
+    static void lowFrequencyNeon(const uchar* plane, int stride, qint32* out)
+    {
+        int16x8_t rows[N][4];
+        for (int k = 0; k < N; ++k) {
+            const uint8x16_t a = vld1q_u8(plane + k * stride);
+            const uint8x16_t b = vld1q_u8(plane + k * stride + 16);
+            rows[k][0] = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(a)));
+            rows[k][1] = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(a)));
+            rows[k][2] = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(b)));
+            rows[k][3] = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(b)));
+        }
+
+        // Row pass
+        qint16 temp[K][N];
+        const int32x4_t round = vdupq_n_s32(RowPassRound);
+        for (int i = 0; i < K; ++i) {
+            for (int c = 0; c < 4; ++c) {
+                int32x4_t acc0 = vdupq_n_s32(0);
+                int32x4_t acc1 = vdupq_n_s32(0);
+                for (int k = 0; k < N; ++k) {
+                    const qint16 coeff = kTables.basis[i][k];
+                    acc0 = vmlal_n_s16(acc0, vget_low_s16(rows[k][c]), coeff);
+                    acc1 = vmlal_n_s16(acc1, vget_high_s16(rows[k][c]), coeff);
+                }
+                acc0 = vshrq_n_s32(vaddq_s32(acc0, round), RowPassShift);
+                acc1 = vshrq_n_s32(vaddq_s32(acc1, round), RowPassShift);
+                vst1q_s16(&temp[i][8 * c], vcombine_s16(vmovn_s32(acc0), vmovn_s32(acc1)));
+            }
+        }
+
+        // Column pass
+        for (int i = 0; i < K; ++i) {
+            int32x4_t acc0 = vdupq_n_s32(0);
+            int32x4_t acc1 = vdupq_n_s32(0);
+            for (int k = 0; k < N; ++k) {
+                const int16x8_t basisT = vld1q_s16(kTables.transposed[k]);
+                acc0 = vmlal_n_s16(acc0, vget_low_s16(basisT), temp[i][k]);
+                acc1 = vmlal_n_s16(acc1, vget_high_s16(basisT), temp[i][k]);
+            }
+            vst1q_s32(out + i * K, acc0);
+            vst1q_s32(out + i * K + 4, acc1);
+        }
+    }
+#endif
+
+    // ---------------------------------------------------------------
+    // Dispatch
+    // ---------------------------------------------------------------
+
+    using KernelFn = void (*)(const uchar*, int, qint32*);
+    using BatchKernelFn = void (*)(const uchar* const*, int, int, qint32*);
+
+    static void lowFrequencyBatchScalar(const uchar* const* planes, int stride, int count, qint32* out)
+    {
+        for (int n = 0; n < count; ++n)
+            lowFrequencyScalar(planes[n], stride, out + n * K * K);
+    }
+
+#if defined(PHOTOBOSS_NEON)
+    static void lowFrequencyBatchNeon(const uchar* const* planes, int stride, int count, qint32* out)
+    {
+        for (int n = 0; n < count; ++n)
+            lowFrequencyNeon(planes[n], stride, out + n * K * K);
+    }
+#endif
+
+    static KernelFn selectKernel()
+    {
+#if defined(PHOTOBOSS_X86)
+        if (CpuFeatures::get().avx2)
+            return lowFrequencyAvx2;
+#elif defined(PHOTOBOSS_NEON)
+        if (CpuFeatures::get().neon)
+            return lowFrequencyNeon;
+#endif
+        return lowFrequencyScalar;
+    }
+
+    static BatchKernelFn selectBatchKernel()
+    {
+#if defined(PHOTOBOSS_X86)
+        if (CpuFeatures::get().avx2)
+            return lowFrequencyBatchAvx2;
+#elif defined(PHOTOBOSS_NEON)
+        if (CpuFeatures::get().neon)
+            return lowFrequencyBatchNeon;
+#endif
+        return lowFrequencyBatchScalar;
+    }
+
+    void lowFrequency8x8(const uchar* plane, int stride, qint32* out)
+    {
+        static const KernelFn kernel = selectKernel();
+        kernel(plane, stride, out);
+    }
+
+    void lowFrequency8x8Batch(const uchar* const* planes, int stride, int count, qint32* out)
+    {
+        static const BatchKernelFn kernel = selectBatchKernel();
+        kernel(planes, stride, count, out);
+    }
+
+    void dihedral8x8(const qint32* in, int pose, qint32* out)
+    {
+        const bool transpose = (pose & Transpose) != 0;
+        const int flipU = (pose & FlipVertical) ? 1 : 0;
+        const int flipV = (pose & FlipHorizontal) ? 1 : 0;
+
+        for (int u = 0; u < K; ++u)
+            for (int v = 0; v < K; ++v) {
+                const qint32 c = transpose ? in[v * K + u] : in[u * K + v];
+                out[u * K + v] = (((u * flipU) ^ (v * flipV)) & 1) ? -c : c;
+            }
+    }
+
+    int canonicalPose(const qint32* coeffs)
+    {
+        // sh: odd horizontal / even vertical frequencies, negated only by a
+        // left-right mirror. sv: the same with the axes swapped. Sums over
+        // the whole band rather than a single coefficient so that one
+        // near-zero term cannot flip the decision.
+        qint64 sh = 0;
+        qint64 sv = 0;
+        for (int u = 0; u < K; u += 2)
+            for (int v = 1; v < K; v += 2) {
+                sh += coeffs[u * K + v];
+                sv += coeffs[v * K + u];
+            }
+
+        // Transpose so the dominant band is horizontal, then mirror both
+        // sums positive
+        int pose = 0;
+        if ((sv < 0 ? -sv : sv) > (sh < 0 ? -sh : sh)) {
+            pose |= Transpose;
+            std::swap(sh, sv);
+        }
+        if (sh < 0) pose |= FlipHorizontal;
+        if (sv < 0) pose |= FlipVertical;
+        return pose;
+    }
+
+}
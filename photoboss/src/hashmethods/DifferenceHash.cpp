@@ -4,7 +4,7 @@
 #include <bit>
 
 namespace photoboss {
-    QString DifferenceHash::compute(const PerceptualImage& image)
+    void DifferenceHash::hash(const PerceptualImage& image, HashDigest& digest)
     {
         int startX = (settings::HashSampleSize - 9) / 2;
         int startY = (settings::HashSampleSize - 8) / 2;
@@ -22,24 +22,6 @@ namespace photoboss {
             }
         }
 
-        return QString("%1")
-            .arg(hash, 16, 16, QChar('0'))
-            .toUpper();
-    }
-
-    double DifferenceHash::compare(const QString& hash1, const QString& hash2) const
-    {
-        constexpr double maxDistance = 32.0;
-        uint64_t a = hash1.toULongLong(nullptr, 16);
-        uint64_t b = hash2.toULongLong(nullptr, 16);
-        uint64_t diff = a ^ b;
-        double distance = static_cast<double>(std::popcount(diff));
-        return std::clamp(1.0 - (distance / maxDistance), 0.0, 1.0);
-
-    }
-
-    HashInput DifferenceHash::inputType() const
-    {
-        return HashInput::Image;
+        digest.setValue(HashKind::Difference, hash);
     }
 }
\ No newline at end of file
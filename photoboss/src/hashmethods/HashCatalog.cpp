@@ -1,8 +1,10 @@
 #include "hashing/HashCatalog.h"
 #include "hashing/Sha256Hash.h"
+#include "hashing/Xxh3Hash.h"
 #include "hashing/PerceptualHash.h"
 #include "hashing/DifferenceHash.h"
 #include "hashing/AverageHash.h"
+#include "hashing/PyramidHash.h"
 
 namespace photoboss {
 
@@ -10,10 +12,14 @@ namespace photoboss {
     {
         std::vector<Entry> hashes;
 
-        hashes.push_back({ "SHA256", std::make_unique<Sha256Hash>() });
+        if constexpr (ActiveContentAlgorithm == ContentAlgorithm::Xxh3_128)
+            hashes.push_back({ hashKindKey(HashKind::Content), std::make_unique<Xxh3Hash>() });
+        else
+            hashes.push_back({ hashKindKey(HashKind::Content), std::make_unique<Sha256Hash>() });
         hashes.push_back({ "Perceptual Hash", std::make_unique<PerceptualHash>() });
         hashes.push_back({ "Difference Hash", std::make_unique<DifferenceHash>() });
         hashes.push_back({ "Average Hash", std::make_unique<AverageHash>() });
+        hashes.push_back({ "Pyramid Hash", std::make_unique<PyramidHash>() });
 
         return hashes;
     }
@@ -1,32 +1,54 @@
 #include "hashing/PerceptualImage.h"
 #include "util/AppSettings.h"
-#include <QPainter>
+#include "hashing/PlaneKernel.h"
+#include <cstring>
 
 namespace photoboss
 {
 	PerceptualImage::PerceptualImage(const QImage& src)
+        : m_paddedSquare_(settings::HashSampleSize, settings::HashSampleSize, QImage::Format_Grayscale8)
 	{
-        // Scale keeping aspect ratio
-        QImage scaled = src.scaled(settings::HashSampleSize, settings::HashSampleSize,
-            Qt::KeepAspectRatio,
-            Qt::SmoothTransformation)
-            .convertToFormat(QImage::Format_Grayscale8);
+        // The fused kernel reads 32-bit xRGB or 8-bit grey directly; anything
+        // else (indexed, 16-bit, premultiplied, ...) is normalised first.
+        QImage source = src;
+        const QImage::Format format = src.format();
+        if (format != QImage::Format_RGB32 && format != QImage::Format_ARGB32
+            && format != QImage::Format_Grayscale8) {
+            source = src.convertToFormat(QImage::Format_RGB32);
+        }
 
-        m_paddedSquare_ = QImage(settings::HashSampleSize, settings::HashSampleSize, QImage::Format_Grayscale8);
-        m_paddedSquare_.fill(Qt::black);
+        // Luma conversion, aspect-preserving area downscale and centred
+        // letterbox in a single pass, straight into the padded square
+        const int bytesPerPixel = source.format() == QImage::Format_Grayscale8 ? 1 : 4;
+        plane::buildLumaPlane(source.constBits(), source.width(), source.height(),
+            source.bytesPerLine(), bytesPerPixel, m_paddedSquare_.bits());
+        m_stats_ = quality::measure(source.constBits(), source.width(), source.height(),
+            source.bytesPerLine(), bytesPerPixel);
 
-        // Centre the scaled image
-        QPainter painter(&m_paddedSquare_);
-        QPoint offset((settings::HashSampleSize - scaled.width()) / 2,
-            (settings::HashSampleSize - scaled.height()) / 2);
-        painter.drawImage(offset, scaled);
-        painter.end();
-
-        // 4. sanity checks
+        // sanity checks
         Q_ASSERT(m_paddedSquare_.size() == QSize(settings::HashSampleSize, settings::HashSampleSize));
         Q_ASSERT(m_paddedSquare_.format() == QImage::Format_Grayscale8);
         Q_ASSERT(m_paddedSquare_.bytesPerLine() == settings::HashSampleSize);
 	}
+
+    PerceptualImage::PerceptualImage(FromPlane, const QByteArray& plane)
+        : m_paddedSquare_(settings::HashSampleSize, settings::HashSampleSize, QImage::Format_Grayscale8)
+    {
+        Q_ASSERT(plane.size() == PlaneSize);
+        std::memcpy(m_paddedSquare_.bits(), plane.constData(), PlaneSize);
+    }
+
+    PerceptualImage PerceptualImage::fromPlane(const QByteArray& plane)
+    {
+        return PerceptualImage(FromPlane{}, plane);
+    }
+
+    QByteArray PerceptualImage::plane() const
+    {
+        // bytesPerLine == HashSampleSize, so the square is contiguous
+        return QByteArray(reinterpret_cast<const char*>(bits()), PlaneSize);
+    }
+
     double PerceptualImage::pixel(int x, int y) const
     {
         if (x < 0) x = 0;
@@ -0,0 +1,200 @@
+#include "hashing/PlaneKernel.h"
+#include "util/AppSettings.h"
+#include "util/CpuFeatures.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <vector>
+
+#if defined(PHOTOBOSS_X86)
+#include <immintrin.h>
+#elif defined(PHOTOBOSS_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace photoboss::plane {
+
+    static constexpr int S = settings::HashSampleSize;
+
+    // Luma = (11 R + 16 G + 5 B) / 32, the weights of qGray(). Rows are
+    // accumulated as 32 * luma so the division happens once per output
+    // pixel, after the area sum.
+    static constexpr int WeightR = 11;
+    static constexpr int WeightG = 16;
+    static constexpr int WeightB = 5;
+    static constexpr int LumaShift = 5;
+
+    // Adds 32 * luma of each of width pixels in row to acc[0..width).
+    using AccumulateFn = void (*)(const uchar* row, int width, quint32* acc);
+
+    // ---------------------------------------------------------------
+    // Scalar
+    // ---------------------------------------------------------------
+
+    // QImage stores 32-bit pixels as 0xAARRGGBB words, i.e. B, G, R, A in
+    // memory on the little-endian targets we build for.
+    static void accumulateRgbScalar(const uchar* row, int width, quint32* acc)
+    {
+        for (int x = 0; x < width; ++x) {
+            const uchar* px = row + 4 * x;
+            acc[x] += WeightB * px[0] + WeightG * px[1] + WeightR * px[2];
+        }
+    }
+
+    static void accumulateGrayScalar(const uchar* row, int width, quint32* acc)
+    {
+        for (int x = 0; x < width; ++x)
+            acc[x] += quint32(row[x]) << LumaShift;
+    }
+
+    // ---------------------------------------------------------------
+    // AVX2
+    // ---------------------------------------------------------------
+
+#if defined(PHOTOBOSS_X86)
+    PHOTOBOSS_TARGET_AVX2
+    static void accumulateRgbAvx2(const uchar* row, int width, quint32* acc)
+    {
+        // maddubs pairs (B,G) and (R,A) into two int16 partial sums per
+        // pixel (max 255 * 21, no saturation), madd with ones folds them
+        // into one int32 per pixel.
+        const __m256i weights = _mm256_set1_epi32(WeightB | (WeightG << 8) | (WeightR << 16));
+        const __m256i ones = _mm256_set1_epi16(1);
+        int x = 0;
+        for (; x + 8 <= width; x += 8) {
+            const __m256i px = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + 4 * x));
+            const __m256i luma = _mm256_madd_epi16(_mm256_maddubs_epi16(px, weights), ones);
+            __m256i* dst = reinterpret_cast<__m256i*>(acc + x);
+            _mm256_storeu_si256(dst, _mm256_add_epi32(_mm256_loadu_si256(dst), luma));
+        }
+        accumulateRgbScalar(row + 4 * x, width - x, acc + x);
+    }
+
+    PHOTOBOSS_TARGET_AVX2
+    static void accumulateGrayAvx2(const uchar* row, int width, quint32* acc)
+    {
+        int x = 0;
+        for (; x + 8 <= width; x += 8) {
+            const __m128i px = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + x));
+            const __m256i luma = _mm256_slli_epi32(_mm256_cvtepu8_epi32(px), LumaShift);
+            __m256i* dst = reinterpret_cast<__m256i*>(acc + x);
+            _mm256_storeu_si256(dst, _mm256_add_epi32(_mm256_loadu_si256(dst), luma));
+        }
+        accumulateGrayScalar(row + x, width - x, acc + x);
+    }
+#endif
+
+    // ---------------------------------------------------------------
+    // NEON
+    // ---------------------------------------------------------------
+
+#if defined(PHOTOBOSS_NEON)
+    static void accumulateRgbNeon(const uchar* row, int width, quint32* acc)
+    {
+        int x = 0;
+        for (; x + 8 <= width; x += 8) {
+            const uint8x8x4_t px = vld4_u8(row + 4 * x);
+            uint16x8_t luma = vmull_u8(px.val[0], vdup_n_u8(WeightB));
+            luma = vmlal_u8(luma, px.val[1], vdup_n_u8(WeightG));
+            luma = vmlal_u8(luma, px.val[2], vdup_n_u8(WeightR));
+            vst1q_u32(acc + x, vaddw_u16(vld1q_u32(acc + x), vget_low_u16(luma)));
+            vst1q_u32(acc + x + 4, vaddw_u16(vld1q_u32(acc + x + 4), vget_high_u16(luma)));
+        }
+        accumulateRgbScalar(row + 4 * x, width - x, acc + x);
+    }
+
+    static void accumulateGrayNeon(const uchar* row, int width, quint32* acc)
+    {
+        int x = 0;
+        for (; x + 8 <= width; x += 8) {
+            const uint16x8_t luma = vshll_n_u8(vld1_u8(row + x), LumaShift);
+            vst1q_u32(acc + x, vaddw_u16(vld1q_u32(acc + x), vget_low_u16(luma)));
+            vst1q_u32(acc + x + 4, vaddw_u16(vld1q_u32(acc + x + 4), vget_high_u16(luma)));
+        }
+        accumulateGrayScalar(row + x, width - x, acc + x);
+    }
+#endif
+
+    // ---------------------------------------------------------------
+    // Dispatch
+    // ---------------------------------------------------------------
+
+    static AccumulateFn selectRgb()
+    {
+#if defined(PHOTOBOSS_X86)
+        if (CpuFeatures::get().avx2)
+            return accumulateRgbAvx2;
+#elif defined(PHOTOBOSS_NEON)
+        if (CpuFeatures::get().neon)
+            return accumulateRgbNeon;
+#endif
+        return accumulateRgbScalar;
+    }
+
+    static AccumulateFn selectGray()
+    {
+#if defined(PHOTOBOSS_X86)
+        if (CpuFeatures::get().avx2)
+            return accumulateGrayAvx2;
+#elif defined(PHOTOBOSS_NEON)
+        if (CpuFeatures::get().neon)
+            return accumulateGrayNeon;
+#endif
+        return accumulateGrayScalar;
+    }
+
+    void buildLumaPlane(const uchar* src, int width, int height, int stride,
+        int bytesPerPixel, uchar* out)
+    {
+        static const AccumulateFn accumulateRgb = selectRgb();
+        static const AccumulateFn accumulateGray = selectGray();
+
+        std::memset(out, 0, S * S);
+        if (!src || width <= 0 || height <= 0)
+            return;
+
+        // Fit inside S x S keeping aspect ratio, rounding as
+        // QSize::scaled(Qt::KeepAspectRatio) does.
+        int fitW = S;
+        int fitH = S;
+        const qint64 scaledW = qint64(S) * width / height;
+        if (scaledW <= S)
+            fitW = std::max<int>(1, int(scaledW));
+        else
+            fitH = std::max<int>(1, int(qint64(S) * height / width));
+        const int offsetX = (S - fitW) / 2;
+        const int offsetY = (S - fitH) / 2;
+
+        // Each output pixel averages the source pixels whose integer footprint
+        // it covers; footprints are at least one pixel wide when upscaling.
+        std::array<int, S + 1> colEdge;
+        for (int dx = 0; dx <= fitW; ++dx)
+            colEdge[dx] = int(qint64(dx) * width / fitW);
+
+        const AccumulateFn accumulate = bytesPerPixel == 1 ? accumulateGray : accumulateRgb;
+        std::vector<quint32> acc(width);
+
+        for (int dy = 0; dy < fitH; ++dy) {
+            const int y0 = int(qint64(dy) * height / fitH);
+            const int y1 = std::max(int(qint64(dy + 1) * height / fitH), y0 + 1);
+
+            // Vertical: colour-convert and sum the rows of this band
+            std::fill(acc.begin(), acc.end(), 0u);
+            for (int y = y0; y < y1; ++y)
+                accumulate(src + qint64(y) * stride, width, acc.data());
+
+            // Horizontal: sum each column footprint and divide by its area
+            uchar* dst = out + (offsetY + dy) * S + offsetX;
+            for (int dx = 0; dx < fitW; ++dx) {
+                const int x0 = colEdge[dx];
+                const int x1 = std::max(colEdge[dx + 1], x0 + 1);
+                quint64 sum = 0;
+                for (int x = x0; x < x1; ++x)
+                    sum += acc[x];
+                const quint64 area = quint64(x1 - x0) * quint64(y1 - y0) << LumaShift;
+                dst[dx] = uchar((sum + area / 2) / area);
+            }
+        }
+    }
+
+}
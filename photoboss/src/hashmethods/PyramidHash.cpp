@@ -0,0 +1,141 @@
+#include "hashing/PyramidHash.h"
+#include "util/AppSettings.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace photoboss {
+
+    static_assert(settings::HashSampleSize % 32 == 0,
+        "every pyramid window must split into whole 8x8 blocks");
+
+    // Side of the grid planeCorrelation() compares on
+    static constexpr int VerifySize = 16;
+
+    // Area-average of window w of a plane onto a VerifySize grid; the
+    // three-quarter windows need fractional pixel weights
+    static void resampleWindow(const uchar* plane, PyramidHash::Window w, float* out)
+    {
+        constexpr int S = settings::HashSampleSize;
+        const float scale = static_cast<float>(w.size) / VerifySize;
+        for (int oy = 0; oy < VerifySize; ++oy) {
+            const float y0 = oy * scale, y1 = y0 + scale;
+            for (int ox = 0; ox < VerifySize; ++ox) {
+                const float x0 = ox * scale, x1 = x0 + scale;
+                float sum = 0.0f;
+                for (int y = static_cast<int>(y0); y < static_cast<int>(std::ceil(y1)); ++y) {
+                    const float wy = std::min(y + 1.0f, y1) - std::max(static_cast<float>(y), y0);
+                    for (int x = static_cast<int>(x0); x < static_cast<int>(std::ceil(x1)); ++x) {
+                        const float wx = std::min(x + 1.0f, x1) - std::max(static_cast<float>(x), x0);
+                        sum += wx * wy * plane[(w.y + y) * S + w.x + x];
+                    }
+                }
+                out[oy * VerifySize + ox] = sum / (scale * scale);
+            }
+        }
+    }
+
+    void PyramidHash::hash(const PerceptualImage& image, HashDigest& digest)
+    {
+        constexpr int S = settings::HashSampleSize;
+
+        // Summed-area table, so each block sum is four lookups
+        std::array<quint32, (S + 1) * (S + 1)> sums{};
+        const uchar* bits = image.bits();
+        const int stride = image.bytesPerLine();
+        for (int y = 0; y < S; ++y) {
+            quint32 row = 0;
+            for (int x = 0; x < S; ++x) {
+                row += bits[y * stride + x];
+                sums[(y + 1) * (S + 1) + x + 1] = sums[y * (S + 1) + x + 1] + row;
+            }
+        }
+        const auto area = [&](int x0, int y0, int x1, int y1) {
+            return sums[y1 * (S + 1) + x1] - sums[y0 * (S + 1) + x1]
+                - sums[y1 * (S + 1) + x0] + sums[y0 * (S + 1) + x0];
+        };
+
+        PyramidDigest pyramid{};
+        std::array<quint32, 64> blocks;
+        std::array<quint32, 64> sorted;
+        for (int i = 0; i < PyramidHashCount; ++i) {
+            const Window w = window(i);
+            const int cell = w.size / 8;
+            for (int by = 0; by < 8; ++by) {
+                for (int bx = 0; bx < 8; ++bx) {
+                    const int x = w.x + bx * cell;
+                    const int y = w.y + by * cell;
+                    blocks[by * 8 + bx] = area(x, y, x + cell, y + cell);
+                }
+            }
+
+            // Blocks of one window have equal areas, so sums compare like means
+            sorted = blocks;
+            std::nth_element(sorted.begin(), sorted.begin() + 31, sorted.end());
+            const quint32 median = sorted[31];
+
+            quint64 h = 0;
+            for (int b = 0; b < 64; ++b) {
+                if (blocks[b] > median)
+                    h |= 1ULL << b;
+            }
+            pyramid[i] = h;
+        }
+
+        digest.setPyramid(pyramid);
+    }
+
+    PyramidHash::CropMatch PyramidHash::cropMatch(const HashDigest& a, const HashDigest& b)
+    {
+        CropMatch best;
+        const auto consider = [&](quint64 global, const PyramidDigest& other, bool aInsideB) {
+            if (!informative(global))
+                return;
+            for (int i = 1; i < PyramidHashCount; ++i) {
+                if (!informative(other[i]))
+                    continue;
+                const double sim = 1.0 - std::popcount(global ^ other[i]) / 64.0;
+                if (sim > best.similarity)
+                    best = { sim, i, aInsideB };
+            }
+        };
+
+        if (!a.has(Kind) || !b.has(Kind))
+            return best;
+        consider(a.pyramid[0], b.pyramid, true);
+        consider(b.pyramid[0], a.pyramid, false);
+        return best;
+    }
+
+    double PyramidHash::planeCorrelation(const QByteArray& inner, const QByteArray& outer, int window)
+    {
+        if (inner.size() != PerceptualImage::PlaneSize || outer.size() != PerceptualImage::PlaneSize)
+            return -1.0;
+
+        std::array<float, VerifySize * VerifySize> a;
+        std::array<float, VerifySize * VerifySize> b;
+        resampleWindow(reinterpret_cast<const uchar*>(inner.constData()), PyramidHash::window(0), a.data());
+        resampleWindow(reinterpret_cast<const uchar*>(outer.constData()), PyramidHash::window(window), b.data());
+
+        double meanA = 0.0, meanB = 0.0;
+        for (size_t i = 0; i < a.size(); ++i) {
+            meanA += a[i];
+            meanB += b[i];
+        }
+        meanA /= a.size();
+        meanB /= b.size();
+
+        double ab = 0.0, aa = 0.0, bb = 0.0;
+        for (size_t i = 0; i < a.size(); ++i) {
+            const double da = a[i] - meanA;
+            const double db = b[i] - meanB;
+            ab += da * db;
+            aa += da * da;
+            bb += db * db;
+        }
+        if (aa <= 0.0 || bb <= 0.0)
+            return 0.0;
+        return ab / std::sqrt(aa * bb);
+    }
+
+}
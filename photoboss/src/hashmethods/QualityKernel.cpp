@@ -0,0 +1,317 @@
+#include "hashing/QualityKernel.h"
+#include "util/CpuFeatures.h"
+#include <array>
+#include <bit>
+#include <vector>
+
+#if defined(PHOTOBOSS_X86)
+#include <immintrin.h>
+#elif defined(PHOTOBOSS_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace photoboss::quality {
+
+    // Luma = (11 R + 16 G + 5 B) / 32, truncated as qGray() does
+    static constexpr int WeightR = 11;
+    static constexpr int WeightG = 16;
+    static constexpr int WeightB = 5;
+    static constexpr int LumaShift = 5;
+
+    // Luma at or below / at or above these counts as clipped
+    static constexpr int ClipDark = 3;
+    static constexpr int ClipBright = 252;
+
+    // Laplacian sums of one interior row plus the clipped pixels of that row
+    struct RowSums {
+        qint64 sum = 0;
+        quint64 sumSquares = 0;
+        int clipped = 0;
+    };
+
+    // Converts width xRGB pixels of row to luma in out
+    using LumaRowFn = void (*)(const uchar* row, int width, uchar* out);
+
+    // Laplacian of mid at x = 1 .. width-2 and clipping over all of mid
+    using RowStatsFn = RowSums (*)(const uchar* up, const uchar* mid, const uchar* down, int width);
+
+    // ---------------------------------------------------------------
+    // Scalar
+    // ---------------------------------------------------------------
+
+    static void lumaRowScalar(const uchar* row, int width, uchar* out)
+    {
+        for (int x = 0; x < width; ++x) {
+            const uchar* px = row + 4 * x;
+            out[x] = uchar((WeightB * px[0] + WeightG * px[1] + WeightR * px[2]) >> LumaShift);
+        }
+    }
+
+    // Laplacian sums from column x0 to the end of the row
+    static void rowStatsTail(const uchar* up, const uchar* mid, const uchar* down,
+        int width, int x0, RowSums& sums)
+    {
+        for (int x = x0; x < width - 1; ++x) {
+            const int lap = 4 * mid[x] - mid[x - 1] - mid[x + 1] - up[x] - down[x];
+            sums.sum += lap;
+            sums.sumSquares += quint64(lap * lap);
+        }
+    }
+
+    // Clipped pixels from column x0 to the end of the row
+    static int clippedTail(const uchar* row, int x0, int width)
+    {
+        int clipped = 0;
+        for (int x = x0; x < width; ++x)
+            clipped += (row[x] <= ClipDark) | (row[x] >= ClipBright);
+        return clipped;
+    }
+
+    static RowSums rowStatsScalar(const uchar* up, const uchar* mid, const uchar* down, int width)
+    {
+        RowSums sums;
+        rowStatsTail(up, mid, down, width, 1, sums);
+        sums.clipped = clippedTail(mid, 0, width);
+        return sums;
+    }
+
+    // ---------------------------------------------------------------
+    // AVX2
+    // ---------------------------------------------------------------
+
+#if defined(PHOTOBOSS_X86)
+    PHOTOBOSS_TARGET_AVX2
+    static void lumaRowAvx2(const uchar* row, int width, uchar* out)
+    {
+        // Same maddubs / madd fold as the plane kernel, then >> 5 and a
+        // pack of 8 int32 down to 8 bytes
+        const __m256i weights = _mm256_set1_epi32(WeightB | (WeightG << 8) | (WeightR << 16));
+        const __m256i ones = _mm256_set1_epi16(1);
+        const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+        int x = 0;
+        for (; x + 8 <= width; x += 8) {
+            const __m256i px = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + 4 * x));
+            const __m256i luma = _mm256_srli_epi32(
+                _mm256_madd_epi16(_mm256_maddubs_epi16(px, weights), ones), LumaShift);
+            // int32 -> int16 -> uint8 within each 128-bit lane, then gather the
+            // two lanes' low bytes into the first 8
+            const __m256i words = _mm256_packus_epi32(luma, luma);
+            const __m256i bytes = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(words, words), order);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out + x), _mm256_castsi256_si128(bytes));
+        }
+        lumaRowScalar(row + 4 * x, width - x, out + x);
+    }
+
+    PHOTOBOSS_TARGET_AVX2
+    static int clippedAvx2(const uchar* row, int width)
+    {
+        const __m256i dark = _mm256_set1_epi8(char(ClipDark));
+        const __m256i bright = _mm256_set1_epi8(char(ClipBright));
+        int clipped = 0;
+        int x = 0;
+        for (; x + 32 <= width; x += 32) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x));
+            // v <= dark  <=>  min(v, dark) == v;  v >= bright  <=>  max(v, bright) == v
+            const __m256i isDark = _mm256_cmpeq_epi8(_mm256_min_epu8(v, dark), v);
+            const __m256i isBright = _mm256_cmpeq_epi8(_mm256_max_epu8(v, bright), v);
+            clipped += std::popcount(quint32(_mm256_movemask_epi8(_mm256_or_si256(isDark, isBright))));
+        }
+        return clipped + clippedTail(row, x, width);
+    }
+
+    // Adds the int32 lanes to sums and clears them
+    PHOTOBOSS_TARGET_AVX2
+    static void flushRowSums(__m256i& sum, __m256i& squares, RowSums& sums)
+    {
+        alignas(32) std::array<qint32, 8> s32;
+        alignas(32) std::array<quint32, 8> sq32;
+        _mm256_store_si256(reinterpret_cast<__m256i*>(s32.data()), sum);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(sq32.data()), squares);
+        for (int i = 0; i < 8; ++i) {
+            sums.sum += s32[i];
+            sums.sumSquares += sq32[i];
+        }
+        sum = _mm256_setzero_si256();
+        squares = _mm256_setzero_si256();
+    }
+
+    PHOTOBOSS_TARGET_AVX2
+    static RowSums rowStatsAvx2(const uchar* up, const uchar* mid, const uchar* down, int width)
+    {
+        // 16 pixels per step in int16: |lap| <= 1020, and madd folds both
+        // the sum and the sum of squares into 32-bit pairs. A squares lane
+        // gains at most 2 * 1020^2 per step, so it holds 1000 steps (16000
+        // pixels, read back unsigned) before it must be flushed.
+        constexpr int FlushSteps = 1000;
+        const __m256i ones = _mm256_set1_epi16(1);
+        RowSums sums;
+
+        __m256i sum = _mm256_setzero_si256();
+        __m256i squares = _mm256_setzero_si256();
+
+        int x = 1;
+        int steps = 0;
+        for (; x + 16 <= width - 1; x += 16) {
+            const __m256i c = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(mid + x)));
+            const __m256i l = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(mid + x - 1)));
+            const __m256i r = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(mid + x + 1)));
+            const __m256i u = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(up + x)));
+            const __m256i d = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(down + x)));
+            const __m256i neighbours = _mm256_add_epi16(_mm256_add_epi16(l, r), _mm256_add_epi16(u, d));
+            const __m256i lap = _mm256_sub_epi16(_mm256_slli_epi16(c, 2), neighbours);
+
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(lap, ones));
+            squares = _mm256_add_epi32(squares, _mm256_madd_epi16(lap, lap));
+            if (++steps == FlushSteps) {
+                flushRowSums(sum, squares, sums);
+                steps = 0;
+            }
+        }
+        flushRowSums(sum, squares, sums);
+
+        rowStatsTail(up, mid, down, width, x, sums);
+        sums.clipped = clippedAvx2(mid, width);
+        return sums;
+    }
+#endif
+
+    // ---------------------------------------------------------------
+    // NEON
+    // ---------------------------------------------------------------
+
+#if defined(PHOTOBOSS_NEON)
+    static void lumaRowNeon(const uchar* row, int width, uchar* out)
+    {
+        int x = 0;
+        for (; x + 8 <= width; x += 8) {
+            const uint8x8x4_t px = vld4_u8(row + 4 * x);
+            uint16x8_t luma = vmull_u8(px.val[0], vdup_n_u8(WeightB));
+            luma = vmlal_u8(luma, px.val[1], vdup_n_u8(WeightG));
+            luma = vmlal_u8(luma, px.val[2], vdup_n_u8(WeightR));
+            vst1_u8(out + x, vshrn_n_u16(luma, LumaShift));
+        }
+        lumaRowScalar(row + 4 * x, width - x, out + x);
+    }
+
+    static RowSums rowStatsNeon(const uchar* up, const uchar* mid, const uchar* down, int width)
+    {
+        // 8 pixels per step; a squares lane gains at most 2 * 1020^2 per
+        // step and is flushed after 1000 steps like the AVX2 path
+        constexpr int FlushSteps = 1000;
+        RowSums sums;
+        int32x4_t sum = vdupq_n_s32(0);
+        uint32x4_t squares = vdupq_n_u32(0);
+
+        int x = 1;
+        int steps = 0;
+        for (; x + 8 <= width - 1; x += 8) {
+            const int16x8_t c = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(mid + x)));
+            const uint16x8_t neighbours = vaddq_u16(
+                vaddl_u8(vld1_u8(mid + x - 1), vld1_u8(mid + x + 1)),
+                vaddl_u8(vld1_u8(up + x), vld1_u8(down + x)));
+            const int16x8_t lap = vsubq_s16(vshlq_n_s16(c, 2), vreinterpretq_s16_u16(neighbours));
+
+            sum = vpadalq_s16(sum, lap);
+            const int32x4_t lo = vmull_s16(vget_low_s16(lap), vget_low_s16(lap));
+            const int32x4_t hi = vmull_s16(vget_high_s16(lap), vget_high_s16(lap));
+            squares = vaddq_u32(squares, vreinterpretq_u32_s32(vaddq_s32(lo, hi)));
+            if (++steps == FlushSteps) {
+                sums.sum += vaddvq_s32(sum);
+                sums.sumSquares += vaddvq_u32(squares);
+                sum = vdupq_n_s32(0);
+                squares = vdupq_n_u32(0);
+                steps = 0;
+            }
+        }
+        sums.sum += vaddvq_s32(sum);
+        sums.sumSquares += vaddvq_u32(squares);
+        rowStatsTail(up, mid, down, width, x, sums);
+
+        const uint8x16_t dark = vdupq_n_u8(ClipDark);
+        const uint8x16_t bright = vdupq_n_u8(ClipBright);
+        int clipped = 0;
+        int c = 0;
+        for (; c + 16 <= width; c += 16) {
+            const uint8x16_t v = vld1q_u8(mid + c);
+            const uint8x16_t hit = vorrq_u8(vcleq_u8(v, dark), vcgeq_u8(v, bright));
+            clipped += vaddvq_u8(vshrq_n_u8(hit, 7));
+        }
+        sums.clipped = clipped + clippedTail(mid, c, width);
+        return sums;
+    }
+#endif
+
+    // ---------------------------------------------------------------
+    // Dispatch
+    // ---------------------------------------------------------------
+
+    static LumaRowFn selectLumaRow()
+    {
+#if defined(PHOTOBOSS_X86)
+        if (CpuFeatures::get().avx2)
+            return lumaRowAvx2;
+#elif defined(PHOTOBOSS_NEON)
+        if (CpuFeatures::get().neon)
+            return lumaRowNeon;
+#endif
+        return lumaRowScalar;
+    }
+
+    static RowStatsFn selectRowStats()
+    {
+#if defined(PHOTOBOSS_X86)
+        if (CpuFeatures::get().avx2)
+            return rowStatsAvx2;
+#elif defined(PHOTOBOSS_NEON)
+        if (CpuFeatures::get().neon)
+            return rowStatsNeon;
+#endif
+        return rowStatsScalar;
+    }
+
+    LumaStats measure(const uchar* src, int width, int height, int stride, int bytesPerPixel)
+    {
+        static const LumaRowFn lumaRow = selectLumaRow();
+        static const RowStatsFn rowStats = selectRowStats();
+
+        LumaStats stats;
+        if (!src || width < 3 || height < 3)
+            return stats;
+
+        // Grey rows are read in place; xRGB rows are converted into a ring
+        // of three so each source row is converted once
+        std::vector<uchar> ring;
+        const auto row = [&](int y) -> const uchar* {
+            const uchar* line = src + qint64(y) * stride;
+            if (bytesPerPixel == 1)
+                return line;
+            uchar* out = ring.data() + (y % 3) * width;
+            lumaRow(line, width, out);
+            return out;
+        };
+        if (bytesPerPixel != 1)
+            ring.resize(3 * size_t(width));
+
+        qint64 sum = 0;
+        quint64 sumSquares = 0;
+        qint64 clipped = 0;
+        const uchar* up = row(0);
+        const uchar* mid = row(1);
+        for (int y = 1; y < height - 1; ++y) {
+            const uchar* down = row(y + 1);
+            const RowSums sums = rowStats(up, mid, down, width);
+            sum += sums.sum;
+            sumSquares += sums.sumSquares;
+            clipped += sums.clipped;
+            up = mid;
+            mid = down;
+        }
+
+        const double n = double(width - 2) * double(height - 2);
+        const double mean = double(sum) / n;
+        stats.sharpness = double(sumSquares) / n - mean * mean;
+        stats.clipped = double(clipped) / (double(width) * double(height - 2));
+        return stats;
+    }
+
+}
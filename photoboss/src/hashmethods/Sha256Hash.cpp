@@ -1,16 +1,29 @@
 #include "hashing/Sha256Hash.h"
-#include <QCryptographicHash>
+#include "hashing/Sha256Kernel.h"
 
 namespace photoboss
 {
-    double Sha256Hash::compare(const QString& hash1, const QString& hash2) const
+    void Sha256Hash::hash(const QByteArray& data, HashDigest& digest)
     {
-        return (hash1 == hash2) ? 1.0 : 0.0;
+        digest.setContent(sha256::digest(reinterpret_cast<const uchar*>(data.constData()),
+            static_cast<size_t>(data.size())));
     }
 
-    QString Sha256Hash::computeSHA256(const QByteArray& data)
+    void Sha256Hash::hashBatch(const std::vector<const QByteArray*>& data,
+        const std::vector<HashDigest*>& digests)
     {
-        QByteArray hash = QCryptographicHash::hash(data, QCryptographicHash::Sha256);
-        return hash.toHex();  // Converts the raw bytes to a hex string
+        std::vector<const uchar*> buffers;
+        std::vector<size_t> sizes;
+        buffers.reserve(data.size());
+        sizes.reserve(data.size());
+        for (const QByteArray* bytes : data) {
+            buffers.push_back(reinterpret_cast<const uchar*>(bytes->constData()));
+            sizes.push_back(static_cast<size_t>(bytes->size()));
+        }
+
+        std::vector<ContentDigest> out(data.size());
+        sha256::digestBatch(buffers.data(), sizes.data(), static_cast<int>(data.size()), out.data());
+        for (size_t i = 0; i < data.size(); ++i)
+            digests[i]->setContent(out[i]);
     }
-}
\ No newline at end of file
+}
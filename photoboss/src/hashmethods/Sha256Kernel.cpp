@@ -0,0 +1,378 @@
+#include "hashing/Sha256Kernel.h"
+#include "util/CpuFeatures.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#if defined(PHOTOBOSS_X86)
+#include <immintrin.h>
+#endif
+
+namespace photoboss::sha256 {
+
+    static constexpr size_t BlockSize = 64;
+    static constexpr int MaxLanes = 8;
+
+    alignas(32) static constexpr quint32 K[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+    };
+
+    static constexpr quint32 InitialState[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+
+    static inline quint32 loadBigEndian32(const uchar* p)
+    {
+        return (static_cast<quint32>(p[0]) << 24) | (static_cast<quint32>(p[1]) << 16) |
+               (static_cast<quint32>(p[2]) << 8) | static_cast<quint32>(p[3]);
+    }
+
+    static inline quint32 rotr(quint32 x, int n)
+    {
+        return (x >> n) | (x << (32 - n));
+    }
+
+    // ---------------------------------------------------------------
+    // Scalar reference
+    // ---------------------------------------------------------------
+
+    static void compressScalar(quint32* state, const uchar* data, size_t blocks)
+    {
+        for (; blocks > 0; --blocks, data += BlockSize) {
+            quint32 w[64];
+            for (int t = 0; t < 16; ++t)
+                w[t] = loadBigEndian32(data + 4 * t);
+            for (int t = 16; t < 64; ++t) {
+                const quint32 s0 = rotr(w[t - 15], 7) ^ rotr(w[t - 15], 18) ^ (w[t - 15] >> 3);
+                const quint32 s1 = rotr(w[t - 2], 17) ^ rotr(w[t - 2], 19) ^ (w[t - 2] >> 10);
+                w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+            }
+
+            quint32 a = state[0], b = state[1], c = state[2], d = state[3];
+            quint32 e = state[4], f = state[5], g = state[6], h = state[7];
+            for (int t = 0; t < 64; ++t) {
+                const quint32 t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) +
+                    ((e & f) ^ (~e & g)) + K[t] + w[t];
+                const quint32 t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) +
+                    ((a & b) ^ (a & c) ^ (b & c));
+                h = g; g = f; f = e; e = d + t1;
+                d = c; c = b; b = a; a = t1 + t2;
+            }
+            state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+            state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+        }
+    }
+
+    // ---------------------------------------------------------------
+    // SHA-NI
+    // ---------------------------------------------------------------
+
+#if defined(PHOTOBOSS_X86)
+
+    // Four rounds. The schedule lives in msg[0..3] as a ring: group g
+    // consumes msg[g % 4], completes msg[(g + 1) % 4] with sha256msg2 and
+    // starts msg[(g + 3) % 4] with sha256msg1. The group index is a template
+    // argument so every ring index is a constant and msg stays in registers.
+    template <int G>
+    PHOTOBOSS_TARGET_SHA static inline void roundsShaNi(__m128i& state0, __m128i& state1, __m128i* msg)
+    {
+        __m128i m = _mm_add_epi32(msg[G % 4], _mm_load_si128(reinterpret_cast<const __m128i*>(K + 4 * G)));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, m);
+        if constexpr (G >= 3 && G < 15) {
+            const __m128i tmp = _mm_alignr_epi8(msg[G % 4], msg[(G + 3) % 4], 4);
+            msg[(G + 1) % 4] = _mm_add_epi32(msg[(G + 1) % 4], tmp);
+            msg[(G + 1) % 4] = _mm_sha256msg2_epu32(msg[(G + 1) % 4], msg[G % 4]);
+        }
+        m = _mm_shuffle_epi32(m, 0x0E);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, m);
+        if constexpr (G >= 1 && G < 13)
+            msg[(G + 3) % 4] = _mm_sha256msg1_epu32(msg[(G + 3) % 4], msg[G % 4]);
+    }
+
+    template <int... G>
+    PHOTOBOSS_TARGET_SHA static inline void blockShaNi(__m128i& state0, __m128i& state1, __m128i* msg,
+        std::integer_sequence<int, G...>)
+    {
+        (roundsShaNi<G>(state0, state1, msg), ...);
+    }
+
+    PHOTOBOSS_TARGET_SHA static void compressShaNi(quint32* state, const uchar* data, size_t blocks)
+    {
+        const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+        // The instructions want the state as ABEF / CDGH
+        __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0xB1);
+        __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4)), 0x1B);
+        __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+        state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+        for (; blocks > 0; --blocks, data += BlockSize) {
+            const __m128i save0 = state0;
+            const __m128i save1 = state1;
+
+            __m128i msg[4];
+            for (int i = 0; i < 4; ++i)
+                msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * i)), byteSwap);
+
+            blockShaNi(state0, state1, msg, std::make_integer_sequence<int, 16>{});
+
+            state0 = _mm_add_epi32(state0, save0);
+            state1 = _mm_add_epi32(state1, save1);
+        }
+
+        tmp = _mm_shuffle_epi32(state0, 0x1B);
+        state1 = _mm_shuffle_epi32(state1, 0xB1);
+        state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+        state1 = _mm_alignr_epi8(state1, tmp, 8);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(state), state0);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), state1);
+    }
+
+    // ---------------------------------------------------------------
+    // AVX2 multi-buffer: 8 independent messages, one per 32-bit lane
+    // ---------------------------------------------------------------
+
+    PHOTOBOSS_TARGET_AVX2 static inline __m256i rotr8x(__m256i x, int n)
+    {
+        return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+    }
+
+    // Words 8 * half .. 8 * half + 7 of the current block of every lane,
+    // transposed so that w[i] holds word i of all 8 messages
+    PHOTOBOSS_TARGET_AVX2 static inline void loadTransposed(const uchar* const* lanes, size_t offset, __m256i* w)
+    {
+        const __m256i byteSwap = _mm256_setr_epi8(
+            3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+            3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+        __m256i r[8];
+        for (int i = 0; i < 8; ++i)
+            r[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes[i] + offset));
+
+        const __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+        const __m256i t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+        const __m256i t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+        const __m256i t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+        const __m256i t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+        const __m256i t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+        const __m256i t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+        const __m256i t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+
+        const __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+        const __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+        const __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+        const __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+        const __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+        const __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+        const __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+        const __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+        w[0] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(u0, u4, 0x20), byteSwap);
+        w[1] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(u1, u5, 0x20), byteSwap);
+        w[2] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(u2, u6, 0x20), byteSwap);
+        w[3] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(u3, u7, 0x20), byteSwap);
+        w[4] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(u0, u4, 0x31), byteSwap);
+        w[5] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(u1, u5, 0x31), byteSwap);
+        w[6] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(u2, u6, 0x31), byteSwap);
+        w[7] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(u3, u7, 0x31), byteSwap);
+    }
+
+    // state[i] holds state word i of all 8 lanes; each lane pointer advances
+    // by blocks * 64 bytes
+    PHOTOBOSS_TARGET_AVX2 static void compressAvx2x8(__m256i* state, const uchar** lanes, size_t blocks)
+    {
+        for (; blocks > 0; --blocks) {
+            __m256i w[16];
+            loadTransposed(lanes, 0, w);
+            loadTransposed(lanes, 32, w + 8);
+            for (int i = 0; i < MaxLanes; ++i)
+                lanes[i] += BlockSize;
+
+            __m256i a = state[0], b = state[1], c = state[2], d = state[3];
+            __m256i e = state[4], f = state[5], g = state[6], h = state[7];
+            for (int t = 0; t < 64; ++t) {
+                __m256i wt = w[t & 15];
+                if (t >= 16) {
+                    const __m256i w15 = w[(t - 15) & 15];
+                    const __m256i w2 = w[(t - 2) & 15];
+                    const __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(rotr8x(w15, 7), rotr8x(w15, 18)),
+                        _mm256_srli_epi32(w15, 3));
+                    const __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(rotr8x(w2, 17), rotr8x(w2, 19)),
+                        _mm256_srli_epi32(w2, 10));
+                    wt = _mm256_add_epi32(_mm256_add_epi32(wt, s0), _mm256_add_epi32(w[(t - 7) & 15], s1));
+                    w[t & 15] = wt;
+                }
+
+                const __m256i sigma1 = _mm256_xor_si256(_mm256_xor_si256(rotr8x(e, 6), rotr8x(e, 11)), rotr8x(e, 25));
+                const __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+                const __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, sigma1),
+                    _mm256_add_epi32(_mm256_add_epi32(ch, _mm256_set1_epi32(static_cast<int>(K[t]))), wt));
+                const __m256i sigma0 = _mm256_xor_si256(_mm256_xor_si256(rotr8x(a, 2), rotr8x(a, 13)), rotr8x(a, 22));
+                const __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+                const __m256i t2 = _mm256_add_epi32(sigma0, maj);
+
+                h = g; g = f; f = e; e = _mm256_add_epi32(d, t1);
+                d = c; c = b; b = a; a = _mm256_add_epi32(t1, t2);
+            }
+
+            state[0] = _mm256_add_epi32(state[0], a); state[1] = _mm256_add_epi32(state[1], b);
+            state[2] = _mm256_add_epi32(state[2], c); state[3] = _mm256_add_epi32(state[3], d);
+            state[4] = _mm256_add_epi32(state[4], e); state[5] = _mm256_add_epi32(state[5], f);
+            state[6] = _mm256_add_epi32(state[6], g); state[7] = _mm256_add_epi32(state[7], h);
+        }
+    }
+
+#endif
+
+    // ---------------------------------------------------------------
+    // Padding and dispatch
+    // ---------------------------------------------------------------
+
+    using CompressFn = void (*)(quint32*, const uchar*, size_t);
+
+    static CompressFn selectCompress()
+    {
+#if defined(PHOTOBOSS_X86)
+        if (CpuFeatures::get().sha)
+            return compressShaNi;
+#endif
+        return compressScalar;
+    }
+
+    static CompressFn compress()
+    {
+        static const CompressFn fn = selectCompress();
+        return fn;
+    }
+
+    // Pads the tail (size % 64 bytes at the end of data), runs the last one
+    // or two blocks and writes the big-endian digest
+    static void finish(quint32* state, const uchar* data, size_t size, ContentDigest& out)
+    {
+        const size_t tail = size % BlockSize;
+        uchar last[2 * BlockSize] = {};
+        std::memcpy(last, data + size - tail, tail);
+        last[tail] = 0x80;
+
+        const size_t lastSize = tail < BlockSize - 8 ? BlockSize : 2 * BlockSize;
+        const quint64 bits = static_cast<quint64>(size) * 8;
+        for (int i = 0; i < 8; ++i)
+            last[lastSize - 1 - i] = static_cast<uchar>(bits >> (8 * i));
+        compress()(state, last, lastSize / BlockSize);
+
+        for (int i = 0; i < 8; ++i) {
+            out[4 * i] = static_cast<quint8>(state[i] >> 24);
+            out[4 * i + 1] = static_cast<quint8>(state[i] >> 16);
+            out[4 * i + 2] = static_cast<quint8>(state[i] >> 8);
+            out[4 * i + 3] = static_cast<quint8>(state[i]);
+        }
+    }
+
+    ContentDigest digest(const uchar* data, size_t size)
+    {
+        quint32 state[8];
+        std::memcpy(state, InitialState, sizeof(state));
+        compress()(state, data, size / BlockSize);
+
+        ContentDigest out{};
+        finish(state, data, size, out);
+        return out;
+    }
+
+#if defined(PHOTOBOSS_X86)
+    // Up to 8 buffers through compressAvx2x8. Runs as many blocks as the
+    // shortest active buffer has left, retires the buffers that ran out and
+    // repeats while two or more remain; lanes without a buffer read a zero
+    // block whose result is discarded.
+    PHOTOBOSS_TARGET_AVX2 static void digestGroupAvx2(const uchar* const* data, const size_t* sizes, int count,
+        ContentDigest* out)
+    {
+        alignas(64) static const uchar idleBlock[BlockSize] = {};
+
+        quint32 states[MaxLanes][8];
+        size_t done[MaxLanes] = {};   // full blocks compressed per buffer
+        for (int i = 0; i < count; ++i)
+            std::memcpy(states[i], InitialState, sizeof(InitialState));
+
+        while (true) {
+            int active[MaxLanes];
+            int activeCount = 0;
+            size_t run = SIZE_MAX;
+            for (int i = 0; i < count; ++i) {
+                const size_t left = sizes[i] / BlockSize - done[i];
+                if (left == 0) continue;
+                active[activeCount++] = i;
+                run = std::min(run, left);
+            }
+            if (activeCount < 2)
+                break;
+
+            alignas(32) quint32 words[8][MaxLanes] = {};
+            const uchar* lanes[MaxLanes];
+            for (int l = 0; l < MaxLanes; ++l) {
+                if (l < activeCount) {
+                    const int i = active[l];
+                    lanes[l] = data[i] + done[i] * BlockSize;
+                    for (int s = 0; s < 8; ++s)
+                        words[s][l] = states[i][s];
+                } else {
+                    lanes[l] = idleBlock;
+                }
+            }
+
+            __m256i state[8];
+            for (int s = 0; s < 8; ++s)
+                state[s] = _mm256_load_si256(reinterpret_cast<const __m256i*>(words[s]));
+
+            if (activeCount == MaxLanes) {
+                compressAvx2x8(state, lanes, run);
+            } else {
+                // Idle lanes must not advance past their single zero block
+                for (size_t n = 0; n < run; ++n) {
+                    compressAvx2x8(state, lanes, 1);
+                    for (int l = activeCount; l < MaxLanes; ++l)
+                        lanes[l] = idleBlock;
+                }
+            }
+
+            for (int s = 0; s < 8; ++s)
+                _mm256_store_si256(reinterpret_cast<__m256i*>(words[s]), state[s]);
+            for (int l = 0; l < activeCount; ++l) {
+                const int i = active[l];
+                for (int s = 0; s < 8; ++s)
+                    states[i][s] = words[s][l];
+                done[i] += run;
+            }
+        }
+
+        for (int i = 0; i < count; ++i) {
+            const size_t blocks = sizes[i] / BlockSize;
+            compress()(states[i], data[i] + done[i] * BlockSize, blocks - done[i]);
+            finish(states[i], data[i], sizes[i], out[i]);
+        }
+    }
+#endif
+
+    void digestBatch(const uchar* const* data, const size_t* sizes, int count, ContentDigest* out)
+    {
+#if defined(PHOTOBOSS_X86)
+        // SHA-NI on one buffer outruns eight AVX2 lanes
+        if (CpuFeatures::get().avx2 && !CpuFeatures::get().sha) {
+            for (int first = 0; first < count; first += MaxLanes)
+                digestGroupAvx2(data + first, sizes + first, std::min(MaxLanes, count - first), out + first);
+            return;
+        }
+#endif
+        for (int i = 0; i < count; ++i)
+            out[i] = digest(data[i], sizes[i]);
+    }
+
+}
@@ -0,0 +1,11 @@
+#include "hashing/Xxh3Hash.h"
+#include "hashing/Xxh3Kernel.h"
+
+namespace photoboss
+{
+    void Xxh3Hash::hash(const QByteArray& data, HashDigest& digest)
+    {
+        digest.setContent(xxh3::digest128(reinterpret_cast<const uchar*>(data.constData()),
+            static_cast<size_t>(data.size())));
+    }
+}
@@ -0,0 +1,385 @@
+#include "hashing/Xxh3Kernel.h"
+#include "util/CpuFeatures.h"
+#include <cstring>
+
+#if defined(PHOTOBOSS_X86)
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace photoboss::xxh3 {
+
+    // Constants and structure follow the xxHash 0.8 specification
+    // (xxhash_spec.md); the in-tree copy keeps the dependency count at zero.
+
+    static constexpr quint32 Prime32_1 = 0x9E3779B1U;
+    static constexpr quint32 Prime32_2 = 0x85EBCA77U;
+    static constexpr quint32 Prime32_3 = 0xC2B2AE3DU;
+    static constexpr quint64 Prime64_1 = 0x9E3779B185EBCA87ULL;
+    static constexpr quint64 Prime64_2 = 0xC2B2AE3D27D4EB4FULL;
+    static constexpr quint64 Prime64_3 = 0x165667B19E3779F9ULL;
+    static constexpr quint64 Prime64_4 = 0x85EBCA77C2B2AE63ULL;
+    static constexpr quint64 Prime64_5 = 0x27D4EB2F165667C5ULL;
+    static constexpr quint64 PrimeMx1 = 0x165667919E3779F9ULL;
+    static constexpr quint64 PrimeMx2 = 0x9FB21C651E98DF25ULL;
+
+    static constexpr size_t StripeLen = 64;
+    static constexpr size_t SecretSize = 192;
+    static constexpr size_t SecretConsumeRate = 8;
+    static constexpr size_t StripesPerBlock = (SecretSize - StripeLen) / SecretConsumeRate;
+    static constexpr size_t BlockLen = StripeLen * StripesPerBlock;
+
+    alignas(64) static constexpr uchar kSecret[SecretSize] = {
+        0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+        0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+        0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+        0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+        0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+        0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+        0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+        0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+        0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+        0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+        0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+        0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+    };
+
+    struct U128 {
+        quint64 low;
+        quint64 high;
+    };
+
+    // ---------------------------------------------------------------
+    // Primitives
+    // ---------------------------------------------------------------
+
+    static inline quint32 read32(const uchar* p)
+    {
+        quint32 v;
+        std::memcpy(&v, p, sizeof(v));   // little-endian hosts only, as everywhere else
+        return v;
+    }
+
+    static inline quint64 read64(const uchar* p)
+    {
+        quint64 v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static inline quint32 swap32(quint32 x)
+    {
+        return ((x << 24) & 0xff000000U) | ((x << 8) & 0x00ff0000U) |
+               ((x >> 8) & 0x0000ff00U) | ((x >> 24) & 0x000000ffU);
+    }
+
+    static inline quint64 swap64(quint64 x)
+    {
+        return (static_cast<quint64>(swap32(static_cast<quint32>(x))) << 32) |
+               swap32(static_cast<quint32>(x >> 32));
+    }
+
+    static inline quint32 rotl32(quint32 x, int r) { return (x << r) | (x >> (32 - r)); }
+
+    static inline U128 mult64to128(quint64 a, quint64 b)
+    {
+#if defined(__SIZEOF_INT128__)
+        const unsigned __int128 p = static_cast<unsigned __int128>(a) * b;
+        return { static_cast<quint64>(p), static_cast<quint64>(p >> 64) };
+#elif defined(_MSC_VER) && defined(_M_X64)
+        U128 r;
+        r.low = _umul128(a, b, &r.high);
+        return r;
+#elif defined(_MSC_VER) && defined(_M_ARM64)
+        return { a * b, __umulh(a, b) };
+#else
+        const quint64 loLo = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+        const quint64 hiLo = (a >> 32) * (b & 0xFFFFFFFF);
+        const quint64 loHi = (a & 0xFFFFFFFF) * (b >> 32);
+        const quint64 hiHi = (a >> 32) * (b >> 32);
+        const quint64 cross = (loLo >> 32) + (hiLo & 0xFFFFFFFF) + loHi;
+        return { (cross << 32) | (loLo & 0xFFFFFFFF), (hiLo >> 32) + (cross >> 32) + hiHi };
+#endif
+    }
+
+    static inline quint64 mul128fold64(quint64 a, quint64 b)
+    {
+        const U128 p = mult64to128(a, b);
+        return p.low ^ p.high;
+    }
+
+    static inline quint64 xorshift64(quint64 v, int shift) { return v ^ (v >> shift); }
+
+    static inline quint64 avalanche(quint64 h)
+    {
+        h = xorshift64(h, 37);
+        h *= PrimeMx1;
+        return xorshift64(h, 32);
+    }
+
+    static inline quint64 xxh64Avalanche(quint64 h)
+    {
+        h ^= h >> 33;
+        h *= Prime64_2;
+        h ^= h >> 29;
+        h *= Prime64_3;
+        h ^= h >> 32;
+        return h;
+    }
+
+    static inline quint64 mix16B(const uchar* input, const uchar* secret)
+    {
+        return mul128fold64(read64(input) ^ read64(secret), read64(input + 8) ^ read64(secret + 8));
+    }
+
+    static inline void mix32B(U128& acc, const uchar* input1, const uchar* input2, const uchar* secret)
+    {
+        acc.low += mix16B(input1, secret);
+        acc.low ^= read64(input2) + read64(input2 + 8);
+        acc.high += mix16B(input2, secret + 16);
+        acc.high ^= read64(input1) + read64(input1 + 8);
+    }
+
+    // ---------------------------------------------------------------
+    // Short inputs (0 - 240 bytes)
+    // ---------------------------------------------------------------
+
+    static U128 len1to3(const uchar* input, size_t len)
+    {
+        const quint32 c1 = input[0];
+        const quint32 c2 = input[len >> 1];
+        const quint32 c3 = input[len - 1];
+        const quint32 combinedLow = (c1 << 16) | (c2 << 24) | c3 | (static_cast<quint32>(len) << 8);
+        const quint32 combinedHigh = rotl32(swap32(combinedLow), 13);
+        const quint64 bitflipLow = read32(kSecret) ^ read32(kSecret + 4);
+        const quint64 bitflipHigh = read32(kSecret + 8) ^ read32(kSecret + 12);
+        return { xxh64Avalanche(combinedLow ^ bitflipLow), xxh64Avalanche(combinedHigh ^ bitflipHigh) };
+    }
+
+    static U128 len4to8(const uchar* input, size_t len)
+    {
+        const quint64 input64 = read32(input) + (static_cast<quint64>(read32(input + len - 4)) << 32);
+        const quint64 bitflip = read64(kSecret + 16) ^ read64(kSecret + 24);
+        U128 m = mult64to128(input64 ^ bitflip, Prime64_1 + (len << 2));
+        m.high += m.low << 1;
+        m.low ^= m.high >> 3;
+        m.low = xorshift64(m.low, 35);
+        m.low *= PrimeMx2;
+        m.low = xorshift64(m.low, 28);
+        m.high = avalanche(m.high);
+        return m;
+    }
+
+    static U128 len9to16(const uchar* input, size_t len)
+    {
+        const quint64 bitflipLow = read64(kSecret + 32) ^ read64(kSecret + 40);
+        const quint64 bitflipHigh = read64(kSecret + 48) ^ read64(kSecret + 56);
+        const quint64 inputLow = read64(input);
+        quint64 inputHigh = read64(input + len - 8);
+        U128 m = mult64to128(inputLow ^ inputHigh ^ bitflipLow, Prime64_1);
+        m.low += static_cast<quint64>(len - 1) << 54;
+        inputHigh ^= bitflipHigh;
+        m.high += inputHigh + static_cast<quint64>(static_cast<quint32>(inputHigh)) * (Prime32_2 - 1);
+        m.low ^= swap64(m.high);
+
+        U128 h = mult64to128(m.low, Prime64_2);
+        h.high += m.high * Prime64_2;
+        return { avalanche(h.low), avalanche(h.high) };
+    }
+
+    static U128 len0to16(const uchar* input, size_t len)
+    {
+        if (len > 8) return len9to16(input, len);
+        if (len >= 4) return len4to8(input, len);
+        if (len > 0) return len1to3(input, len);
+        return { xxh64Avalanche(read64(kSecret + 64) ^ read64(kSecret + 72)),
+                 xxh64Avalanche(read64(kSecret + 80) ^ read64(kSecret + 88)) };
+    }
+
+    static U128 finalizeMid(const U128& acc, size_t len)
+    {
+        const quint64 low = acc.low + acc.high;
+        const quint64 high = acc.low * Prime64_1 + acc.high * Prime64_4 + static_cast<quint64>(len) * Prime64_2;
+        return { avalanche(low), 0 - avalanche(high) };
+    }
+
+    static U128 len17to128(const uchar* input, size_t len)
+    {
+        U128 acc = { len * Prime64_1, 0 };
+        if (len > 32) {
+            if (len > 64) {
+                if (len > 96)
+                    mix32B(acc, input + 48, input + len - 64, kSecret + 96);
+                mix32B(acc, input + 32, input + len - 48, kSecret + 64);
+            }
+            mix32B(acc, input + 16, input + len - 32, kSecret + 32);
+        }
+        mix32B(acc, input, input + len - 16, kSecret);
+        return finalizeMid(acc, len);
+    }
+
+    static U128 len129to240(const uchar* input, size_t len)
+    {
+        static constexpr size_t MidStartOffset = 3;
+        static constexpr size_t MidLastOffset = 17;
+        static constexpr size_t SecretSizeMin = 136;
+
+        const size_t rounds = len / 32;
+        U128 acc = { len * Prime64_1, 0 };
+        for (size_t i = 0; i < 4; ++i)
+            mix32B(acc, input + 32 * i, input + 32 * i + 16, kSecret + 32 * i);
+        acc.low = avalanche(acc.low);
+        acc.high = avalanche(acc.high);
+        for (size_t i = 4; i < rounds; ++i)
+            mix32B(acc, input + 32 * i, input + 32 * i + 16, kSecret + MidStartOffset + 32 * (i - 4));
+        mix32B(acc, input + len - 16, input + len - 32, kSecret + SecretSizeMin - MidLastOffset - 16);
+        return finalizeMid(acc, len);
+    }
+
+    // ---------------------------------------------------------------
+    // Long inputs: 8 x 64-bit accumulators over 64-byte stripes
+    // ---------------------------------------------------------------
+
+    static constexpr size_t LastAccStart = 7;
+    static constexpr size_t MergeAccsStart = 11;
+
+    static inline void accumulate512Scalar(quint64* acc, const uchar* input, const uchar* secret)
+    {
+        for (int i = 0; i < 8; ++i) {
+            const quint64 data = read64(input + 8 * i);
+            const quint64 key = data ^ read64(secret + 8 * i);
+            acc[i ^ 1] += data;
+            acc[i] += static_cast<quint64>(static_cast<quint32>(key)) * (key >> 32);
+        }
+    }
+
+    static inline void scrambleScalar(quint64* acc, const uchar* secret)
+    {
+        for (int i = 0; i < 8; ++i) {
+            quint64 a = xorshift64(acc[i], 47);
+            a ^= read64(secret + 8 * i);
+            acc[i] = a * Prime32_1;
+        }
+    }
+
+    static void internalLoopScalar(quint64* acc, const uchar* input, size_t len)
+    {
+        const size_t blocks = (len - 1) / BlockLen;
+        for (size_t n = 0; n < blocks; ++n) {
+            for (size_t s = 0; s < StripesPerBlock; ++s)
+                accumulate512Scalar(acc, input + n * BlockLen + s * StripeLen, kSecret + s * SecretConsumeRate);
+            scrambleScalar(acc, kSecret + SecretSize - StripeLen);
+        }
+
+        const size_t stripes = ((len - 1) - BlockLen * blocks) / StripeLen;
+        for (size_t s = 0; s < stripes; ++s)
+            accumulate512Scalar(acc, input + blocks * BlockLen + s * StripeLen, kSecret + s * SecretConsumeRate);
+        accumulate512Scalar(acc, input + len - StripeLen, kSecret + SecretSize - StripeLen - LastAccStart);
+    }
+
+#if defined(PHOTOBOSS_X86)
+    PHOTOBOSS_TARGET_AVX2 static inline void accumulate512Avx2(__m256i& acc0, __m256i& acc1,
+        const uchar* input, const uchar* secret)
+    {
+        const __m256i data0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input));
+        const __m256i data1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + 32));
+        const __m256i key0 = _mm256_xor_si256(data0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(secret)));
+        const __m256i key1 = _mm256_xor_si256(data1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(secret + 32)));
+
+        // low 32 bits x high 32 bits of each key, plus the neighbouring
+        // lane's raw data
+        const __m256i product0 = _mm256_mul_epu32(key0, _mm256_srli_epi64(key0, 32));
+        const __m256i product1 = _mm256_mul_epu32(key1, _mm256_srli_epi64(key1, 32));
+        const __m256i swapped0 = _mm256_shuffle_epi32(data0, _MM_SHUFFLE(1, 0, 3, 2));
+        const __m256i swapped1 = _mm256_shuffle_epi32(data1, _MM_SHUFFLE(1, 0, 3, 2));
+        acc0 = _mm256_add_epi64(product0, _mm256_add_epi64(acc0, swapped0));
+        acc1 = _mm256_add_epi64(product1, _mm256_add_epi64(acc1, swapped1));
+    }
+
+    PHOTOBOSS_TARGET_AVX2 static inline __m256i scrambleAvx2(__m256i acc, const uchar* secret)
+    {
+        const __m256i prime = _mm256_set1_epi32(static_cast<int>(Prime32_1));
+        acc = _mm256_xor_si256(acc, _mm256_srli_epi64(acc, 47));
+        acc = _mm256_xor_si256(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(secret)));
+
+        // 64 x 32-bit multiply from two 32 x 32 halves
+        const __m256i low = _mm256_mul_epu32(acc, prime);
+        const __m256i high = _mm256_mul_epu32(_mm256_srli_epi64(acc, 32), prime);
+        return _mm256_add_epi64(low, _mm256_slli_epi64(high, 32));
+    }
+
+    PHOTOBOSS_TARGET_AVX2 static void internalLoopAvx2(quint64* acc, const uchar* input, size_t len)
+    {
+        __m256i acc0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc));
+        __m256i acc1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + 4));
+
+        const size_t blocks = (len - 1) / BlockLen;
+        for (size_t n = 0; n < blocks; ++n) {
+            const uchar* block = input + n * BlockLen;
+            for (size_t s = 0; s < StripesPerBlock; ++s)
+                accumulate512Avx2(acc0, acc1, block + s * StripeLen, kSecret + s * SecretConsumeRate);
+            acc0 = scrambleAvx2(acc0, kSecret + SecretSize - StripeLen);
+            acc1 = scrambleAvx2(acc1, kSecret + SecretSize - StripeLen + 32);
+        }
+
+        const size_t stripes = ((len - 1) - BlockLen * blocks) / StripeLen;
+        for (size_t s = 0; s < stripes; ++s)
+            accumulate512Avx2(acc0, acc1, input + blocks * BlockLen + s * StripeLen, kSecret + s * SecretConsumeRate);
+        accumulate512Avx2(acc0, acc1, input + len - StripeLen, kSecret + SecretSize - StripeLen - LastAccStart);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc), acc0);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + 4), acc1);
+    }
+#endif
+
+    using InternalLoopFn = void (*)(quint64*, const uchar*, size_t);
+
+    static InternalLoopFn selectInternalLoop()
+    {
+#if defined(PHOTOBOSS_X86)
+        if (CpuFeatures::get().avx2)
+            return internalLoopAvx2;
+#endif
+        return internalLoopScalar;
+    }
+
+    static quint64 mergeAccs(const quint64* acc, const uchar* secret, quint64 start)
+    {
+        quint64 result = start;
+        for (int i = 0; i < 4; ++i)
+            result += mul128fold64(acc[2 * i] ^ read64(secret + 16 * i), acc[2 * i + 1] ^ read64(secret + 16 * i + 8));
+        return avalanche(result);
+    }
+
+    static U128 hashLong(const uchar* input, size_t len)
+    {
+        static const InternalLoopFn internalLoop = selectInternalLoop();
+
+        alignas(32) quint64 acc[8] = {
+            Prime32_3, Prime64_1, Prime64_2, Prime64_3, Prime64_4, Prime32_2, Prime64_5, Prime32_1
+        };
+        internalLoop(acc, input, len);
+
+        return { mergeAccs(acc, kSecret + MergeAccsStart, len * Prime64_1),
+                 mergeAccs(acc, kSecret + SecretSize - sizeof(acc) - MergeAccsStart, ~(len * Prime64_2)) };
+    }
+
+    ContentDigest digest128(const uchar* data, size_t size)
+    {
+        U128 h;
+        if (size <= 16) h = len0to16(data, size);
+        else if (size <= 128) h = len17to128(data, size);
+        else if (size <= 240) h = len129to240(data, size);
+        else h = hashLong(data, size);
+
+        ContentDigest out{};
+        for (int i = 0; i < 8; ++i) {
+            out[i] = static_cast<quint8>(h.high >> (56 - 8 * i));
+            out[8 + i] = static_cast<quint8>(h.low >> (56 - 8 * i));
+        }
+        return out;
+    }
+
+}
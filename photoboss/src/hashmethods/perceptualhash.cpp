@@ -1,113 +1,80 @@
 #include <QString>
 #include <QtMath>
-#include <vector>
+#include <array>
 #include <algorithm>
-#include <QImage>
 #include "hashing/HashMethod.h"
 #include "hashing/PerceptualHash.h"
+#include "hashing/DctKernel.h"
 
 namespace photoboss
 {
-    struct DCTConstants {
-        double matrix[32][32];
-
-        DCTConstants() {
-            for (int i = 0; i < 32; ++i) {
-                // The DCT-II basis formula
-                double alpha = (i == 0) ? std::sqrt(1.0 / 32.0) : std::sqrt(2.0 / 32.0);
-                for (int j = 0; j < 32; ++j) {
-                    matrix[i][j] = alpha * std::cos((M_PI * i * (2.0 * j + 1.0)) / 64.0);
-                }
-            }
-        }
-    };
-
-    QString PerceptualHash::compute(const PerceptualImage& image)
+    // Median-threshold the 64 low-frequency coefficients into the hash
+    static quint64 hashFromCoefficients(const qint32* coeffs)
     {
-        static const DCTConstants dct_consts;
-
-        // 2. Load pixels into double array
-        double pixels[32][32];
-        for (int y = 0; y < 32; ++y) {
-            for (int x = 0; x < 32; ++x) {
-                pixels[y][x] = image.pixel(x, y);
-            }
-        }
-
-        // 3. Compute Partial 2D DCT (Only the 8x8 top-left area)
-        // Operation: Temp = Matrix * Pixels
-        double temp[8][32];
-        for (int i = 0; i < 8; ++i) {
-            for (int j = 0; j < 32; ++j) {
-                double sum = 0.0;
-                for (int k = 0; k < 32; ++k) {
-                    sum += dct_consts.matrix[i][k] * pixels[k][j];
-                }
-                temp[i][j] = sum;
-            }
-        }
-
-        // Operation: Result = Temp * Matrix_Transposed
-        double dct_final[8][8];
-        for (int i = 0; i < 8; ++i) {
-            for (int j = 0; j < 8; ++j) {
-                double sum = 0.0;
-                for (int k = 0; k < 32; ++k) {
-                    sum += temp[i][k] * dct_consts.matrix[j][k];
-                }
-                dct_final[i][j] = sum;
-            }
-        }
-
-        // 4. Flatten to 64 values and find median
-        // Note: We skip dct_final[0][0] (the DC coefficient) for better frequency analysis
-        std::vector<double> flat;
-        flat.reserve(64);
-        for (int i = 0; i < 8; ++i) {
-            for (int j = 0; j < 8; ++j) {
-                flat.push_back(dct_final[i][j]);
-            }
-        }
-
-
-        std::vector<double> sorted_copy = flat;
+        // 1. Find median of the 64 values
+        // Note: We skip coeffs[0] (the DC coefficient) for better frequency analysis
+        std::array<qint32, 64> sorted_copy;
+        std::copy(coeffs, coeffs + 64, sorted_copy.begin());
         // Use 1 to skip the first element (DC coefficient) for the median
         auto median_it = sorted_copy.begin() + 32;
         std::nth_element(sorted_copy.begin() + 1, median_it, sorted_copy.end());
-        double median = *median_it;
+        const qint32 median = *median_it;
 
-        // 5. Build 64-bit integer hash
+        // 2. Build 64-bit integer hash
         quint64 hash_val = 0;
         for (int i = 0; i < 64; ++i) {
-            if (flat[i] > median) {
+            if (coeffs[i] > median) {
                 hash_val |= (1ULL << i);
             }
         }
-
-        // 6. Return as 16-character hex string
-        return QString("%1").arg(hash_val, 16, 16, QChar('0'));
+        return hash_val;
     }
 
-    double PerceptualHash::compare(const QString& hash1, const QString& hash2) const
+    // Stores the pHash and, from the same coefficients, the pHash of the
+    // plane turned to its canonical pose. Rotating or mirroring an image
+    // only permutes and negates its DCT coefficients, so the 8 orientations
+    // cost a table walk instead of 8 resizes and DCTs.
+    static void storeHashes(const qint32* coeffs, HashDigest& digest)
     {
-        if (hash1.length() != hash2.length() || hash1.isEmpty()) return 0.0;
-
-        // Convert hex strings back to bitsets (uint64)
-        bool ok1, ok2;
-        quint64 v1 = hash1.toULongLong(&ok1, 16);
-        quint64 v2 = hash2.toULongLong(&ok2, 16);
-
-        if (!ok1 || !ok2) return 0.0;
+        std::array<qint32, 64> canonical;
+        dct::dihedral8x8(coeffs, dct::canonicalPose(coeffs), canonical.data());
 
-        // XOR finds differing bits, qPopulationCount counts them
-        int distance = qPopulationCount(v1 ^ v2);
+        digest.setValue(HashKind::Perceptual, hashFromCoefficients(coeffs));
+        digest.setValue(HashKind::PerceptualCanonical, hashFromCoefficients(canonical.data()));
+    }
 
-        // Return similarity (1.0 = identical, 0.0 = completely different)
-        return 1.0 - (static_cast<double>(distance) / 64.0);
+    void PerceptualHash::hash(const PerceptualImage& image, HashDigest& digest)
+    {
+        // Partial 2D DCT (only the 8x8 top-left area), read straight from
+        // the padded 32x32 plane
+        std::array<qint32, 64> coeffs;
+        dct::lowFrequency8x8(image.bits(), image.bytesPerLine(), coeffs.data());
+        storeHashes(coeffs.data(), digest);
     }
 
-    HashInput PerceptualHash::inputType() const
+    void PerceptualHash::hashBatch(const std::vector<const PerceptualImage*>& images,
+        const std::vector<HashDigest*>& digests)
     {
-        return HashInput::Image;
+        if (images.empty()) return;
+
+        // Every PerceptualImage is the same 32x32 Grayscale8 plane, so the
+        // whole batch goes through the DCT as one matrix product.
+        const int stride = images.front()->bytesPerLine();
+        std::vector<const uchar*> planes;
+        planes.reserve(images.size());
+        for (const PerceptualImage* image : images) {
+            if (image->bytesPerLine() != stride) {
+                for (size_t i = 0; i < images.size(); ++i)
+                    hash(*images[i], *digests[i]);
+                return;
+            }
+            planes.push_back(image->bits());
+        }
+
+        std::vector<qint32> coeffs(planes.size() * 64);
+        dct::lowFrequency8x8Batch(planes.data(), stride, static_cast<int>(planes.size()), coeffs.data());
+
+        for (size_t i = 0; i < images.size(); ++i)
+            storeHashes(coeffs.data() + i * 64, *digests[i]);
     }
-}
\ No newline at end of file
+}
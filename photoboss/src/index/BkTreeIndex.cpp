@@ -0,0 +1,83 @@
+#include "index/BkTreeIndex.h"
+#include <bit>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace photoboss {
+
+    BkTreeIndex::BkTreeIndex(int radius)
+        : m_radius_(radius)
+    {
+        if (radius < 0 || radius > 64)
+            throw std::invalid_argument("BkTreeIndex: radius must be 0..64");
+    }
+
+    void BkTreeIndex::insert(quint32 id, quint64 hash)
+    {
+        const quint32 slot = m_slots_.add(id, hash);
+        m_nodes_.emplace_back();
+        if (slot == 0)
+            return;
+
+        quint32 cur = 0;
+        for (;;) {
+            const int d = std::popcount(hash ^ m_slots_.hash(cur));
+            quint32 child = m_nodes_[cur].firstChild;
+            while (child != None && m_nodes_[child].edge != d)
+                child = m_nodes_[child].nextSibling;
+            if (child == None) {
+                m_nodes_[slot].edge = d;
+                m_nodes_[slot].nextSibling = m_nodes_[cur].firstChild;
+                m_nodes_[cur].firstChild = slot;
+                return;
+            }
+            cur = child;
+        }
+    }
+
+    void BkTreeIndex::remove(quint32 id)
+    {
+        m_slots_.remove(id);
+        if (m_slots_.wantsCompaction())
+            compact();
+    }
+
+    void BkTreeIndex::clear()
+    {
+        m_slots_.clear();
+        m_nodes_.clear();
+    }
+
+    void BkTreeIndex::compact()
+    {
+        const auto live = m_slots_.takeLive();
+        clear();
+        m_nodes_.reserve(live.size());
+        for (const auto& [id, hash] : live)
+            insert(id, hash);
+    }
+
+    void BkTreeIndex::query(quint64 hash, std::vector<Match>& out) const
+    {
+        if (m_nodes_.empty())
+            return;
+
+        std::vector<quint32> stack{ 0 };
+        while (!stack.empty()) {
+            const quint32 cur = stack.back();
+            stack.pop_back();
+
+            const int d = std::popcount(hash ^ m_slots_.hash(cur));
+            if (d <= m_radius_ && m_slots_.live(cur))
+                out.push_back({ m_slots_.id(cur), d });
+
+            // Triangle inequality: anything under a child at edge e is
+            // exactly e from cur, so at least |e - d| from the query
+            for (quint32 child = m_nodes_[cur].firstChild; child != None; child = m_nodes_[child].nextSibling) {
+                if (std::abs(m_nodes_[child].edge - d) <= m_radius_)
+                    stack.push_back(child);
+            }
+        }
+    }
+
+}
@@ -0,0 +1,130 @@
+#include "index/HammingKernel.h"
+#include "util/CpuFeatures.h"
+#include <bit>
+
+#if defined(PHOTOBOSS_X86)
+#include <immintrin.h>
+#elif defined(PHOTOBOSS_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace photoboss::hamming {
+
+    // Mask of one block of BlockSize hashes
+    using BlockMaskFn = quint64 (*)(const quint64* hashes, quint64 query, int maxDistance);
+
+    // ---------------------------------------------------------------
+    // Scalar
+    // ---------------------------------------------------------------
+
+    static quint64 blockMaskScalar(const quint64* hashes, quint64 query, int maxDistance)
+    {
+        quint64 mask = 0;
+        for (size_t i = 0; i < BlockSize; ++i) {
+            if (std::popcount(hashes[i] ^ query) <= maxDistance)
+                mask |= 1ULL << i;
+        }
+        return mask;
+    }
+
+    // ---------------------------------------------------------------
+    // x86
+    // ---------------------------------------------------------------
+
+#if defined(PHOTOBOSS_X86)
+    PHOTOBOSS_TARGET_AVX2
+    static quint64 blockMaskAvx2(const quint64* hashes, quint64 query, int maxDistance)
+    {
+        // Per-byte popcount through a nibble table, summed into each 64-bit
+        // lane by SAD against zero
+        const __m256i table = _mm256_setr_epi8(
+            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i low = _mm256_set1_epi8(0x0F);
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i q = _mm256_set1_epi64x(static_cast<long long>(query));
+        const __m256i limit = _mm256_set1_epi64x(maxDistance);
+
+        quint64 mask = 0;
+        for (size_t i = 0; i < BlockSize; i += 4) {
+            const __m256i x = _mm256_xor_si256(
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hashes + i)), q);
+            const __m256i lo = _mm256_shuffle_epi8(table, _mm256_and_si256(x, low));
+            const __m256i hi = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(x, 4), low));
+            const __m256i counts = _mm256_sad_epu8(_mm256_add_epi8(lo, hi), zero);
+            const int over = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(counts, limit)));
+            mask |= static_cast<quint64>(~over & 0xF) << i;
+        }
+        return mask;
+    }
+
+    PHOTOBOSS_TARGET_AVX512POPCNT
+    static quint64 blockMaskAvx512(const quint64* hashes, quint64 query, int maxDistance)
+    {
+        const __m512i q = _mm512_set1_epi64(static_cast<long long>(query));
+        const __m512i limit = _mm512_set1_epi64(maxDistance);
+
+        quint64 mask = 0;
+        for (size_t i = 0; i < BlockSize; i += 8) {
+            const __m512i x = _mm512_xor_si512(_mm512_loadu_si512(hashes + i), q);
+            const __mmask8 within = _mm512_cmple_epi64_mask(_mm512_popcnt_epi64(x), limit);
+            mask |= static_cast<quint64>(within) << i;
+        }
+        return mask;
+    }
+#endif
+
+    // ---------------------------------------------------------------
+    // NEON
+    // ---------------------------------------------------------------
+
+#if defined(PHOTOBOSS_NEON)
+    static quint64 blockMaskNeon(const quint64* hashes, quint64 query, int maxDistance)
+    {
+        const uint64x2_t q = vdupq_n_u64(query);
+        const uint64x2_t limit = vdupq_n_u64(static_cast<quint64>(maxDistance));
+
+        quint64 mask = 0;
+        for (size_t i = 0; i < BlockSize; i += 2) {
+            const uint8x16_t x = vreinterpretq_u8_u64(veorq_u64(vld1q_u64(hashes + i), q));
+            const uint64x2_t counts = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(vcntq_u8(x))));
+            const uint64x2_t within = vcleq_u64(counts, limit);
+            mask |= (vgetq_lane_u64(within, 0) & 1) << i;
+            mask |= (vgetq_lane_u64(within, 1) & 1) << (i + 1);
+        }
+        return mask;
+    }
+#endif
+
+    // ---------------------------------------------------------------
+    // Dispatch
+    // ---------------------------------------------------------------
+
+    static BlockMaskFn selectBlockMask()
+    {
+#if defined(PHOTOBOSS_X86)
+        if (CpuFeatures::get().avx512popcnt)
+            return blockMaskAvx512;
+        if (CpuFeatures::get().avx2)
+            return blockMaskAvx2;
+#elif defined(PHOTOBOSS_NEON)
+        if (CpuFeatures::get().neon)
+            return blockMaskNeon;
+#endif
+        return blockMaskScalar;
+    }
+
+    void withinMask(const quint64* hashes, size_t blocks, quint64 query, int maxDistance, quint64* masks)
+    {
+        static const BlockMaskFn blockMask = selectBlockMask();
+
+        if (maxDistance < 0) {
+            for (size_t b = 0; b < blocks; ++b)
+                masks[b] = 0;
+            return;
+        }
+        for (size_t b = 0; b < blocks; ++b)
+            masks[b] = blockMask(hashes + b * BlockSize, query, maxDistance);
+    }
+
+}
@@ -0,0 +1,97 @@
+#include "index/HashColumns.h"
+#include <bit>
+
+namespace photoboss {
+
+    using hamming::BlockSize;
+
+    int HashColumns::columnOf(HashKind kind)
+    {
+        for (size_t c = 0; c < Kinds.size(); ++c) {
+            if (Kinds[c] == kind)
+                return static_cast<int>(c);
+        }
+        return -1;
+    }
+
+    void HashColumns::set(quint32 row, const HashDigest& digest)
+    {
+        const size_t block = row / BlockSize;
+        const quint64 bit = 1ULL << (row % BlockSize);
+        if (row >= m_rows_) {
+            m_rows_ = size_t(row) + 1;
+            for (Column& column : m_columns_) {
+                if (column.blocks.size() <= block) {
+                    column.blocks.resize(block + 1, Block{});
+                    column.present.resize(block + 1, 0);
+                }
+            }
+        }
+
+        for (size_t c = 0; c < Kinds.size(); ++c) {
+            Column& column = m_columns_[c];
+            if (digest.has(Kinds[c])) {
+                column.blocks[block].hashes[row % BlockSize] = digest.value(Kinds[c]);
+                column.present[block] |= bit;
+            } else {
+                column.present[block] &= ~bit;
+            }
+        }
+    }
+
+    void HashColumns::clear()
+    {
+        for (Column& column : m_columns_) {
+            column.blocks.clear();
+            column.present.clear();
+        }
+        m_rows_ = 0;
+    }
+
+    void HashColumns::filter(const std::vector<Gate>& gates, std::vector<quint64>& masks) const
+    {
+        const size_t blocks = (m_rows_ + BlockSize - 1) / BlockSize;
+        masks.assign(blocks, ~0ULL);
+        if (blocks == 0)
+            return;
+        if (m_rows_ % BlockSize)
+            masks.back() = (1ULL << (m_rows_ % BlockSize)) - 1;
+
+        std::vector<quint64> within(blocks);
+        for (const Gate& gate : gates) {
+            const int c = columnOf(gate.kind);
+            if (c < 0)
+                continue;
+            const Column& column = m_columns_[c];
+            hamming::withinMask(column.blocks.data()->hashes, blocks, gate.query, gate.maxDistance, within.data());
+            for (size_t b = 0; b < blocks; ++b) {
+                const quint64 present = column.present[b];
+                masks[b] &= (within[b] & present) | (gate.absentPasses ? ~present : 0);
+            }
+        }
+    }
+
+    bool HashColumns::passes(quint32 row, const std::vector<Gate>& gates) const
+    {
+        if (row >= m_rows_)
+            return false;
+
+        const size_t block = row / BlockSize;
+        const quint64 bit = 1ULL << (row % BlockSize);
+        for (const Gate& gate : gates) {
+            const int c = columnOf(gate.kind);
+            if (c < 0)
+                continue;
+            const Column& column = m_columns_[c];
+            if (!(column.present[block] & bit)) {
+                if (!gate.absentPasses)
+                    return false;
+                continue;
+            }
+            if (std::popcount(column.blocks[block].hashes[row % BlockSize] ^ gate.query) > gate.maxDistance)
+                return false;
+        }
+        return true;
+    }
+
+}
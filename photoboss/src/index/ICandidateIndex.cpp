@@ -0,0 +1,21 @@
+#include "index/ICandidateIndex.h"
+#include "index/BkTreeIndex.h"
+#include "index/MihIndex.h"
+#include "index/VpTreeIndex.h"
+
+namespace photoboss {
+
+    std::unique_ptr<ICandidateIndex> ICandidateIndex::create(CandidateIndexKind kind, int radius, int bands)
+    {
+        switch (kind) {
+        case CandidateIndexKind::BkTree:
+            return std::make_unique<BkTreeIndex>(radius);
+        case CandidateIndexKind::VpTree:
+            return std::make_unique<VpTreeIndex>(radius);
+        case CandidateIndexKind::MultiIndex:
+            break;
+        }
+        return std::make_unique<MihIndex>(radius, bands);
+    }
+
+}
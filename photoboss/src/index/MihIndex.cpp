@@ -0,0 +1,132 @@
+#include "index/MihIndex.h"
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+namespace photoboss {
+
+    MihIndex::MihIndex(int radius, int bands)
+        : m_radius_(radius)
+    {
+        // 2..32 bands keeps every substring within 32 bits and above 1
+        if (bands < 2 || bands > 32 || radius < 0 || radius > 64)
+            throw std::invalid_argument("MihIndex: bands must be 2..32 and radius 0..64");
+
+        m_flips_ = radius / bands;
+        for (const mih::Band& geometry : mih::split(bands))
+            m_bands_.push_back({ geometry, {} });
+    }
+
+    void MihIndex::insert(quint32 id, quint64 hash)
+    {
+        const size_t bandCount = m_bands_.size();
+        quint32 slot;
+        if (!m_free_.empty()) {
+            slot = m_free_.back();
+            m_free_.pop_back();
+        } else {
+            slot = static_cast<quint32>(m_hashes_.size());
+            m_hashes_.push_back(0);
+            m_ids_.push_back(0);
+            m_idNext_.push_back(None);
+            m_next_.resize(m_next_.size() + bandCount, None);
+        }
+        m_hashes_[slot] = hash;
+        m_ids_[slot] = id;
+
+        for (size_t b = 0; b < bandCount; ++b) {
+            auto [it, inserted] = m_bands_[b].heads.try_emplace(key(m_bands_[b], hash), slot);
+            m_next_[slot * bandCount + b] = inserted ? None : it->second;
+            it->second = slot;
+        }
+
+        if (id >= m_idHead_.size())
+            m_idHead_.resize(id + 1, None);
+        m_idNext_[slot] = m_idHead_[id];
+        m_idHead_[id] = slot;
+        ++m_size_;
+    }
+
+    void MihIndex::unlink(size_t b, quint32 slot)
+    {
+        const size_t bandCount = m_bands_.size();
+        auto it = m_bands_[b].heads.find(key(m_bands_[b], m_hashes_[slot]));
+        if (it == m_bands_[b].heads.end())
+            return;
+
+        quint32* link = &it->second;
+        while (*link != None && *link != slot)
+            link = &m_next_[*link * bandCount + b];
+        if (*link == None)
+            return;
+        *link = m_next_[slot * bandCount + b];
+        if (it->second == None)
+            m_bands_[b].heads.erase(it);
+    }
+
+    void MihIndex::remove(quint32 id)
+    {
+        if (id >= m_idHead_.size())
+            return;
+
+        quint32 slot = m_idHead_[id];
+        while (slot != None) {
+            for (size_t b = 0; b < m_bands_.size(); ++b)
+                unlink(b, slot);
+            const quint32 next = m_idNext_[slot];
+            m_idNext_[slot] = None;
+            m_free_.push_back(slot);
+            --m_size_;
+            slot = next;
+        }
+        m_idHead_[id] = None;
+    }
+
+    void MihIndex::clear()
+    {
+        for (Band& band : m_bands_)
+            band.heads.clear();
+        m_hashes_.clear();
+        m_ids_.clear();
+        m_next_.clear();
+        m_idNext_.clear();
+        m_idHead_.clear();
+        m_free_.clear();
+        m_size_ = 0;
+    }
+
+    void MihIndex::query(quint64 hash, std::vector<Match>& out) const
+    {
+        const size_t bandCount = m_bands_.size();
+
+        for (size_t b = 0; b < bandCount; ++b) {
+            const Band& band = m_bands_[b];
+            if (band.heads.empty())
+                continue;
+            const quint32 base = key(band, hash);
+
+            // Every substring within m_flips_ bits of base
+            mih::forEachNeighbour(base, band.width, m_flips_, [&](quint32 probe) {
+                auto it = band.heads.find(probe);
+                if (it == band.heads.end())
+                    return;
+                for (quint32 slot = it->second; slot != None; slot = m_next_[slot * bandCount + b]) {
+                    const quint64 stored = m_hashes_[slot];
+                    const int distance = std::popcount(stored ^ hash);
+                    if (distance > m_radius_)
+                        continue;
+
+                    // Reported already if an earlier band was also within reach
+                    bool seen = false;
+                    for (size_t e = 0; e < b && !seen; ++e) {
+                        const quint32 diff = key(m_bands_[e], stored) ^ key(m_bands_[e], hash);
+                        seen = std::popcount(diff) <= m_flips_;
+                    }
+                    if (!seen)
+                        out.push_back({ m_ids_[slot], distance });
+                }
+            });
+        }
+    }
+
+}
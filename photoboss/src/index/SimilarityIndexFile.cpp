@@ -0,0 +1,269 @@
+#include "index/SimilarityIndexFile.h"
+#include "index/MihBands.h"
+#include "hashing/Xxh3Kernel.h"
+#include <QDir>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace photoboss {
+
+    static constexpr quint32 NoImage = 0xFFFFFFFFu;
+
+    static quint64 alignUp(quint64 offset)
+    {
+        return (offset + 7) & ~quint64(7);
+    }
+
+    quint64 SimilarityIndexFile::pathKey(const QByteArray& utf8)
+    {
+        const ContentDigest digest = xxh3::digest128(
+            reinterpret_cast<const uchar*>(utf8.constData()), static_cast<size_t>(utf8.size()));
+        quint64 key;
+        std::memcpy(&key, digest.data(), sizeof(key));
+        return key;
+    }
+
+    QString SimilarityIndexFile::defaultPath(const QString& root)
+    {
+        const QString baseDir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+        QDir dir(baseDir);
+        if (!dir.exists())
+            dir.mkpath(".");
+        const quint64 key = pathKey(QDir::cleanPath(root).toUtf8());
+        return dir.filePath(QStringLiteral("similarity_%1.idx").arg(key, 16, 16, QLatin1Char('0')));
+    }
+
+    // ------------------------------------------------------------
+    // Reading
+    // ------------------------------------------------------------
+
+    std::unique_ptr<SimilarityIndexFile> SimilarityIndexFile::open(const QString& path, quint64 fingerprint)
+    {
+        std::unique_ptr<SimilarityIndexFile> file(new SimilarityIndexFile());
+        file->m_file_.setFileName(path);
+        if (!file->m_file_.open(QIODevice::ReadOnly))
+            return nullptr;
+
+        const quint64 size = static_cast<quint64>(file->m_file_.size());
+        if (size < sizeof(Header))
+            return nullptr;
+        file->m_data_ = file->m_file_.map(0, static_cast<qint64>(size));
+        if (!file->m_data_)
+            return nullptr;
+
+        const Header& h = file->header();
+        if (h.magic != Magic || h.version != Version || h.fingerprint != fingerprint || h.fileSize != size)
+            return nullptr;
+        if (h.radius < 0 || h.radius > 64 || h.bandCount < 2 || h.bandCount > 32)
+            return nullptr;
+
+        // Every section inside the file and aligned for its records; the
+        // records themselves are checked where they are read
+        const auto fits = [size](quint64 offset, quint64 count, quint64 record, quint64 align) {
+            return offset % align == 0 && offset <= size && count <= (size - offset) / record;
+        };
+        if (!fits(h.images, h.imageCount, sizeof(Image), alignof(Image))
+            || !fits(h.keys, h.imageCount, sizeof(Key), alignof(Key))
+            || !fits(h.clusters, h.clusterCount, sizeof(Cluster), alignof(Cluster))
+            || !fits(h.bands, static_cast<quint64>(h.bandCount), sizeof(BandTable), alignof(BandTable))
+            || !fits(h.paths, h.pathsSize, 1, 1))
+            return nullptr;
+        for (qint32 b = 0; b < h.bandCount; ++b) {
+            const BandTable& table = file->bands()[b];
+            if (!fits(table.entries, table.count, sizeof(BandEntry), alignof(BandEntry)))
+                return nullptr;
+        }
+        return file;
+    }
+
+    SimilarityIndexFile::~SimilarityIndexFile()
+    {
+        if (m_data_)
+            m_file_.unmap(const_cast<uchar*>(m_data_));
+    }
+
+    std::optional<quint32> SimilarityIndexFile::find(const QString& path) const
+    {
+        const QByteArray utf8 = path.toUtf8();
+        const quint64 key = pathKey(utf8);
+        const Key* begin = keys();
+        const Key* end = begin + imageCount();
+        const Key* it = std::lower_bound(begin, end, key, [](const Key& k, quint64 value) {
+            return k.key < value;
+        });
+
+        // Keys can collide; the stored path decides
+        const Header& h = header();
+        for (; it != end && it->key == key; ++it) {
+            if (it->image >= h.imageCount)
+                continue;
+            const Image& img = image(it->image);
+            if (img.cluster >= h.clusterCount || img.pathLength != static_cast<quint64>(utf8.size())
+                || img.path > h.pathsSize || img.pathLength > h.pathsSize - img.path)
+                continue;
+            if (std::memcmp(m_data_ + h.paths + img.path, utf8.constData(), img.pathLength) == 0)
+                return it->image;
+        }
+        return std::nullopt;
+    }
+
+    void SimilarityIndexFile::query(quint64 hash, std::vector<ICandidateIndex::Match>& out) const
+    {
+        const Header& h = header();
+        const auto split = mih::split(h.bandCount);
+        const int flips = h.radius / h.bandCount;
+
+        for (qint32 b = 0; b < h.bandCount; ++b) {
+            const BandTable& table = bands()[b];
+            const BandEntry* begin = at<BandEntry>(table.entries);
+            const BandEntry* end = begin + table.count;
+            if (begin == end)
+                continue;
+
+            mih::forEachNeighbour(split[b].key(hash), split[b].width, flips, [&](quint32 probe) {
+                const BandEntry* it = std::lower_bound(begin, end, probe, [](const BandEntry& e, quint32 value) {
+                    return e.key < value;
+                });
+                for (; it != end && it->key == probe; ++it) {
+                    const int distance = std::popcount(it->hash ^ hash);
+                    if (distance > h.radius || it->cluster >= h.clusterCount
+                        || representative(it->cluster) >= h.imageCount)
+                        continue;
+                    out.push_back({ it->cluster, distance });
+                }
+            });
+        }
+    }
+
+    // ------------------------------------------------------------
+    // Writing
+    // ------------------------------------------------------------
+
+    quint32 SimilarityIndexFile::Writer::addCluster()
+    {
+        m_representatives_.push_back(NoImage);
+        return static_cast<quint32>(m_representatives_.size() - 1);
+    }
+
+    quint32 SimilarityIndexFile::Writer::addImage(const QString& path, quint64 size, quint64 modifiedTime,
+        const HashDigest& digest, quint32 cluster)
+    {
+        const QByteArray utf8 = path.toUtf8();
+
+        // Zeroed first so padding is written as zeros, not leftovers
+        Image image;
+        std::memset(static_cast<void*>(&image), 0, sizeof(image));
+        std::memcpy(&image.digest, &digest, sizeof(digest));
+        image.size = size;
+        image.modifiedTime = modifiedTime;
+        image.path = static_cast<quint64>(m_paths_.size());
+        image.pathLength = static_cast<quint32>(utf8.size());
+        image.cluster = cluster;
+
+        m_paths_.append(utf8);
+        m_images_.push_back(image);
+        return static_cast<quint32>(m_images_.size() - 1);
+    }
+
+    void SimilarityIndexFile::Writer::setRepresentative(quint32 cluster, quint32 image)
+    {
+        m_representatives_[cluster] = image;
+    }
+
+    bool SimilarityIndexFile::Writer::save(const QString& path, quint64 fingerprint, int radius, int bands) const
+    {
+        // Path keys, and the band tables over every representative
+        std::vector<Key> keys(m_images_.size());
+        for (size_t i = 0; i < m_images_.size(); ++i) {
+            const Image& image = m_images_[i];
+            const QByteArray utf8 = m_paths_.mid(static_cast<qsizetype>(image.path), image.pathLength);
+            keys[i] = { pathKey(utf8), static_cast<quint32>(i), 0 };
+        }
+        std::sort(keys.begin(), keys.end(), [](const Key& a, const Key& b) {
+            return a.key != b.key ? a.key < b.key : a.image < b.image;
+        });
+
+        const auto split = mih::split(bands);
+        std::vector<std::vector<BandEntry>> entries(split.size());
+        std::vector<Cluster> clusters(m_representatives_.size());
+        for (size_t c = 0; c < m_representatives_.size(); ++c) {
+            const quint32 rep = m_representatives_[c];
+            clusters[c] = { rep, 0 };
+            if (rep == NoImage || !m_images_[rep].digest.has(HashKind::Perceptual))
+                continue;
+            const HashDigest& digest = m_images_[rep].digest;
+            const auto add = [&](quint64 hash) {
+                for (size_t b = 0; b < split.size(); ++b)
+                    entries[b].push_back({ hash, split[b].key(hash), static_cast<quint32>(c) });
+            };
+            add(digest.pHash);
+            if (digest.has(HashKind::PerceptualCanonical) && digest.pHashCanonical != digest.pHash)
+                add(digest.pHashCanonical);
+        }
+        for (auto& band : entries) {
+            std::sort(band.begin(), band.end(), [](const BandEntry& a, const BandEntry& b) {
+                return a.key != b.key ? a.key < b.key : a.cluster < b.cluster;
+            });
+        }
+
+        // Layout
+        Header h;
+        std::memset(&h, 0, sizeof(h));
+        h.magic = Magic;
+        h.version = Version;
+        h.fingerprint = fingerprint;
+        h.imageCount = static_cast<quint32>(m_images_.size());
+        h.clusterCount = static_cast<quint32>(clusters.size());
+        h.radius = radius;
+        h.bandCount = static_cast<qint32>(split.size());
+
+        quint64 offset = alignUp(sizeof(Header));
+        h.images = offset;
+        offset = alignUp(offset + m_images_.size() * sizeof(Image));
+        h.keys = offset;
+        offset = alignUp(offset + keys.size() * sizeof(Key));
+        h.clusters = offset;
+        offset = alignUp(offset + clusters.size() * sizeof(Cluster));
+        h.bands = offset;
+        offset = alignUp(offset + split.size() * sizeof(BandTable));
+        std::vector<BandTable> tables(split.size());
+        for (size_t b = 0; b < split.size(); ++b) {
+            tables[b] = { offset, entries[b].size() };
+            offset = alignUp(offset + entries[b].size() * sizeof(BandEntry));
+        }
+        h.paths = offset;
+        h.pathsSize = static_cast<quint64>(m_paths_.size());
+        h.fileSize = offset + h.pathsSize;
+
+        QSaveFile file(path);
+        if (!file.open(QIODevice::WriteOnly))
+            return false;
+
+        quint64 written = 0;
+        bool ok = true;
+        const auto put = [&](quint64 at, const void* data, quint64 size) {
+            static const char zeros[8] = {};
+            if (at > written) {
+                ok = ok && file.write(zeros, static_cast<qint64>(at - written)) == static_cast<qint64>(at - written);
+                written = at;
+            }
+            if (size > 0)
+                ok = ok && file.write(static_cast<const char*>(data), static_cast<qint64>(size)) == static_cast<qint64>(size);
+            written += size;
+        };
+        put(0, &h, sizeof(h));
+        put(h.images, m_images_.data(), m_images_.size() * sizeof(Image));
+        put(h.keys, keys.data(), keys.size() * sizeof(Key));
+        put(h.clusters, clusters.data(), clusters.size() * sizeof(Cluster));
+        put(h.bands, tables.data(), tables.size() * sizeof(BandTable));
+        for (size_t b = 0; b < split.size(); ++b)
+            put(tables[b].entries, entries[b].data(), entries[b].size() * sizeof(BandEntry));
+        put(h.paths, m_paths_.constData(), h.pathsSize);
+
+        return ok && written == h.fileSize && file.commit();
+    }
+
+}
@@ -0,0 +1,144 @@
+#include "index/VpTreeIndex.h"
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+namespace photoboss {
+
+    VpTreeIndex::VpTreeIndex(int radius)
+        : m_radius_(radius)
+    {
+        if (radius < 0 || radius > 64)
+            throw std::invalid_argument("VpTreeIndex: radius must be 0..64");
+    }
+
+    void VpTreeIndex::insert(quint32 id, quint64 hash)
+    {
+        const quint32 slot = m_slots_.add(id, hash);
+        m_leafNext_.push_back(None);
+        if (m_nodes_.empty())
+            m_nodes_.emplace_back();
+
+        quint32 cur = 0;
+        while (m_nodes_[cur].inside != None) {
+            const Node& node = m_nodes_[cur];
+            cur = std::popcount(hash ^ node.vantage) < node.mu ? node.inside : node.outside;
+        }
+
+        Node& leaf = m_nodes_[cur];
+        m_leafNext_[slot] = leaf.head;
+        leaf.head = slot;
+        if (++leaf.count >= leaf.splitAt)
+            split(cur);
+    }
+
+    void VpTreeIndex::split(quint32 leafIndex)
+    {
+        // Removed slots are dropped here rather than carried down
+        std::vector<quint32> members;
+        for (quint32 slot = m_nodes_[leafIndex].head; slot != None; slot = m_leafNext_[slot]) {
+            if (m_slots_.live(slot))
+                members.push_back(slot);
+        }
+
+        const quint64 vantage = members.empty() ? 0 : m_slots_.hash(members.front());
+        std::vector<int> distances;
+        distances.reserve(members.size());
+        for (quint32 slot : members)
+            distances.push_back(std::popcount(m_slots_.hash(slot) ^ vantage));
+
+        // Median as the boundary; if nothing lies below it, go one past so
+        // the median's ties go inside instead
+        std::vector<int> sorted = distances;
+        std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+        int mu = sorted.empty() ? 0 : sorted[sorted.size() / 2];
+        const auto below = std::count_if(distances.begin(), distances.end(), [mu](int d) { return d < mu; });
+        if (below == 0)
+            ++mu;
+        const auto inside = std::count_if(distances.begin(), distances.end(), [mu](int d) { return d < mu; });
+
+        if (inside == 0 || inside == static_cast<std::ptrdiff_t>(members.size())) {
+            // Equidistant (duplicates, mostly): keep the bucket whole and
+            // try again once it has doubled
+            Node& leaf = m_nodes_[leafIndex];
+            leaf.head = None;
+            for (quint32 slot : members) {
+                m_leafNext_[slot] = leaf.head;
+                leaf.head = slot;
+            }
+            leaf.count = static_cast<quint32>(members.size());
+            leaf.splitAt = std::max(LeafSize, leaf.count * 2);
+            return;
+        }
+
+        const auto insideIndex = static_cast<quint32>(m_nodes_.size());
+        m_nodes_.emplace_back();
+        m_nodes_.emplace_back();
+        for (size_t i = 0; i < members.size(); ++i) {
+            Node& child = m_nodes_[distances[i] < mu ? insideIndex : insideIndex + 1];
+            m_leafNext_[members[i]] = child.head;
+            child.head = members[i];
+            ++child.count;
+        }
+
+        Node& node = m_nodes_[leafIndex];
+        node.vantage = vantage;
+        node.mu = mu;
+        node.inside = insideIndex;
+        node.outside = insideIndex + 1;
+        node.head = None;
+        node.count = 0;
+    }
+
+    void VpTreeIndex::remove(quint32 id)
+    {
+        m_slots_.remove(id);
+        if (m_slots_.wantsCompaction())
+            compact();
+    }
+
+    void VpTreeIndex::clear()
+    {
+        m_slots_.clear();
+        m_leafNext_.clear();
+        m_nodes_.clear();
+    }
+
+    void VpTreeIndex::compact()
+    {
+        const auto live = m_slots_.takeLive();
+        clear();
+        for (const auto& [id, hash] : live)
+            insert(id, hash);
+    }
+
+    void VpTreeIndex::query(quint64 hash, std::vector<Match>& out) const
+    {
+        if (m_nodes_.empty())
+            return;
+
+        std::vector<quint32> stack{ 0 };
+        while (!stack.empty()) {
+            const Node& node = m_nodes_[stack.back()];
+            stack.pop_back();
+
+            if (node.inside == None) {
+                for (quint32 slot = node.head; slot != None; slot = m_leafNext_[slot]) {
+                    const int d = std::popcount(hash ^ m_slots_.hash(slot));
+                    if (d <= m_radius_ && m_slots_.live(slot))
+                        out.push_back({ m_slots_.id(slot), d });
+                }
+                continue;
+            }
+
+            // A hash within r of the query is within d - r .. d + r of the
+            // vantage point
+            const int d = std::popcount(hash ^ node.vantage);
+            if (d - m_radius_ < node.mu)
+                stack.push_back(node.inside);
+            if (d + m_radius_ >= node.mu)
+                stack.push_back(node.outside);
+        }
+    }
+
+}
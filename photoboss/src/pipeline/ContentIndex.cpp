@@ -0,0 +1,20 @@
+#include "pipeline/ContentIndex.h"
+
+#include <mutex>
+
+namespace photoboss {
+
+std::optional<ContentHashes> ContentIndex::find(const ContentDigest &content) const {
+    std::shared_lock lock(m_mutex_);
+    auto it = m_entries_.find(content);
+    if (it == m_entries_.end())
+        return std::nullopt;
+    return it->second;
+}
+
+void ContentIndex::insert(const ContentDigest &content, const ContentHashes &hashes) {
+    std::unique_lock lock(m_mutex_);
+    m_entries_.try_emplace(content, hashes);
+}
+
+} // namespace photoboss
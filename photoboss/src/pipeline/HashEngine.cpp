@@ -1,10 +1,14 @@
 #include "pipeline/HashEngine.h"
+#include "pipeline/stages/JpegDecoder.h"
 #include "util/ScopedTimer.h"
 #include <QDebug>
 
 namespace photoboss {
 
-HashEngine::HashEngine(std::vector<HashCatalog::Entry> methods) {
+HashEngine::HashEngine() = default;
+
+HashEngine::HashEngine(std::vector<HashCatalog::Entry> methods)
+    : m_runtimeMethods(true) {
     // Separate the methods by the type of input they require.
     for (auto &entry : methods) {
         if (entry.method->inputType() == HashInput::Bytes) {
@@ -17,50 +21,299 @@ HashEngine::HashEngine(std::vector<HashCatalog::Entry> methods) {
 
 std::shared_ptr<HashedImageResult>
 HashEngine::compute(const DiskReadResult &item, const std::optional<QImage> &image) const {
+    std::vector<std::optional<QImage>> images{ image };
+    return computeBatch({ &item }, images).front();
+}
+
+std::vector<std::shared_ptr<HashedImageResult>>
+HashEngine::computeBatch(const std::vector<const DiskReadResult*> &items,
+                         const std::vector<std::optional<QImage>> &images) const {
+    auto results = computeContentBatch(items);
+
+    std::vector<HashedImageResult*> pending;
+    pending.reserve(results.size());
+    for (const auto &result : results)
+        pending.push_back(result.get());
+    computeImages(pending, images);
+
+    return results;
+}
+
+std::shared_ptr<HashedImageResult>
+HashEngine::computeContent(const DiskReadResult &item) const {
+    return computeContentBatch({ &item }).front();
+}
+
+std::vector<std::shared_ptr<HashedImageResult>>
+HashEngine::computeContentBatch(const std::vector<const DiskReadResult*> &items) const {
     SCOPED_TIMER("HashEngine");
 
-    // Initialise the result object – matches the legacy HashWorker constructor.
-    auto result = std::make_shared<HashedImageResult>(
-        item.fileIdentity,
-        HashSource::Fresh,
-        QDateTime::currentDateTimeUtc(),
-        image ? image->size() : QSize{0,0},
-        std::map<QString, QString>{},
-        image
-    );
+    std::vector<std::shared_ptr<HashedImageResult>> results;
+    std::vector<const QByteArray*> data;
+    std::vector<HashDigest*> digests;
+    results.reserve(items.size());
+    data.reserve(items.size());
+    digests.reserve(items.size());
+
+    for (const DiskReadResult *item : items) {
+        // Initialise the result object – matches the legacy HashWorker constructor.
+        results.push_back(std::make_shared<HashedImageResult>(
+            item->fileIdentity,
+            HashSource::Fresh,
+            QDateTime::currentDateTimeUtc(),
+            QSize{0,0},
+            HashDigest{}
+        ));
+        results.back()->quality.jpegQuality = JpegDecoder::estimateQuality(item->imageBytes);
+        data.push_back(&item->imageBytes);
+        digests.push_back(&results.back()->digest);
+    }
 
     // ---------- Byte‑based hash methods ----------
-    for (const auto &entry : m_byteMethods) {
-        try {
-            result->hashes.emplace(entry.method->key(), entry.method->compute(item.imageBytes));
-        } catch (const std::exception &e) {
-            qDebug() << "HashEngine byte hash error:" << e.what();
-            result->hashes.emplace(entry.method->key(), e.what());
+    if (!hashBytes(data, digests)) {
+        for (auto &result : results)
             result->source = HashSource::Error;
+    }
+    return results;
+}
+
+void HashEngine::computeImages(const std::vector<HashedImageResult*> &results,
+                               const std::vector<std::optional<QImage>> &images) const {
+    SCOPED_TIMER("HashEngine");
+
+    // Decoded images are prepared once and shared by every image method.
+    std::vector<PerceptualImage> perceptual;
+    std::vector<const PerceptualImage*> batch;
+    std::vector<HashDigest*> digests;
+    std::vector<size_t> batchIndex;   // batch slot -> result index
+    perceptual.reserve(results.size());
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        HashedImageResult &result = *results[i];
+        const std::optional<QImage> &image = images[i];
+
+        if (image) {
+            result.resolution = image->size();
+            result.decodedImage = image;
+            perceptual.emplace_back(*image);
+            batchIndex.push_back(i);
+        } else {
+            // No usable image – mark image‑based hashes as errors.
+            markImageHashesFailed(result.digest);
+            result.source = HashSource::Error;
         }
     }
 
     // ---------- Image‑based hash methods ----------
-    if (image) {
-        // image is valid – run each image‑hash method.
-        for (const auto &entry : m_imageMethods) {
+    if (perceptual.empty())
+        return;
+
+    batch.reserve(perceptual.size());
+    digests.reserve(perceptual.size());
+    for (size_t b = 0; b < perceptual.size(); ++b) {
+        batch.push_back(&perceptual[b]);
+        digests.push_back(&results[batchIndex[b]]->digest);
+
+        HashedImageResult &result = *results[batchIndex[b]];
+        result.plane = perceptual[b].plane();
+        result.quality.sharpness = static_cast<float>(perceptual[b].stats().sharpness);
+        result.quality.clipped = static_cast<float>(perceptual[b].stats().clipped);
+    }
+
+    if (!hashImages(batch, digests)) {
+        for (size_t index : batchIndex)
+            results[index]->source = HashSource::Error;
+    }
+}
+
+bool HashEngine::reuseImageHashes(HashedImageResult &result, const ContentHashes &known) const {
+    const quint8 kinds = imageKinds();
+    if ((known.digest.present & kinds) != kinds)
+        return false;
+
+    // Lazy hashes too, where known already has them
+    const quint8 copied = known.digest.present & (kinds | lazyKinds());
+    for (int k = 0; k < HashKindCount; ++k) {
+        const auto kind = static_cast<HashKind>(k);
+        if (copied & HashDigest::bit(kind))
+            result.digest.copyValue(kind, known.digest);
+    }
+    result.resolution = known.resolution;
+    result.plane = known.plane;
+    result.quality = known.quality;
+    return true;
+}
+
+void HashEngine::hashPlanes(const std::vector<const QByteArray*> &planes,
+                            const std::vector<HashDigest*> &digests) const {
+    SCOPED_TIMER("HashEngine");
+
+    std::vector<PerceptualImage> perceptual;
+    std::vector<const PerceptualImage*> batch;
+    std::vector<HashDigest*> targets;
+    perceptual.reserve(planes.size());
+
+    for (size_t i = 0; i < planes.size(); ++i) {
+        if (planes[i]->size() != PerceptualImage::PlaneSize)
+            continue;
+        perceptual.push_back(PerceptualImage::fromPlane(*planes[i]));
+        targets.push_back(digests[i]);
+    }
+    if (perceptual.empty())
+        return;
+
+    batch.reserve(perceptual.size());
+    for (const PerceptualImage &image : perceptual)
+        batch.push_back(&image);
+    hashImages(batch, targets, true);
+}
+
+void HashEngine::completeLazy(HashedImageResult &result) const {
+    completeLazy(result.digest, result.plane);
+}
+
+void HashEngine::completeLazy(HashDigest &digest, const QByteArray &plane) const {
+    const quint8 kinds = lazyKinds();
+    if (((digest.present | digest.failed) & kinds) == kinds)
+        return;
+
+    if (plane.size() != PerceptualImage::PlaneSize) {
+        digest.markAllFailed(kinds & ~digest.present);
+        return;
+    }
+
+    const PerceptualImage image = PerceptualImage::fromPlane(plane);
+    Methods::forEach([&]<typename Method>() {
+        if constexpr (Method::Input == HashInput::Image && registry::lazy<Method>()) {
+            if (digest.has(Method::Kind))
+                return;
+            try {
+                Method::hash(image, digest);
+            } catch (const std::exception &e) {
+                qDebug() << "HashEngine lazy hash error:" << e.what();
+                digest.markAllFailed(registry::produces<Method>());
+            }
+        }
+    });
+}
+
+quint8 HashEngine::lazyKinds() const {
+    if (m_runtimeMethods)
+        return 0;
+
+    quint8 kinds = 0;
+    Methods::forEach([&]<typename Method>() {
+        if constexpr (Method::Input == HashInput::Image && registry::lazy<Method>())
+            kinds |= registry::produces<Method>();
+    });
+    return kinds;
+}
+
+quint8 HashEngine::imageKinds() const {
+    quint8 kinds = 0;
+    if (m_runtimeMethods) {
+        for (const auto &entry : m_imageMethods)
+            kinds |= entry.method->produces();
+        return kinds;
+    }
+
+    Methods::forEach([&]<typename Method>() {
+        if constexpr (Method::Input == HashInput::Image && !registry::lazy<Method>())
+            kinds |= registry::produces<Method>();
+    });
+    return kinds;
+}
+
+bool HashEngine::hashBytes(const std::vector<const QByteArray*> &data,
+                           const std::vector<HashDigest*> &digests) const {
+    bool ok = true;
+    const auto fail = [&](quint8 kinds, const std::exception &e) {
+        qDebug() << "HashEngine byte hash error:" << e.what();
+        for (HashDigest *digest : digests)
+            digest->markAllFailed(kinds);
+        ok = false;
+    };
+
+    if (m_runtimeMethods) {
+        for (const auto &entry : m_byteMethods) {
             try {
-                result->hashes.emplace(entry.method->key(), entry.method->compute(PerceptualImage(*image)));
+                entry.method->computeBatch(data, digests);
             } catch (const std::exception &e) {
-                qDebug() << "HashEngine image hash error:" << e.what();
-                result->hashes.emplace(entry.method->key(), e.what());
-                result->source = HashSource::Error;
+                fail(entry.method->produces(), e);
             }
         }
-    } else {
-        // No usable image – mark image‑based hashes as errors.
+        return ok;
+    }
+
+    Methods::forEach([&]<typename Method>() {
+        if constexpr (Method::Input == HashInput::Bytes) {
+            try {
+                if constexpr (requires { Method::hashBatch(data, digests); }) {
+                    Method::hashBatch(data, digests);
+                } else {
+                    for (size_t i = 0; i < data.size(); ++i)
+                        Method::hash(*data[i], *digests[i]);
+                }
+            } catch (const std::exception &e) {
+                fail(registry::produces<Method>(), e);
+            }
+        }
+    });
+    return ok;
+}
+
+bool HashEngine::hashImages(const std::vector<const PerceptualImage*> &images,
+                            const std::vector<HashDigest*> &digests,
+                            bool withLazy) const {
+    bool ok = true;
+    const auto fail = [&](quint8 kinds, const std::exception &e) {
+        qDebug() << "HashEngine image hash error:" << e.what();
+        for (HashDigest *digest : digests)
+            digest->markAllFailed(kinds);
+        ok = false;
+    };
+
+    if (m_runtimeMethods) {
         for (const auto &entry : m_imageMethods) {
-            result->hashes.emplace(entry.method->key(), QStringLiteral("decode_failed"));
-            result->source = HashSource::Error;
+            try {
+                entry.method->computeBatch(images, digests);
+            } catch (const std::exception &e) {
+                fail(entry.method->produces(), e);
+            }
         }
+        return ok;
+    }
+
+    Methods::forEach([&]<typename Method>() {
+        if constexpr (Method::Input == HashInput::Image) {
+            if (registry::lazy<Method>() && !withLazy)
+                return;
+            try {
+                if constexpr (requires { Method::hashBatch(images, digests); }) {
+                    Method::hashBatch(images, digests);
+                } else {
+                    for (size_t i = 0; i < images.size(); ++i)
+                        Method::hash(*images[i], *digests[i]);
+                }
+            } catch (const std::exception &e) {
+                fail(registry::produces<Method>(), e);
+            }
+        }
+    });
+    return ok;
+}
+
+void HashEngine::markImageHashesFailed(HashDigest &digest) const {
+    if (m_runtimeMethods) {
+        for (const auto &entry : m_imageMethods)
+            digest.markAllFailed(entry.method->produces());
+        return;
     }
 
-    return result;
+    Methods::forEach([&]<typename Method>() {
+        if constexpr (Method::Input == HashInput::Image && !registry::lazy<Method>())
+            digest.markAllFailed(registry::produces<Method>());
+    });
 }
 
 } // namespace photoboss
@@ -0,0 +1,173 @@
+#include "pipeline/ImageStore.h"
+#include "hashing/PerceptualImage.h"
+#include "util/AppSettings.h"
+#include <algorithm>
+#include <cstring>
+
+namespace photoboss {
+
+    static constexpr qsizetype PlaneBytes = PerceptualImage::PlaneSize;
+
+    ImageStore::Id ImageStore::add(const HashedImageResult& result)
+    {
+        const FileIdentity& file = result.fileIdentity;
+        const auto id = static_cast<Id>(m_digests_.size());
+
+        m_digests_.push_back(result.digest);
+        m_resolutions_.push_back(result.resolution);
+        m_fileSizes_.push_back(file.size());
+        m_modifiedTimes_.push_back(file.modifiedTime());
+        m_scores_.push_back(score(result));
+        m_qualityFactors_.push_back(result.quality.measured() ? qualityFactor(result.quality) : -1.0);
+        m_rotations_.push_back(static_cast<quint8>(file.exif().orientation.value_or(1)));
+
+        m_directories_.push_back(intern(file.path()));
+        m_formats_.push_back(intern(file.extension()));
+        m_nameOffsets_.push_back(static_cast<quint32>(m_names_.size()));
+        m_names_.append(file.name());
+
+        quint32 slot = NoPlane;
+        if (result.plane.size() == PlaneBytes) {
+            if (!m_freePlanes_.empty()) {
+                slot = m_freePlanes_.back();
+                m_freePlanes_.pop_back();
+            } else {
+                slot = m_planeCount_++;
+                if (slot / PlanesPerChunk == m_planeChunks_.size())
+                    m_planeChunks_.push_back(std::make_unique<char[]>(PlanesPerChunk * PlaneBytes));
+            }
+            std::memcpy(planeAt(slot), result.plane.constData(), PlaneBytes);
+        }
+        m_planeSlots_.push_back(slot);
+        return id;
+    }
+
+    void ImageStore::clear()
+    {
+        *this = ImageStore();
+    }
+
+    quint32 ImageStore::intern(const QString& value)
+    {
+        const auto it = m_stringIds_.constFind(value);
+        if (it != m_stringIds_.constEnd())
+            return it.value();
+        const auto id = static_cast<quint32>(m_strings_.size());
+        m_strings_.push_back(value);
+        m_stringIds_.insert(value, id);
+        return id;
+    }
+
+    char* ImageStore::planeAt(quint32 slot) const
+    {
+        return m_planeChunks_[slot / PlanesPerChunk].get() + (slot % PlanesPerChunk) * PlaneBytes;
+    }
+
+    QByteArray ImageStore::plane(Id id) const
+    {
+        const quint32 slot = m_planeSlots_[id];
+        if (slot == NoPlane)
+            return {};
+        return QByteArray::fromRawData(planeAt(slot), PlaneBytes);
+    }
+
+    void ImageStore::releasePlane(Id id)
+    {
+        quint32& slot = m_planeSlots_[id];
+        if (slot == NoPlane)
+            return;
+        m_freePlanes_.push_back(slot);
+        slot = NoPlane;
+    }
+
+    QString ImageStore::path(Id id) const
+    {
+        const quint32 begin = m_nameOffsets_[id];
+        const quint32 end = id + 1 < m_nameOffsets_.size()
+            ? m_nameOffsets_[id + 1] : static_cast<quint32>(m_names_.size());
+        return m_strings_[m_directories_[id]] + "/" + m_names_.mid(begin, end - begin);
+    }
+
+    ImageEntry ImageStore::entry(Id id) const
+    {
+        ImageEntry e;
+        e.path = path(id);
+        e.fileSize = m_fileSizes_[id];
+        e.lastModified = m_modifiedTimes_[id];
+        e.resolution = m_resolutions_[id];
+        e.format = m_strings_[m_formats_[id]];
+        e.isBest = false;
+        e.rotation = m_rotations_[id];
+        return e;
+    }
+
+    size_t ImageStore::memoryUsage() const
+    {
+        const auto bytes = [](const auto& column) {
+            return column.capacity() * sizeof(column[0]);
+        };
+        size_t total = bytes(m_digests_) + bytes(m_resolutions_) + bytes(m_fileSizes_)
+            + bytes(m_modifiedTimes_) + bytes(m_scores_) + bytes(m_qualityFactors_)
+            + bytes(m_rotations_) + bytes(m_directories_) + bytes(m_formats_)
+            + bytes(m_nameOffsets_) + bytes(m_planeSlots_) + bytes(m_freePlanes_)
+            + bytes(m_planeChunks_) + bytes(m_strings_)
+            + m_planeChunks_.size() * PlanesPerChunk * PlaneBytes;
+        total += static_cast<size_t>(m_names_.capacity()) * sizeof(QChar);
+        for (const QString& s : m_strings_)
+            total += static_cast<size_t>(s.capacity()) * sizeof(QChar);
+        return total;
+    }
+
+    // ------------------------------------------------------------
+    // Representative selection
+    // ------------------------------------------------------------
+
+    bool ImageStore::better(Id a, Id b) const
+    {
+        // Quality only compares like with like: copies cached before it was
+        // measured fall back to the plain score against each other and
+        // against measured ones
+        const double qa = m_qualityFactors_[a];
+        const double qb = m_qualityFactors_[b];
+        if (qa >= 0.0 && qb >= 0.0)
+            return m_scores_[a] * qa > m_scores_[b] * qb;
+        return m_scores_[a] > m_scores_[b];
+    }
+
+    double ImageStore::score(const HashedImageResult& result)
+    {
+        const double pixels =
+            static_cast<double>(result.resolution.width()) *
+            static_cast<double>(result.resolution.height());
+
+        double score = pixels;
+
+        score += result.fileIdentity.size() * 0.001;
+
+        const QString ext = result.fileIdentity.extension().toLower();
+        if (ext == "png") score *= 1.05;
+
+        if (result.fileIdentity.exif().dateTimeOriginal)
+            score *= 1.02;
+
+        return score;
+    }
+
+    double ImageStore::qualityFactor(const ImageQuality& quality)
+    {
+        // Each cue can at most halve the score, so a sharp, well exposed
+        // copy beats a larger soft or blown-out one but resolution still
+        // decides between comparable copies
+        const double sharpness = quality.sharpness /
+            (quality.sharpness + settings::QualitySharpnessKnee);
+        double factor = 0.5 + 0.5 * sharpness;
+
+        factor *= 1.0 - 0.5 * std::clamp(static_cast<double>(quality.clipped), 0.0, 1.0);
+
+        if (quality.jpegQuality > 0)
+            factor *= 0.5 + 0.5 * quality.jpegQuality / 100.0;
+
+        return factor;
+    }
+
+}
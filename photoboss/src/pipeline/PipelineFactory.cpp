@@ -2,12 +2,14 @@
 #include "pipeline/stages/FileEnumerator.h"
 #include "pipeline/stages/DiskReader.h"
 #include "pipeline/stages/HashWorker.h"
+#include "pipeline/ContentIndex.h"
 #include "pipeline/stages/ResultProcessor.h"
 #include "pipeline/stages/CacheLookup.h"
 #include "pipeline/stages/CacheStore.h"
 #include "pipeline/stages/ThumbnailGenerator.h"
 #include "pipeline/StageBase.h"
 #include "caching/SqliteHashCache.h"
+#include "index/SimilarityIndexFile.h"
 #include "util/AppSettings.h"
 #include "pipeline/Pipeline.h"
 #include "ui/IUiUpdateSink.h"
@@ -29,7 +31,7 @@ namespace photoboss {
         auto pipeline = std::make_unique<Pipeline>();
         
         auto identityQueue = std::make_unique<Queue<FileIdentity>>();
-        auto disk = std::make_unique<Queue<FileIdentity>>();
+        auto disk = std::make_unique<Queue<DiskReadRequest>>();
         auto resultQueue = std::make_unique<Queue<std::shared_ptr<HashedImageResult>>>();
         auto readQueue = std::make_unique<Queue<std::unique_ptr<DiskReadResult>>>(settings::ReadQueueCapacity);
         auto cacheStoreQueue = std::make_unique<Queue<std::shared_ptr<HashedImageResult>>>();
@@ -37,7 +39,7 @@ namespace photoboss {
 
         // Get raw pointers for stages (ownership transferred to pipeline later)
         Queue<FileIdentity>* identityQueuePtr = identityQueue.get();
-        Queue<FileIdentity>* diskPtr = disk.get();
+        Queue<DiskReadRequest>* diskPtr = disk.get();
         Queue<std::shared_ptr<HashedImageResult>>* resultQueuePtr = resultQueue.get();
         Queue<std::unique_ptr<DiskReadResult>>* readQueuePtr = readQueue.get();
         Queue<std::shared_ptr<HashedImageResult>>* cacheStoreQueuePtr = cacheStoreQueue.get();
@@ -52,6 +54,7 @@ namespace photoboss {
             *identityQueuePtr,
             *diskPtr,
             *resultQueuePtr,
+            *cacheStoreQueuePtr,
 			pipeline->scanId()
         );
 
@@ -69,7 +72,10 @@ namespace photoboss {
 
         ResultProcessor* resultProcessor = new ResultProcessor(
             *resultQueuePtr,
-            *thumbnailQueuePtr
+            *thumbnailQueuePtr,
+            config.request.batchGrouping,
+            std::max(1, QThread::idealThreadCount() / 2),
+            SimilarityIndexFile::defaultPath(config.request.directory)
         );
 
         CacheStore* cacheStore = new CacheStore(
@@ -82,11 +88,16 @@ namespace photoboss {
             ? std::max(1, QThread::idealThreadCount() - 1)
             : 1;
         
+        // Shared so a file copied across paths is decoded by one worker only
+        auto contentIndex = std::make_shared<ContentIndex>();
+
 		std::vector<HashWorker*> hashWorkers;
         for (int i = 0; i < workers; ++i) {
             HashWorker* worker = new HashWorker(
                 *readQueuePtr,
-                *cacheStoreQueuePtr
+                *cacheStoreQueuePtr,
+                contentIndex,
+                pipeline->scanId()
             );
 			hashWorkers.push_back(worker);
 			QThread* thread = new QThread();
@@ -145,8 +156,14 @@ namespace photoboss {
                 &ResultProcessor::groupAdded,
                 [sink](const ImageGroup& group) { sink->addPendingGroup(group); });
             QObject::connect(resultProcessor,
-                &ResultProcessor::groupUpdated,
-                [sink](const ImageGroup& group) { sink->updateGroup(group); });
+                &ResultProcessor::groupGrown,
+                [sink](const GroupGrowth& growth) { sink->growGroup(growth); });
+            QObject::connect(resultProcessor,
+                &ResultProcessor::groupMerged,
+                [sink](const GroupMerge& merge) { sink->mergeGroup(merge); });
+            QObject::connect(resultProcessor,
+                &ResultProcessor::failuresFound,
+                [sink](const FailureSummary& failures) { sink->setFailures(failures); });
 
             // Thumbnail ready (for immediate thumbnail display)
             for (auto* worker : thumbnailWorkers) {
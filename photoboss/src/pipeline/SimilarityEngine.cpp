@@ -1,16 +1,38 @@
 #include "pipeline/SimilarityEngine.h"
 #include "hashing/HashCatalog.h"
+#include "hashing/Xxh3Kernel.h"
+#include "util/ConcurrentUnionFind.h"
+#include "util/ParallelFor.h"
 #include <algorithm>
-#include <array>
+#include <bit>
+#include <cmath>
+#include <cstring>
 #include <unordered_map>
 #include <unordered_set>
 
 namespace photoboss {
 
+    // Hamming radius a similarity gate admits on a 64-bit hash
+    static int gateRadius(double gate)
+    {
+        return static_cast<int>(std::floor((1.0 - gate) * 64.0 + 1e-9));
+    }
+
+    static QString fullPath(const HashedImageResult& result)
+    {
+        return result.fileIdentity.path() + "/" + result.fileIdentity.name();
+    }
+
     SimilarityEngine::SimilarityEngine(Config cfg)
         : m_cfg_(cfg)
     {
-        initHashes();
+        const int pHashRadius = std::max(m_cfg_.indexRadius, gateRadius(m_cfg_.pHashGate));
+        m_pHashIndex_ = ICandidateIndex::create(m_cfg_.index, pHashRadius, m_cfg_.indexBands);
+        m_cropGlobalIndex_ = ICandidateIndex::create(m_cfg_.index, gateRadius(m_cfg_.cropGate), m_cfg_.indexBands);
+        m_cropWindowIndex_ = ICandidateIndex::create(m_cfg_.index, gateRadius(m_cfg_.cropGate), m_cfg_.indexBands);
+
+        if (m_cfg_.runtimeMethods)
+            initHashes();
     }
 
     void SimilarityEngine::initHashes()
@@ -18,217 +40,874 @@ namespace photoboss {
         auto all = HashCatalog::createAll();
 
         for (auto& h : all) {
-            const QString& key = h.method->key();
-
-            if (key == "Perceptual Hash")
+            switch (h.method->kind()) {
+            case HashKind::Perceptual:
                 m_hashes_.push_back({ std::move(h.method), m_cfg_.pHashWeight });
-            else if (key == "Difference Hash")
+                break;
+            case HashKind::Difference:
                 m_hashes_.push_back({ std::move(h.method), m_cfg_.dHashWeight });
-            else if (key == "Average Hash")
+                break;
+            case HashKind::Average:
                 m_hashes_.push_back({ std::move(h.method), m_cfg_.aHashWeight });
-            else if (key == "Aspect Ratio")
-                m_hashes_.push_back({ std::move(h.method), m_cfg_.ratioWeight });
+                break;
+            case HashKind::Content:
+                break;  // exact matches are grouped by ExactGroup
+            case HashKind::PerceptualCanonical:
+                break;  // written by PerceptualHash, see rotatedConfidence()
+            case HashKind::Pyramid:
+                break;  // crops only, see findCropCluster()
+            }
         }
     }
 
-    std::array<quint16, 4> SimilarityEngine::extractSubHashes(
-        const QString& phashHex)
-    {
-        quint64 h = phashHex.toULongLong(nullptr, 16);
-        return {{
-            static_cast<quint16>(h & 0xFFFF),
-            static_cast<quint16>((h >> 16) & 0xFFFF),
-            static_cast<quint16>((h >> 32) & 0xFFFF),
-            static_cast<quint16>((h >> 48) & 0xFFFF)
-        }};
-    }
-
     void SimilarityEngine::addImage(const std::shared_ptr<HashedImageResult>& img)
     {
-        if (!img || !img->hashes.count("SHA256")) {
+        if (!img || !img->digest.has(HashKind::Content)) {
             return;
         }
 
-        m_nodes_.push_back({img.get(), img->resolution, img->fileIdentity.size()});
-        ImageNode* node = &m_nodes_.back();
+        // Concurrent callers score against shared representatives, so
+        // nothing may fill in their hashes then: each image completes its
+        // own before it becomes visible
+        if (m_cfg_.concurrent)
+            m_hashEngine_.completeLazy(*img);
+
+        // A file the previous scan indexed goes back to its stored cluster
+        // with no probe, unless it changed since
+        std::optional<quint32> storedImage;
+        bool unchanged = false;
+        if (m_stored_) {
+            storedImage = m_stored_->find(fullPath(*img));
+            if (storedImage) {
+                const auto& record = m_stored_->image(*storedImage);
+                unchanged = record.size == img->fileIdentity.size()
+                    && record.modifiedTime == img->fileIdentity.modifiedTime()
+                    && record.digest.content == img->digest.content;
+            }
+        }
+
+        // Probe under the shared lock: the costly part, run by every caller
+        // at once
+        const ContentDigest& sha = img->digest.content;
+        const Hashes imgHashes = hashes(*img);
+        std::vector<size_t> targets;
+        std::vector<quint32> storedTargets;
+        if (unchanged)
+            storedTargets.push_back(m_stored_->image(*storedImage).cluster);
+        size_t seen = 0;
+        {
+            std::shared_lock lock(m_mutex_);
+            if (!m_exactGroups_.contains(sha) && !unchanged)
+                targets = findClusters(imgHashes, storedTargets);
+            seen = m_changeLogBase_ + m_changeLog_.size();
+            m_probing_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        std::unique_lock lock(m_mutex_);
+
+        // A changed file no longer represents its stored cluster
+        if (storedImage && !unchanged) {
+            const quint32 sc = m_stored_->image(*storedImage).cluster;
+            if (m_stored_->representative(sc) == *storedImage)
+                m_storedStale_[sc] = 1;
+        }
 
-        const QString& sha = img->hashes.at("SHA256");
+        // A copy may have arrived between the probe and here
         auto it = m_exactGroups_.find(sha);
+        if (it != m_exactGroups_.end()) {
+            endProbe();
+            addExactCopy(it->second, m_store_.add(*img));
+            for (quint32 sc : storedTargets) {
+                if (m_storedLive_[sc] == Unclaimed)
+                    m_storedLive_[sc] = static_cast<quint32>(it->second.cluster);
+            }
+            return;
+        }
+
+        // Probed clusters may have been merged into others since, and
+        // stored clusters another image already brought in count as theirs
+        std::vector<quint32> unclaimed;
+        for (quint32 sc : storedTargets) {
+            if (m_storedLive_[sc] == Unclaimed)
+                unclaimed.push_back(sc);
+            else
+                targets.push_back(m_storedLive_[sc]);
+        }
+        for (size_t& ci : targets)
+            ci = m_clusterSets_.find(static_cast<quint32>(ci));
+        std::sort(targets.begin(), targets.end());
+        targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+
+        // Merge step: clusters other callers created or re-represented
+        // after the probe, which it could not see
+        if (!unchanged) {
+            const auto changed = findChangedClusters(imgHashes, seen, targets);
+            targets.insert(targets.end(), changed.begin(), changed.end());
+        }
+        endProbe();
+
+        // Stored once the merge step has filled in what lazy hashes it needed
+        const ImageId node = m_store_.add(*img);
+        ExactGroup eg;
+        eg.sha = sha;
+        eg.images.push_back(node);
+        eg.representative = node;
+
+        if (!targets.empty()) {
+            // The image bridges every cluster it matched: they become one
+            size_t ci = targets.front();
+            for (size_t i = 1; i < targets.size(); ++i)
+                ci = mergeClusters(ci, targets[i]);
+            joinCluster(ci, node);
+            eg.cluster = ci;
+        } else {
+            SimilarityGroup c;
+            c.id = m_nextGroupId_++;
+            c.representative = node;
+            c.members.push_back(node);
+            m_clusters_.push_back(std::move(c));
+            m_clusterSets_.add();
+            m_dirtyClusterIndices_.insert(m_clusters_.size() - 1);
+            eg.cluster = m_clusters_.size() - 1;
+
+            // Add new cluster to the inverted indexes
+            indexCluster(m_store_.digest(node), m_clusters_.size() - 1);
+        }
+        for (quint32 sc : unclaimed)
+            m_storedLive_[sc] = static_cast<quint32>(eg.cluster);
+
+        m_exactGroups_.insert({sha, std::move(eg)});
+    }
+
+    std::vector<size_t> SimilarityEngine::findClusters(const Hashes& img, std::vector<quint32>& stored)
+    {
+        const bool hasPHash = img.digest.has(HashKind::Perceptual);
+        const auto direct = directGates(img.digest);
+        const auto rotated = rotatedGates(img.digest);
+        std::vector<size_t> found;
+
+        // Lazy hashes a comparison filled in, gated on next time
+        const auto scored = [&](size_t ci) {
+            if (!m_cfg_.concurrent)
+                m_repColumns_.set(static_cast<quint32>(ci), m_store_.digest(m_clusters_[ci].representative));
+        };
+
+        // Every representative within the index radius of the pHash or
+        // the canonical pHash. Absorbed clusters are no longer indexed.
+        if (hasPHash && m_pHashIndex_->size() > 0) {
+            std::vector<ICandidateIndex::Match> matches;
+            m_pHashIndex_->query(img.digest.pHash, matches);
+            if (img.digest.has(HashKind::PerceptualCanonical))
+                m_pHashIndex_->query(img.digest.pHashCanonical, matches);
+
+            // Gate in the column store first; confidence() only for
+            // candidates that can clear its hard gates
+            std::unordered_set<quint32> tried;
+            for (const auto& match : matches) {
+                if (match.id >= m_clusters_.size() || !tried.insert(match.id).second)
+                    continue;
+                if (!m_repColumns_.passes(match.id, direct)
+                    && (rotated.empty() || !m_repColumns_.passes(match.id, rotated)))
+                    continue;
+                const double sim = confidence(img, repHashes(match.id));
+                scored(match.id);
+                if (sim >= m_cfg_.strongThreshold)
+                    found.push_back(match.id);
+            }
+        }
+
+        // The previous scan's representatives, on their stored digests.
+        // A stored cluster already brought in may have another
+        // representative here by now; both are tried.
+        if (hasPHash && m_stored_) {
+            std::vector<ICandidateIndex::Match> matches;
+            m_stored_->query(img.digest.pHash, matches);
+            if (img.digest.has(HashKind::PerceptualCanonical))
+                m_stored_->query(img.digest.pHashCanonical, matches);
+
+            std::unordered_set<quint32> tried;
+            for (const auto& match : matches) {
+                if (!tried.insert(match.id).second || m_storedStale_[match.id])
+                    continue;
+                const auto& rep = m_stored_->image(m_stored_->representative(match.id));
+                if (storedConfidence(img, rep.digest) >= m_cfg_.strongThreshold)
+                    stored.push_back(match.id);
+            }
+        }
+
+        // Fallback: scan all clusters only when pHash is missing,
+        // gated a block of representatives at a time
+        if (!hasPHash && !m_clusters_.empty()) {
+            std::vector<quint64> masks;
+            m_repColumns_.filter(direct, masks);
+            for (size_t b = 0; b < masks.size(); ++b) {
+                for (quint64 bits = masks[b]; bits; bits &= bits - 1) {
+                    const size_t ci = b * hamming::BlockSize + std::countr_zero(bits);
+                    if (m_clusters_[ci].absorbed())
+                        continue;
+                    const double sim = confidence(img, repHashes(ci));
+                    scored(ci);
+                    if (sim >= m_cfg_.strongThreshold)
+                        found.push_back(ci);
+                }
+            }
+        }
+
+        // Stored representatives have no plane to confirm a crop against
+        if (found.empty() && stored.empty() && m_cfg_.matchCrops && img.digest.has(HashKind::Pyramid)) {
+            if (const auto crop = findCropCluster(img))
+                found.push_back(*crop);
+        }
+        return found;
+    }
+
+    std::vector<size_t> SimilarityEngine::findChangedClusters(const Hashes& img, size_t seen,
+        const std::vector<size_t>& known)
+    {
+        // The log cannot have been emptied past `seen`: this caller's
+        // probe is still open
+        if (seen >= m_changeLogBase_ + m_changeLog_.size())
+            return {};
+
+        // Logged clusters absorbed since stand for the cluster that took them
+        std::vector<size_t> changed;
+        for (size_t i = seen - m_changeLogBase_; i < m_changeLog_.size(); ++i) {
+            const size_t ci = m_clusterSets_.find(m_changeLog_[i]);
+            if (!std::binary_search(known.begin(), known.end(), ci))
+                changed.push_back(ci);
+        }
+        std::sort(changed.begin(), changed.end());
+        changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+
+        const auto direct = directGates(img.digest);
+        const auto rotated = rotatedGates(img.digest);
+        std::vector<size_t> found;
+        for (size_t ci : changed) {
+            const auto row = static_cast<quint32>(ci);
+            if (!m_repColumns_.passes(row, direct)
+                && (rotated.empty() || !m_repColumns_.passes(row, rotated)))
+                continue;
+            if (confidence(img, repHashes(ci)) >= m_cfg_.strongThreshold)
+                found.push_back(ci);
+        }
+
+        // Crops only place an image nothing else did
+        if (!found.empty() || !known.empty() || !m_cfg_.matchCrops || !img.digest.has(HashKind::Pyramid))
+            return found;
+        std::optional<size_t> best;
+        double bestSim = 0.0;
+        for (size_t ci : changed) {
+            const double sim = cropSimilarity(img, repHashes(ci));
+            if (sim > bestSim) {
+                bestSim = sim;
+                best = ci;
+            }
+        }
+        if (best)
+            found.push_back(*best);
+        return found;
+    }
 
-        if (it == m_exactGroups_.end()) {
-            ExactGroup eg;
-            eg.sha = sha;
+    void SimilarityEngine::addExactCopy(ExactGroup& eg, ImageId image)
+    {
+        eg.images.push_back(image);
+
+        // The cluster the group joined, or the one that absorbed it since
+        const size_t ci = m_clusterSets_.find(static_cast<quint32>(eg.cluster));
+        eg.cluster = ci;
+        SimilarityGroup& cluster = m_clusters_[ci];
+        cluster.members.push_back(image);
+        m_clusterSets_.addWeight(static_cast<quint32>(ci), 1);
+        m_dirtyClusterIndices_.insert(ci);
+
+        const ImageId oldRep = eg.representative;
+        if (m_store_.better(image, oldRep)) {
+            eg.representative = image;
+            // Update representative of cluster if needed
+            if (cluster.representative == oldRep) {
+                represent(ci, image);
+                return;
+            }
+        }
+        m_store_.releasePlane(image);
+    }
+
+    void SimilarityEngine::endProbe()
+    {
+        if (m_probing_.fetch_sub(1, std::memory_order_relaxed) == 1) {
+            m_changeLogBase_ += m_changeLog_.size();
+            m_changeLog_.clear();
+        }
+    }
+
+    void SimilarityEngine::joinCluster(size_t ci, ImageId image)
+    {
+        SimilarityGroup& cluster = m_clusters_[ci];
+        cluster.members.push_back(image);
+        m_clusterSets_.addWeight(static_cast<quint32>(ci), 1);
+        if (m_store_.better(image, cluster.representative))
+            represent(ci, image);
+        else
+            m_store_.releasePlane(image);
+        m_dirtyClusterIndices_.insert(ci);
+    }
+
+    void SimilarityEngine::represent(size_t ci, ImageId image)
+    {
+        SimilarityGroup& cluster = m_clusters_[ci];
+        if (cluster.representative != ImageStore::None)
+            m_store_.releasePlane(cluster.representative);
+        cluster.representative = image;
+        indexCluster(m_store_.digest(image), ci);
+    }
+
+    size_t SimilarityEngine::mergeClusters(size_t a, size_t b)
+    {
+        // Linking by member count moves the smaller member list, so no
+        // image is moved more than log2(n) times
+        const size_t into = m_clusterSets_.unite(static_cast<quint32>(a), static_cast<quint32>(b));
+        const size_t from = into == a ? b : a;
+        SimilarityGroup& kept = m_clusters_[into];
+        SimilarityGroup& absorbed = m_clusters_[from];
+
+        kept.members.insert(kept.members.end(), absorbed.members.begin(), absorbed.members.end());
+        const ImageId rep = absorbed.representative;
+        absorbed.members = {};
+        absorbed.representative = ImageStore::None;
+
+        // Only the surviving representative is compared from here on
+        const auto id = static_cast<quint32>(from);
+        m_pHashIndex_->remove(id);
+        m_cropGlobalIndex_->remove(id);
+        m_cropWindowIndex_->remove(id);
+        if (m_store_.better(rep, kept.representative))
+            represent(into, rep);
+        else
+            m_store_.releasePlane(rep);
+
+        m_absorbed_.emplace_back(absorbed.id, into);
+        m_dirtyClusterIndices_.insert(into);
+        return into;
+    }
+
+    // Ids whose pyramid hashes are within crop reach of pyramid: its global
+    // hash against the sub-windows and the other way round. Sorted, unique.
+    static std::vector<quint32> cropCandidates(const PyramidDigest& pyramid,
+        const ICandidateIndex& globalIndex, const ICandidateIndex& windowIndex)
+    {
+        std::vector<ICandidateIndex::Match> matches;
+        const auto probe = [&](const ICandidateIndex& index, quint64 hash) {
+            if (PyramidHash::informative(hash))
+                index.query(hash, matches);
+        };
+        probe(windowIndex, pyramid[0]);
+        for (int i = 1; i < PyramidHashCount; ++i)
+            probe(globalIndex, pyramid[i]);
+
+        std::vector<quint32> ids;
+        ids.reserve(matches.size());
+        for (const auto& match : matches)
+            ids.push_back(match.id);
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        return ids;
+    }
+
+    double SimilarityEngine::cropSimilarity(const Hashes& a, const Hashes& b) const
+    {
+        // The best window pair, then the planes behind it
+        const auto match = PyramidHash::cropMatch(a.digest, b.digest);
+        if (match.similarity < m_cfg_.cropGate)
+            return 0.0;
+
+        const QByteArray& inner = match.aInsideB ? a.plane : b.plane;
+        const QByteArray& outer = match.aInsideB ? b.plane : a.plane;
+        if (PyramidHash::planeCorrelation(inner, outer, match.window) < m_cfg_.cropCorrelation)
+            return 0.0;
+        return match.similarity;
+    }
+
+    std::optional<size_t> SimilarityEngine::findCropCluster(const Hashes& img)
+    {
+        // Coarse: the crop indexes. Fine: cropSimilarity(); best cluster wins.
+        const auto candidates = cropCandidates(img.digest.pyramid,
+            *m_cropGlobalIndex_, *m_cropWindowIndex_);
+
+        std::optional<size_t> best;
+        double bestSim = 0.0;
+        for (quint32 ci : candidates) {
+            if (ci >= m_clusters_.size()) continue;
+            const double sim = cropSimilarity(img, repHashes(ci));
+            if (sim > bestSim) {
+                bestSim = sim;
+                best = ci;
+            }
+        }
+        return best;
+    }
+
+    void SimilarityEngine::indexCluster(const HashDigest& digest, size_t ci)
+    {
+        // Only the current representative is compared, so only its hashes
+        // stay indexed
+        const auto id = static_cast<quint32>(ci);
+        m_changeLog_.push_back(id);
+        m_repColumns_.set(id, digest);
+        m_pHashIndex_->remove(id);
+        m_cropGlobalIndex_->remove(id);
+        m_cropWindowIndex_->remove(id);
+
+        if (digest.has(HashKind::Perceptual)) {
+            m_pHashIndex_->insert(id, digest.pHash);
+            if (digest.has(HashKind::PerceptualCanonical) && digest.pHashCanonical != digest.pHash)
+                m_pHashIndex_->insert(id, digest.pHashCanonical);
+        }
+
+        if (!m_cfg_.matchCrops || !digest.has(HashKind::Pyramid))
+            return;
+        if (PyramidHash::informative(digest.pyramid[0]))
+            m_cropGlobalIndex_->insert(id, digest.pyramid[0]);
+        for (int i = 1; i < PyramidHashCount; ++i) {
+            if (PyramidHash::informative(digest.pyramid[i]))
+                m_cropWindowIndex_->insert(id, digest.pyramid[i]);
+        }
+    }
+
+    // ------------------------------------------------------------
+    // Batch clustering
+    // ------------------------------------------------------------
+
+    void SimilarityEngine::addBatch(const std::vector<std::shared_ptr<HashedImageResult>>& images, int threads)
+    {
+        std::unique_lock lock(m_mutex_);
+        m_store_.clear();
+        m_exactGroups_.clear();
+        m_clusters_.clear();
+        m_previouslyMultiImageClusterIds.clear();
+        m_previousClusters.clear();
+        m_dirtyClusterIndices_.clear();
+        m_pHashIndex_->clear();
+        m_cropGlobalIndex_->clear();
+        m_cropWindowIndex_->clear();
+        m_repColumns_.clear();
+        m_changeLogBase_ += m_changeLog_.size();
+        m_changeLog_.clear();
+        m_clusterSets_.clear();
+        m_absorbed_.clear();
+        std::fill(m_storedLive_.begin(), m_storedLive_.end(), Unclaimed);
+
+        // Path order from here on, so arrival order cannot show through
+        std::vector<std::pair<QString, HashedImageResult*>> sorted;
+        sorted.reserve(images.size());
+        for (const auto& img : images) {
+            if (img && img->digest.has(HashKind::Content))
+                sorted.emplace_back(img->fileIdentity.path() + "/" + img->fileIdentity.name(), img.get());
+        }
+        std::stable_sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+            return a.first < b.first;
+        });
+
+        // Exact groups, numbered in the order of their first copy
+        std::vector<ExactGroup*> exact;
+        for (const auto& [path, result] : sorted) {
+            const ImageId node = m_store_.add(*result);
+            auto [it, inserted] = m_exactGroups_.try_emplace(result->digest.content);
+            ExactGroup& eg = it->second;
+            if (inserted) {
+                eg.sha = result->digest.content;
+                eg.representative = node;
+                exact.push_back(&eg);
+            } else if (m_store_.better(node, eg.representative)) {
+                eg.representative = node;
+            }
             eg.images.push_back(node);
-            eg.representative = node;
-
-            bool placed = false;
-            const auto phashIt = img->hashes.find("Perceptual Hash");
-
-            // Try inverted index lookup (pHash must exist and index must be non-empty)
-            if (phashIt != img->hashes.end() && !m_subHashIndex_.empty()) {
-                auto subs = extractSubHashes(phashIt->second);
-                std::unordered_map<size_t, int> matchCount;
-                for (auto sub : subs) {
-                    auto idxIt = m_subHashIndex_.find(sub);
-                    if (idxIt == m_subHashIndex_.end()) continue;
-                    std::set<size_t> seenInBucket;
-                    for (size_t ci : idxIt->second) {
-                        if (seenInBucket.insert(ci).second)
-                            matchCount[ci]++;
-                    }
+        }
+        const size_t n = exact.size();
+        const auto rep = [&](size_t i) { return hashes(exact[i]->representative); };
+
+        auto pHashIndex = ICandidateIndex::create(m_cfg_.index, m_pHashIndex_->radius(), m_cfg_.indexBands);
+        HashColumns columns;
+        for (size_t i = 0; i < n; ++i) {
+            const HashDigest& digest = rep(i).digest;
+            const auto id = static_cast<quint32>(i);
+            columns.set(id, digest);
+            if (digest.has(HashKind::Perceptual)) {
+                pHashIndex->insert(id, digest.pHash);
+                if (digest.has(HashKind::PerceptualCanonical) && digest.pHashCanonical != digest.pHash)
+                    pHashIndex->insert(id, digest.pHashCanonical);
+            }
+        }
+
+        // Candidate pairs (i, j > i) past the column gates. Without a pHash
+        // the index cannot help: every j is a candidate, and the pairs with
+        // j < i that j's own query cannot find are claimed here too.
+        std::vector<std::vector<quint32>> candidates(n);
+        parallelFor(n, threads, [&](size_t i) {
+            const HashDigest& digest = rep(i).digest;
+            const auto direct = directGates(digest);
+            const auto rotated = rotatedGates(digest);
+            std::vector<quint32>& out = candidates[i];
+
+            if (digest.has(HashKind::Perceptual)) {
+                std::vector<ICandidateIndex::Match> matches;
+                pHashIndex->query(digest.pHash, matches);
+                if (digest.has(HashKind::PerceptualCanonical))
+                    pHashIndex->query(digest.pHashCanonical, matches);
+                for (const auto& match : matches) {
+                    if (match.id > i)
+                        out.push_back(match.id);
                 }
-                // Check candidates with >= 2 matching sub-hashes
-                for (const auto& [ci, count] : matchCount) {
-                    if (count >= 2 && ci < m_clusters_.size()) {
-                        double sim = confidence(*node->result, *m_clusters_[ci].representative->result);
-                        if (sim >= m_cfg_.strongThreshold) {
-                            m_clusters_[ci].members.push_back(node);
-                            if (better(*node, *m_clusters_[ci].representative))
-                                m_clusters_[ci].representative = node;
-                            m_dirtyClusterIndices_.insert(ci);
-                            placed = true;
-                            break;
-                        }
+            } else {
+                std::vector<quint64> masks;
+                columns.filter(direct, masks);
+                for (size_t b = 0; b < masks.size(); ++b) {
+                    for (quint64 bits = masks[b]; bits; bits &= bits - 1) {
+                        const size_t j = b * hamming::BlockSize + std::countr_zero(bits);
+                        if (j > i || (j < i && rep(j).digest.has(HashKind::Perceptual)))
+                            out.push_back(static_cast<quint32>(j));
                     }
                 }
             }
 
-            // Fallback: scan all clusters only when pHash is missing
-            if (!placed && phashIt == img->hashes.end()) {
-                for (auto& cluster : m_clusters_) {
-                    double sim = confidence(*node->result, *cluster.representative->result);
-                    if (sim >= m_cfg_.strongThreshold) {
-                        cluster.members.push_back(node);
-                        if (better(*node, *cluster.representative))
-                            cluster.representative = node;
-                        m_dirtyClusterIndices_.insert(static_cast<size_t>(&cluster - m_clusters_.data()));
-                        placed = true;
-                        break;
+            std::sort(out.begin(), out.end());
+            out.erase(std::unique(out.begin(), out.end()), out.end());
+            std::erase_if(out, [&](quint32 j) {
+                return !columns.passes(j, direct) && (rotated.empty() || !columns.passes(j, rotated));
+            });
+        });
+
+        // Lazy hashes up front, one thread per result, so the scoring below
+        // only reads. A concurrent engine needs every representative complete.
+        std::vector<char> involved(n, m_cfg_.concurrent ? 1 : 0);
+        for (size_t i = 0; i < n; ++i) {
+            if (candidates[i].empty())
+                continue;
+            involved[i] = 1;
+            for (quint32 j : candidates[i])
+                involved[j] = 1;
+        }
+        parallelFor(n, threads, [&](size_t i) {
+            if (involved[i]) {
+                const Hashes r = rep(i);
+                m_hashEngine_.completeLazy(r.digest, r.plane);
+            }
+        });
+
+        // Verified pairs join their sets. Roots are the smallest member, so
+        // the partition does not depend on which thread got there first.
+        ConcurrentUnionFind sets(n);
+        parallelFor(n, threads, [&](size_t i) {
+            for (quint32 j : candidates[i]) {
+                if (confidence(rep(i), rep(j)) >= m_cfg_.strongThreshold)
+                    sets.unite(static_cast<quint32>(i), j);
+            }
+        });
+
+        // Crops, as online in path order: an image no pHash match placed
+        // joins the one earlier set whose representative it crops best,
+        // ties to the smaller set. Only representatives are indexed, so a
+        // crop cannot bridge two sets. The comparisons run in parallel; the
+        // choices are then made in order, as each join can move a set's
+        // representative.
+        if (m_cfg_.matchCrops) {
+            std::vector<int> setSize(n, 0);
+            std::vector<quint32> best(n);
+            for (size_t i = 0; i < n; ++i) {
+                const quint32 root = sets.find(static_cast<quint32>(i));
+                ++setSize[root];
+                // Ascending, so the root starts and only a better copy takes
+                // over, as when the clusters are built below
+                if (root == i || m_store_.better(exact[i]->representative, exact[best[root]]->representative))
+                    best[root] = static_cast<quint32>(i);
+            }
+            const auto alone = [&](size_t i) {
+                return setSize[i] == 1 && rep(i).digest.has(HashKind::Pyramid);
+            };
+
+            // Images that are or may become a representative
+            auto globalIndex = ICandidateIndex::create(m_cfg_.index, m_cropGlobalIndex_->radius(), m_cfg_.indexBands);
+            auto windowIndex = ICandidateIndex::create(m_cfg_.index, m_cropWindowIndex_->radius(), m_cfg_.indexBands);
+            for (size_t i = 0; i < n; ++i) {
+                const HashDigest& digest = rep(i).digest;
+                if (best[sets.find(static_cast<quint32>(i))] != i || !digest.has(HashKind::Pyramid))
+                    continue;
+                const auto id = static_cast<quint32>(i);
+                if (PyramidHash::informative(digest.pyramid[0]))
+                    globalIndex->insert(id, digest.pyramid[0]);
+                for (int w = 1; w < PyramidHashCount; ++w) {
+                    if (PyramidHash::informative(digest.pyramid[w]))
+                        windowIndex->insert(id, digest.pyramid[w]);
+                }
+            }
+
+            std::vector<std::vector<std::pair<quint32, double>>> crops(n);
+            parallelFor(n, threads, [&](size_t i) {
+                if (!alone(i))
+                    return;
+                for (quint32 j : cropCandidates(rep(i).digest.pyramid, *globalIndex, *windowIndex)) {
+                    if (sets.find(j) >= i)
+                        continue;
+                    const double sim = cropSimilarity(rep(i), rep(j));
+                    if (sim > 0.0)
+                        crops[i].emplace_back(j, sim);
+                }
+            });
+
+            for (size_t i = 0; i < n; ++i) {
+                quint32 target = 0;
+                double bestSim = 0.0;
+                for (const auto& [j, sim] : crops[i]) {
+                    const quint32 root = sets.find(j);
+                    if (root >= i || best[root] != j)
+                        continue;
+                    if (sim > bestSim || (sim == bestSim && root < target)) {
+                        bestSim = sim;
+                        target = root;
                     }
                 }
+                if (bestSim == 0.0)
+                    continue;
+                sets.unite(static_cast<quint32>(i), target);
+                if (m_store_.better(exact[i]->representative, exact[best[target]]->representative))
+                    best[target] = static_cast<quint32>(i);
             }
+        }
 
-            if (!placed) {
+        // One cluster per set, in the order of their smallest member
+        std::vector<size_t> clusterOf(n);
+        for (size_t i = 0; i < n; ++i) {
+            const quint32 root = sets.find(static_cast<quint32>(i));
+            if (root == i) {
                 SimilarityGroup c;
                 c.id = m_nextGroupId_++;
-                c.representative = node;
-                c.members.push_back(node);
+                c.representative = exact[i]->representative;
+                clusterOf[i] = m_clusters_.size();
                 m_clusters_.push_back(std::move(c));
-                m_dirtyClusterIndices_.insert(m_clusters_.size() - 1);
-
-                // Add new cluster to inverted index
-                if (phashIt != img->hashes.end()) {
-                    auto subs = extractSubHashes(phashIt->second);
-                    size_t clusterIdx = m_clusters_.size() - 1;
-                    for (auto sub : subs)
-                        m_subHashIndex_[sub].push_back(clusterIdx);
-                }
-            }
-
-            m_exactGroups_.insert({sha, std::move(eg)});
-        } else {
-            ExactGroup& eg = it->second;
-            eg.images.push_back(node);
-
-            ImageNode* oldRep = eg.representative;
-            bool newlyBetter = better(*node, *oldRep);
-            if (newlyBetter) {
-                eg.representative = node;
             }
+            exact[i]->cluster = clusterOf[root];
+            SimilarityGroup& cluster = m_clusters_[clusterOf[root]];
+            cluster.members.insert(cluster.members.end(), exact[i]->images.begin(), exact[i]->images.end());
+            if (m_store_.better(exact[i]->representative, cluster.representative))
+                cluster.representative = exact[i]->representative;
+        }
 
-            for (auto& cluster : m_clusters_) {
-                // Find cluster containing the ExactGroup
-                if (std::find(cluster.members.begin(), cluster.members.end(), oldRep) != cluster.members.end()) {
-                    cluster.members.push_back(node);
-                    m_dirtyClusterIndices_.insert(static_cast<size_t>(&cluster - m_clusters_.data()));
-                    // Update representative of cluster if needed
-                    if (newlyBetter && cluster.representative == oldRep) {
-                        cluster.representative = node;
-                        // Add new rep's sub-hashes to inverted index
-                        const auto& phashIt = img->hashes.find("Perceptual Hash");
-                        if (phashIt != img->hashes.end()) {
-                            auto subs = extractSubHashes(phashIt->second);
-                            size_t ci = static_cast<size_t>(&cluster - m_clusters_.data());
-                            for (auto sub : subs)
-                                m_subHashIndex_[sub].push_back(ci);
-                        }
-                    }
-                    break;
-                }
+        // Only representatives are compared from here on
+        for (size_t ci = 0; ci < m_clusters_.size(); ++ci) {
+            const SimilarityGroup& cluster = m_clusters_[ci];
+            for (ImageId member : cluster.members) {
+                if (member != cluster.representative)
+                    m_store_.releasePlane(member);
             }
+            m_clusterSets_.add(static_cast<quint32>(cluster.members.size()));
+            m_dirtyClusterIndices_.insert(ci);
+            indexCluster(m_store_.digest(cluster.representative), ci);
         }
     }
 
     std::vector<ImageGroup> SimilarityEngine::getGroups() const
     {
+        std::shared_lock lock(m_mutex_);
         std::vector<ImageGroup> out;
         out.reserve(m_clusters_.size());
 
         for (const auto& c : m_clusters_) {
-            out.push_back(buildGroup(c));
+            if (!c.absorbed())
+                out.push_back(buildGroup(c));
         }
 
         return out;
     }
 
+    // ------------------------------------------------------------
+    // Persistent index
+    // ------------------------------------------------------------
+
+    void SimilarityEngine::attach(std::shared_ptr<const SimilarityIndexFile> stored)
+    {
+        std::unique_lock lock(m_mutex_);
+        // Stored digests are scored through the registry only
+        if (m_cfg_.runtimeMethods)
+            stored.reset();
+        m_stored_ = std::move(stored);
+        const size_t clusters = m_stored_ ? m_stored_->clusterCount() : 0;
+        m_storedLive_.assign(clusters, Unclaimed);
+        m_storedStale_.assign(clusters, 0);
+    }
+
+    bool SimilarityEngine::save(const QString& path)
+    {
+        std::unique_lock lock(m_mutex_);
+        SimilarityIndexFile::Writer writer;
+        for (const auto& cluster : m_clusters_) {
+            if (cluster.absorbed())
+                continue;
+
+            // The next scan scores the representative without its plane
+            const Hashes rep = hashes(cluster.representative);
+            m_hashEngine_.completeLazy(rep.digest, rep.plane);
+
+            const quint32 k = writer.addCluster();
+            for (ImageId member : cluster.members) {
+                const quint32 image = writer.addImage(m_store_.path(member), m_store_.fileSize(member),
+                    m_store_.modifiedTime(member), m_store_.digest(member), k);
+                if (member == cluster.representative)
+                    writer.setRepresentative(k, image);
+            }
+        }
+        return writer.save(path, fingerprint(), m_pHashIndex_->radius(), m_cfg_.indexBands);
+    }
+
+    quint64 SimilarityEngine::fingerprint() const
+    {
+        // Zeroed first so padding hashes the same every time
+        struct {
+            double strongThreshold, pHashGate, dHashGate;
+            double pHashWeight, dHashWeight, aHashWeight, ratioWeight;
+            double cropGate, cropCorrelation;
+            qint32 radius, bands;
+            quint8 matchRotated, matchCrops, contentAlgorithm;
+            quint32 digestSize;
+        } key;
+        std::memset(&key, 0, sizeof(key));
+        key.strongThreshold = m_cfg_.strongThreshold;
+        key.pHashGate = m_cfg_.pHashGate;
+        key.dHashGate = m_cfg_.dHashGate;
+        key.pHashWeight = m_cfg_.pHashWeight;
+        key.dHashWeight = m_cfg_.dHashWeight;
+        key.aHashWeight = m_cfg_.aHashWeight;
+        key.ratioWeight = m_cfg_.ratioWeight;
+        key.cropGate = m_cfg_.cropGate;
+        key.cropCorrelation = m_cfg_.cropCorrelation;
+        key.radius = m_pHashIndex_->radius();
+        key.bands = m_cfg_.indexBands;
+        key.matchRotated = m_cfg_.matchRotated;
+        key.matchCrops = m_cfg_.matchCrops;
+        key.contentAlgorithm = static_cast<quint8>(ActiveContentAlgorithm);
+        key.digestSize = sizeof(HashDigest);
+
+        QByteArray bytes(reinterpret_cast<const char*>(&key), sizeof(key));
+        const auto versions = registry::versions<Methods>();
+        for (auto it = versions.constBegin(); it != versions.constEnd(); ++it) {
+            const qint32 version = it.value();
+            bytes.append(it.key().toUtf8());
+            bytes.append(reinterpret_cast<const char*>(&version), sizeof(version));
+        }
+
+        const ContentDigest digest = xxh3::digest128(
+            reinterpret_cast<const uchar*>(bytes.constData()), static_cast<size_t>(bytes.size()));
+        quint64 value;
+        std::memcpy(&value, digest.data(), sizeof(value));
+        return value;
+    }
+
     SimilarityEngine::GroupDelta SimilarityEngine::getGroupDelta()
     {
+        std::unique_lock lock(m_mutex_);
         GroupDelta delta;
 
+        // Only clusters the caller was shown need retiring
+        for (const auto& [id, ci] : m_absorbed_) {
+            if (m_previouslyMultiImageClusterIds.erase(id))
+                delta.merged.push_back({ m_clusters_[m_clusterSets_.find(static_cast<quint32>(ci))].id, id });
+            m_previousClusters.erase(id);
+        }
+        m_absorbed_.clear();
+
         for (size_t ci : m_dirtyClusterIndices_) {
             if (ci >= m_clusters_.size()) continue;
             const auto& cluster = m_clusters_[ci];
+            if (cluster.absorbed()) continue;
 
             bool wasMulti = m_previouslyMultiImageClusterIds.contains(cluster.id);
             bool isMulti = cluster.members.size() > 1;
-            size_t prevSize = 0;
-            auto it = m_previousClusterSizes.find(cluster.id);
-            if (it != m_previousClusterSizes.end()) {
-                prevSize = it->second;
-            }
-            if (!wasMulti && isMulti) {
+            if (!isMulti)
+                continue;
+
+            ShownCluster& shown = m_previousClusters[cluster.id];
+            if (!wasMulti) {
                 delta.newlyFormed.push_back(buildGroup(cluster));
-            } else if (isMulti && cluster.members.size() > prevSize) {
-                delta.grown.push_back(buildGroup(cluster));
+                shown.bestIndex = delta.newlyFormed.back().bestIndex;
+            } else if (cluster.members.size() > shown.size) {
+                delta.grown.push_back(buildGrowth(cluster, shown));
+                shown.bestIndex = delta.grown.back().bestIndex;
             }
 
-            if (isMulti) {
-                m_previouslyMultiImageClusterIds.insert(cluster.id);
-                m_previousClusterSizes[cluster.id] = cluster.members.size();
-            }
+            m_previouslyMultiImageClusterIds.insert(cluster.id);
+            shown.size = cluster.members.size();
         }
 
         m_dirtyClusterIndices_.clear();
         return delta;
     }
 
+    size_t SimilarityEngine::memoryUsage() const
+    {
+        std::shared_lock lock(m_mutex_);
+        // Hash map nodes estimated as the value and two pointers
+        size_t total = m_store_.memoryUsage()
+            + m_exactGroups_.size() * (sizeof(std::pair<const ContentDigest, ExactGroup>) + 2 * sizeof(void*))
+            + m_exactGroups_.bucket_count() * sizeof(void*)
+            + m_clusters_.capacity() * sizeof(SimilarityGroup);
+        for (const auto& [sha, eg] : m_exactGroups_)
+            total += eg.images.capacity() * sizeof(ImageId);
+        for (const auto& cluster : m_clusters_)
+            total += cluster.members.capacity() * sizeof(ImageId);
+        return total;
+    }
+
+    size_t SimilarityEngine::imageCount() const
+    {
+        std::shared_lock lock(m_mutex_);
+        return m_store_.size();
+    }
+
     // ------------------------------------------------------------
     // Confidence calculation
     // ------------------------------------------------------------
 
     double SimilarityEngine::confidence(
-        const HashedImageResult& a,
-        const HashedImageResult& b
+        const Hashes& a,
+        const Hashes& b
+    ) const
+    {
+        const auto completeLazy = [&] {
+            m_hashEngine_.completeLazy(a.digest, a.plane);
+            m_hashEngine_.completeLazy(b.digest, b.plane);
+        };
+        const double direct = m_cfg_.runtimeMethods
+            ? runtimeConfidence(a, b)
+            : registry::confidence<Methods>(a.digest, b.digest, completeLazy);
+        if (direct > 0.0 || !m_cfg_.matchRotated)
+            return direct;
+        return rotatedConfidence(a.digest, b.digest);
+    }
+
+    double SimilarityEngine::runtimeConfidence(
+        const Hashes& a,
+        const Hashes& b
     ) const
     {
         double score = 0.0;
         double weightSum = 0.0;
 
         for (const auto& h : m_hashes_) {
-            const QString& key = h.method->key();
+            const HashKind kind = h.method->kind();
+
+            // Catalog order puts pHash first, so this runs past its gate only
+            if (m_hashEngine_.lazyKinds() & HashDigest::bit(kind)) {
+                m_hashEngine_.completeLazy(a.digest, a.plane);
+                m_hashEngine_.completeLazy(b.digest, b.plane);
+            }
 
-            if (!a.hashes.count(key) || !b.hashes.count(key))
+            if (!a.digest.has(kind) || !b.digest.has(kind))
                 continue;
 
-            double sim = h.method->compare(
-                a.hashes.at(key),
-                b.hashes.at(key)
-            );
+            double sim = h.method->compare(a.digest, b.digest);
 
-            if (key == "Perceptual Hash" && sim < m_cfg_.pHashGate)
+            if (kind == HashKind::Perceptual && sim < m_cfg_.pHashGate)
                 return 0.0;
 
-            if (key == "Difference Hash" && sim < m_cfg_.dHashGate)
+            if (kind == HashKind::Difference && sim < m_cfg_.dHashGate)
                 return 0.0;
 
             score += sim * h.weight;
@@ -238,41 +917,57 @@ namespace photoboss {
         return weightSum > 0.0 ? score / weightSum : 0.0;
     }
 
-    // ------------------------------------------------------------
-    // Representative selection
-    // ------------------------------------------------------------
-
-
-
-    bool SimilarityEngine::better(
-        const ImageNode& a,
-        const ImageNode& b
-    )
+    double SimilarityEngine::rotatedConfidence(
+        const HashDigest& a,
+        const HashDigest& b
+    ) const
     {
-        return score(a) > score(b);
+        if (!a.has(HashKind::Perceptual) || !b.has(HashKind::Perceptual) ||
+            !a.has(HashKind::PerceptualCanonical) || !b.has(HashKind::PerceptualCanonical))
+            return 0.0;
+
+        // A pair that already matches as stored was turned down by the other
+        // gates; orientation does not explain that.
+        if (PerceptualHash::similarity(a, b) >= m_cfg_.pHashGate)
+            return 0.0;
+
+        // dHash and aHash are tied to orientation, so the canonical pHash is
+        // the only evidence left and has to clear the pHash gate on its own.
+        const double sim = PerceptualHash::canonicalSimilarity(a, b);
+        return sim >= m_cfg_.pHashGate ? sim : 0.0;
     }
 
-    // ------------------------------------------------------------
-    // Image Score calculation
-    // ------------------------------------------------------------
-
-    double SimilarityEngine::score(const ImageNode& img)
+    double SimilarityEngine::storedConfidence(
+        const Hashes& img,
+        const HashDigest& stored
+    ) const
     {
-        const double pixels =
-            static_cast<double>(img.resolution.width()) *
-            static_cast<double>(img.resolution.height());
-
-        double score = pixels;
-
-        score += img.fileSize * 0.001;
-
-        const QString ext = img.result->fileIdentity.extension().toLower();
-        if (ext == "png") score *= 1.05;
+        const auto completeLazy = [&] { m_hashEngine_.completeLazy(img.digest, img.plane); };
+        const double direct = registry::confidence<Methods>(img.digest, stored, completeLazy);
+        if (direct > 0.0 || !m_cfg_.matchRotated)
+            return direct;
+        return rotatedConfidence(img.digest, stored);
+    }
 
-        if (img.result->fileIdentity.exif().dateTimeOriginal)
-            score *= 1.02;
+    std::vector<HashColumns::Gate> SimilarityEngine::directGates(const HashDigest& digest) const
+    {
+        std::vector<HashColumns::Gate> gates;
+        if (digest.has(HashKind::Perceptual))
+            gates.push_back({ HashKind::Perceptual, digest.pHash, gateRadius(m_cfg_.pHashGate), true });
+        if (digest.has(HashKind::Difference))
+            gates.push_back({ HashKind::Difference, digest.dHash, gateRadius(m_cfg_.dHashGate), true });
+        return gates;
+    }
 
-        return score;
+    std::vector<HashColumns::Gate> SimilarityEngine::rotatedGates(const HashDigest& digest) const
+    {
+        if (!m_cfg_.matchRotated || !digest.has(HashKind::Perceptual) || !digest.has(HashKind::PerceptualCanonical))
+            return {};
+        // Both sides need both pHashes, see rotatedConfidence()
+        return {
+            { HashKind::Perceptual, digest.pHash, 64, false },
+            { HashKind::PerceptualCanonical, digest.pHashCanonical, gateRadius(m_cfg_.pHashGate), false }
+        };
     }
 
     // ------------------------------------------------------------
@@ -287,20 +982,10 @@ namespace photoboss {
         out.id = g.id;
         out.bestIndex = 0;
 
-        ImageNode* best = g.representative;
-
         for (size_t i = 0; i < g.members.size(); ++i) {
-            const auto* img = g.members[i];
-
-            ImageEntry e;
-            e.path = img->result->fileIdentity.path()+"/"+img->result->fileIdentity.name();
-            e.fileSize = img->fileSize;
-            e.lastModified = img->result->fileIdentity.modifiedTime();
-            e.resolution = img->resolution;
-            e.format = img->result->fileIdentity.extension();
-            e.isBest = (img == best);
-            e.rotation = img->result->fileIdentity.exif().orientation.value_or(1);
-            
+            ImageEntry e = m_store_.entry(g.members[i]);
+            e.isBest = (g.members[i] == g.representative);
+
             if (e.isBest)
                 out.bestIndex = static_cast<int>(i);
 
@@ -309,4 +994,28 @@ namespace photoboss {
 
         return out;
     }
+
+    GroupGrowth SimilarityEngine::buildGrowth(
+        const SimilarityGroup& g,
+        const ShownCluster& shown
+    ) const
+    {
+        GroupGrowth out;
+        out.id = g.id;
+        out.firstIndex = static_cast<int>(shown.size);
+        out.bestIndex = shown.bestIndex;
+        out.added.reserve(g.members.size() - shown.size);
+
+        for (size_t i = shown.size; i < g.members.size(); ++i) {
+            ImageEntry e = m_store_.entry(g.members[i]);
+            e.isBest = (g.members[i] == g.representative);
+
+            if (e.isBest)
+                out.bestIndex = static_cast<int>(i);
+
+            out.added.push_back(std::move(e));
+        }
+
+        return out;
+    }
 }
\ No newline at end of file
@@ -4,19 +4,21 @@
 
 namespace photoboss
 {
-	CacheLookup::CacheLookup(Queue<FileIdentity>& input, Queue<FileIdentity>& diskOut, 
-        Queue<std::shared_ptr<HashedImageResult>>& resultOut, quint64 scanId, QObject* parent)
+	CacheLookup::CacheLookup(Queue<FileIdentity>& input, Queue<DiskReadRequest>& diskOut, 
+        Queue<std::shared_ptr<HashedImageResult>>& resultOut,
+        Queue<std::shared_ptr<HashedImageResult>>& storeOut, quint64 scanId, QObject* parent)
 : StageBase(parent),
  		m_inputQueue_(input),
  		m_diskReadQueue_(diskOut),
  		m_resultQueue_(resultOut),
+ 		m_storeQueue_(storeOut),
  		m_cache_(std::make_unique<SqliteHashCache>(scanId))
  	{
-        for (HashCatalog::Entry& method : HashCatalog::createAll()) {
-            m_methods_.append(method.method.get()->key());
-        }
+        m_methods_ = registry::eagerKeys<registry::DefaultMethods>();
+        m_lazyMethods_ = registry::lazyKeys<registry::DefaultMethods>();
         m_resultQueue_.register_producer();
         m_diskReadQueue_.register_producer();
+        m_storeQueue_.register_producer();
 	}
 
 
@@ -24,10 +26,34 @@ namespace photoboss
     {
         m_resultQueue_.producer_done();
         m_diskReadQueue_.producer_done();
+        m_storeQueue_.producer_done();
+    }
+
+    bool CacheLookup::completeFromPlane(HashedImageResult& partial, const QList<QString>& missing) const
+    {
+        if (partial.plane.size() != PerceptualImage::PlaneSize)
+            return false;
+
+        const quint8 planeKinds = m_hashEngine_.imageKinds();
+        for (const auto& key : missing) {
+            const auto kind = hashKindFromKey(key);
+            if (!kind || !(planeKinds & HashDigest::bit(*kind)))
+                return false;   // a byte method: needs the file
+        }
+
+        m_hashEngine_.hashPlanes({ &partial.plane }, { &partial.digest });
+        return (partial.digest.present & planeKinds) == planeKinds;
     }
 
     void CacheLookup::doRun()
     {
+        // Rows stored by an older version of a method are rebuilt from their
+        // planes before any lookup can return them
+        m_cache_->upgradeMethods(registry::versions<registry::DefaultMethods>(),
+            [this](const std::vector<const QByteArray*>& planes, const std::vector<HashDigest*>& digests) {
+                m_hashEngine_.hashPlanes(planes, digests);
+            });
+
         int totalProcessed = 0;
         while (true) {
             FileIdentity fileId;
@@ -41,14 +67,23 @@ namespace photoboss
             CacheQuery query(fileId);
 
             query.hashMethods = m_methods_;
+            query.optionalMethods = m_lazyMethods_;
 
             auto result = m_cache_->lookup(query);
 
-            if (result.hit == Lookup::Hit) {
+            if (result.hit == Lookup::Hit || result.hit == Lookup::Failed) {
+                // A known failure goes straight on to be reported, unread
                 m_resultQueue_.emplace(std::make_shared<HashedImageResult>(std::move(result.hashedImage)));
             }
+            else if (result.hit == Lookup::Partial) {
+                auto partial = std::make_shared<HashedImageResult>(std::move(result.hashedImage));
+                if (completeFromPlane(*partial, result.missingMethods))
+                    m_storeQueue_.emplace(std::move(partial));
+                else
+                    m_diskReadQueue_.emplace(DiskReadRequest{ std::move(fileId), std::move(partial) });
+            }
             else {
-                m_diskReadQueue_.emplace(std::move(fileId));
+                m_diskReadQueue_.emplace(DiskReadRequest{ std::move(fileId), nullptr });
             }
         }
     }
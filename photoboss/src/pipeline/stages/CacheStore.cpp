@@ -13,7 +13,8 @@ namespace photoboss
         StageBase(parent),
         m_cache_(std::make_unique<SqliteHashCache>(scanId)),
         m_output_(output),
-        m_input_(input)
+        m_input_(input),
+        m_versions_(registry::versions<registry::DefaultMethods>())
     {
         m_output_.register_producer();
         m_batch_.reserve(settings::CacheStoreBatchSize);
@@ -33,9 +34,13 @@ namespace photoboss
         while (m_input_.wait_and_pop(item)) {
             SCOPED_TIMER("CacheStore");
             HashedImageResult copy(item->fileIdentity, item->source,
-                item->cachedAt, item->resolution, item->hashes);
+                item->cachedAt, item->resolution, item->digest);
             copy.decodedImage = item->decodedImage;
-            m_batch_.emplace_back(std::move(copy), QMap<QString, int>{});
+            copy.plane = item->plane;
+            copy.storedKinds = item->storedKinds;
+            copy.quality = item->quality;
+            copy.failure = item->failure;
+            m_batch_.emplace_back(std::move(copy), m_versions_);
             m_output_.push(std::move(item));
             if (m_batch_.size() >= settings::CacheStoreBatchSize)
                 flushBatch();
@@ -9,7 +9,7 @@
 
 namespace photoboss {
 
-DiskReader::DiskReader(Queue<FileIdentity> &input_queue,
+DiskReader::DiskReader(Queue<DiskReadRequest> &input_queue,
                        Queue<std::unique_ptr<DiskReadResult>> &queue,
                        QObject *parent)
     : StageBase(parent), m_input_queue_(input_queue), m_output_queue_(queue) {
@@ -18,29 +18,42 @@ DiskReader::DiskReader(Queue<FileIdentity> &input_queue,
 
 void DiskReader::doRun() {
   while (true) {
-    FileIdentity fileIdentity;
-    if (!m_input_queue_.wait_and_pop(fileIdentity)) {
+    DiskReadRequest request;
+    if (!m_input_queue_.wait_and_pop(request)) {
       break;
     }
     SCOPED_TIMER("DiskReader");
+    const FileIdentity &fileIdentity = request.fileIdentity;
 
     QFile file(fileIdentity.path() + "/" + fileIdentity.name());
+    std::unique_ptr<DiskReadResult> result;
     if (file.open(QIODevice::ReadOnly)) {
       QByteArray bytes = file.readAll();
-      ExifData exif = exif::ExifParser::parse(bytes);
-      FileIdentity fullId(
-          fileIdentity.name(), fileIdentity.path(),
-          fileIdentity.extension(), fileIdentity.size(),
-          fileIdentity.modifiedTime(), exif);
-      auto result =
-          std::make_unique<DiskReadResult>(std::move(fullId), std::move(bytes));
-
-      if (!m_output_queue_.push(std::move(result))) {
-        qDebug()
-            << "DiskReader: Output queue shutdown, file dropped, stopping.";
-        return;
+      if (file.error() == QFile::NoError) {
+        ExifData exif = exif::ExifParser::parse(bytes);
+        FileIdentity fullId(
+            fileIdentity.name(), fileIdentity.path(),
+            fileIdentity.extension(), fileIdentity.size(),
+            fileIdentity.modifiedTime(), exif);
+        result =
+            std::make_unique<DiskReadResult>(std::move(fullId), std::move(bytes));
+        result->cached = std::move(request.cached);
       }
     }
+
+    // Passed on rather than dropped, so the failure is cached and reported
+    if (!result) {
+      qDebug() << "DiskReader: cannot read" << file.fileName() << "-"
+               << file.errorString();
+      result = std::make_unique<DiskReadResult>(fileIdentity, QByteArray());
+      result->failure = FileFailure::Unreadable;
+    }
+
+    if (!m_output_queue_.push(std::move(result))) {
+      qDebug()
+          << "DiskReader: Output queue shutdown, file dropped, stopping.";
+      return;
+    }
   }
 }
 
@@ -1,4 +1,5 @@
 #include "pipeline/stages/HashWorker.h"
+#include "caching/SqliteHashCache.h"
 #include "util/AppSettings.h"
 #include "util/ScopedTimer.h"
 #include <QDebug>
@@ -7,12 +8,17 @@ namespace photoboss {
 
 HashWorker::HashWorker(Queue<std::unique_ptr<DiskReadResult>>& inputQueue,
                                      Queue<std::shared_ptr<HashedImageResult>>& outputQueue,
+                                     std::shared_ptr<ContentIndex> contentIndex,
+                                     quint64 scanId,
                                      QObject* parent)
     : StageBase(parent)
     , m_inputQueue_(inputQueue)
     , m_outputQueue_(outputQueue)
     , m_imageLoader_()
-    , m_hashEngine_(HashCatalog::createAll())
+    , m_hashEngine_()
+    , m_contentIndex_(std::move(contentIndex))
+    , m_cache_(std::make_unique<SqliteHashCache>(scanId))
+    , m_methods_(registry::eagerKeys<registry::DefaultMethods>())
 {
     // Register as producer for the downstream queue.
     m_outputQueue_.register_producer();
@@ -22,21 +28,159 @@ HashWorker::~HashWorker() = default;
 
 void HashWorker::doRun()
 {
+    std::vector<std::unique_ptr<DiskReadResult>> batch;
+    std::vector<const DiskReadResult*> items;
+    std::vector<std::shared_ptr<HashedImageResult>> hashed;
+    std::vector<std::shared_ptr<HashedImageResult>> results;
+    std::vector<HashedImageResult*> pending;
+    std::vector<std::optional<QImage>> images;
+    std::vector<const QByteArray*> planes;
+    std::vector<HashDigest*> planeDigests;
+    batch.reserve(settings::HashBatchSize);
+
     while (true) {
+        // Block for one read, then take whatever else is already queued (up
+        // to HashBatchSize) without waiting, so a slow disk never delays a
+        // file just to fill the batch.
         std::unique_ptr<DiskReadResult> item;
         if (!m_inputQueue_.wait_and_pop(item)) {
             break;
         }
+        batch.clear();
+        batch.push_back(std::move(item));
+        while (static_cast<int>(batch.size()) < settings::HashBatchSize && m_inputQueue_.try_pop(item)) {
+            batch.push_back(std::move(item));
+        }
         SCOPED_TIMER("HashWorker");
 
-        // Decode at thumbnail size so the QImage can be forwarded to
-        // ThumbnailGenerator instead of requiring a second disk read.
-        std::optional<QImage> img = m_imageLoader_.load(*item, settings::ThumbnailWidth);
+        // Content digests first, the whole batch at once: a copy of content
+        // hashed before needs no decode. A partial cache hit that already
+        // holds the digest skips it, as does a file that could not be read.
+        items.clear();
+        for (const auto& read : batch) {
+            if (read->failure == FileFailure::None &&
+                (!read->cached || !read->cached->digest.has(HashKind::Content))) {
+                items.push_back(read.get());
+            }
+        }
+        hashed = m_hashEngine_.computeContentBatch(items);
+
+        results.clear();
+        for (size_t i = 0, next = 0; i < batch.size(); ++i) {
+            const auto& read = batch[i];
+            if (read->failure != FileFailure::None) {
+                results.push_back(std::make_shared<HashedImageResult>(read->fileIdentity, HashSource::Error));
+                results.back()->failure = read->failure;
+                continue;
+            }
+            if (!read->cached || !read->cached->digest.has(HashKind::Content)) {
+                results.push_back(std::move(hashed[next++]));
+            } else {
+                results.push_back(std::make_shared<HashedImageResult>(read->fileIdentity));
+            }
+            if (read->cached) {
+                adoptCached(*results.back(), *read->cached);
+            }
+        }
+
+        // Only what is still missing: nothing when a partial hit held every
+        // image hash, the stored plane when it held that, a decode otherwise
+        const quint8 imageKinds = m_hashEngine_.imageKinds();
+        pending.clear();
+        images.clear();
+        planes.clear();
+        planeDigests.clear();
+        for (size_t i = 0; i < batch.size(); ++i) {
+            const auto& read = batch[i];
+            HashedImageResult& result = *results[i];
+            if (result.failure != FileFailure::None ||
+                (result.digest.present & imageKinds) == imageKinds) {
+                continue;
+            }
+            if (result.plane.size() == PerceptualImage::PlaneSize) {
+                planes.push_back(&result.plane);
+                planeDigests.push_back(&result.digest);
+                continue;
+            }
+            if (reuseKnownContent(result)) {
+                continue;
+            }
+
+            // Hashing only needs luma, so JPEGs decode just the Y plane at the
+            // smallest IDCT scale that still covers the thumbnail size.
+            // Other formats decode in colour at thumbnail size so the QImage
+            // can be forwarded to ThumbnailGenerator instead of requiring a
+            // second disk read.
+            FileFailure failure = FileFailure::None;
+            pending.push_back(results[i].get());
+            images.push_back(m_imageLoader_.load(*read, settings::ThumbnailWidth, ImageLoader::Decode::Luma, &failure));
+            result.failure = failure;
+        }
+
+        // Image hashes for everything not reused. decodedImage is passed
+        // through to the result for ThumbnailGenerator, unless it is a
+        // luma-only decode: grouped JPEGs get their thumbnail from the
+        // thumbnail cache or a colour decode from disk instead.
+        m_hashEngine_.hashPlanes(planes, planeDigests);
+        m_hashEngine_.computeImages(pending, images);
+        for (const HashedImageResult* result : pending) {
+            if (result->source == HashSource::Fresh) {
+                m_contentIndex_->insert(result->digest.content, { result->digest, result->resolution, result->plane, result->quality });
+            }
+        }
+
+        for (auto& result : results) {
+            if (result->decodedImage && result->decodedImage->format() == QImage::Format_Grayscale8) {
+                result->decodedImage.reset();
+            }
+            m_outputQueue_.emplace(std::move(result));
+        }
+    }
+}
+
+void HashWorker::adoptCached(HashedImageResult& result, const HashedImageResult& cached)
+{
+    for (int k = 0; k < HashKindCount; ++k) {
+        const auto kind = static_cast<HashKind>(k);
+        if (!cached.digest.has(kind) || result.digest.has(kind)) {
+            continue;
+        }
+        result.digest.copyValue(kind, cached.digest);
+    }
+    result.storedKinds = cached.storedKinds;
+    if (result.resolution.isEmpty()) {
+        result.resolution = cached.resolution;
+    }
+    if (result.plane.isEmpty()) {
+        result.plane = cached.plane;
+    }
+    if (!result.quality.measured()) {
+        result.quality.sharpness = cached.quality.sharpness;
+        result.quality.clipped = cached.quality.clipped;
+    }
+    if (result.quality.jpegQuality == 0) {
+        result.quality.jpegQuality = cached.quality.jpegQuality;
+    }
+}
+
+bool HashWorker::reuseKnownContent(HashedImageResult& result)
+{
+    if (result.source != HashSource::Fresh || !result.digest.has(HashKind::Content)) {
+        return false;
+    }
+
+    const ContentDigest& content = result.digest.content;
+    if (auto known = m_contentIndex_->find(content)) {
+        return m_hashEngine_.reuseImageHashes(result, *known);
+    }
 
-        // Compute hashes using both raw bytes and, if available, the QImage.
-        // decodedImage is passed through to the result for ThumbnailGenerator.
-        m_outputQueue_.emplace(m_hashEngine_.compute(*item, img));
+    // Not seen this scan; the cache may hold it under another path
+    auto stored = m_cache_->lookupContent(content, m_methods_);
+    if (!stored || !m_hashEngine_.reuseImageHashes(result, *stored)) {
+        return false;
     }
+    m_contentIndex_->insert(content, *stored);
+    return true;
 }
 
 void HashWorker::onStop()
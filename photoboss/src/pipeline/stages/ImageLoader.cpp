@@ -1,24 +1,51 @@
 #include "pipeline/stages/ImageLoader.h"
+#include "pipeline/stages/JpegDecoder.h"
 #include "util/AppSettings.h"
 #include "util/OrientImage.h"
 #include <QImageReader>
 #include <QBuffer>
+#include <algorithm>
 
 namespace photoboss {
 
-std::optional<QImage> ImageLoader::load(const DiskReadResult &item, int targetSize) const {
+std::optional<QImage> ImageLoader::load(const DiskReadResult &item, int targetSize, Decode mode,
+                                        FileFailure *failure) const {
     const FileIdentity &fi = item.fileIdentity;
     int size = targetSize > 0 ? targetSize : settings::HashSampleSize;
-    QBuffer buf(const_cast<QByteArray*>(&item.imageBytes));
-    buf.open(QIODevice::ReadOnly);
-    QImageReader reader(&buf);
-    reader.setScaledSize(QSize(size, size));
-    QImage img = reader.read();
+
+    QImage img;
+    if (JpegDecoder::isJpeg(item.imageBytes)) {
+        const auto output = mode == Decode::Luma ? JpegDecoder::Output::Luma : JpegDecoder::Output::Colour;
+        if (auto decoded = JpegDecoder::decode(item.imageBytes, size, output))
+            img = std::move(*decoded);
+    }
+
+    // Other formats, and JPEGs libjpeg rejects (CMYK, damaged streams)
+    bool unsupported = false;
     if (img.isNull()) {
+        QBuffer buf(const_cast<QByteArray*>(&item.imageBytes));
+        buf.open(QIODevice::ReadOnly);
+        QImageReader reader(&buf);
+        QSize scaledSize = reader.size();
+        if (scaledSize.isValid() && std::max(scaledSize.width(), scaledSize.height()) > size) {
+            scaledSize.scale(size, size, Qt::KeepAspectRatio);
+            reader.setScaledSize(scaledSize);
+        }
+        img = reader.read();
+        unsupported = img.isNull() && reader.error() == QImageReader::UnsupportedFormatError;
+    }
+    if (img.isNull()) {
+        if (failure)
+            *failure = unsupported ? FileFailure::Unsupported : FileFailure::Undecodable;
         return std::nullopt;
     }
+    const bool luma = img.format() == QImage::Format_Grayscale8;
     int orientation = fi.exif().orientation.value_or(1);
     img = OrientImage(img, orientation);
+    // Transposing orientations may come back as ARGB; keep the luma contract
+    if (luma && img.format() != QImage::Format_Grayscale8) {
+        img = img.convertToFormat(QImage::Format_Grayscale8);
+    }
     return img;
 }
 
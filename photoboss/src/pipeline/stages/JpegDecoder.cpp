@@ -0,0 +1,196 @@
+#include "pipeline/stages/JpegDecoder.h"
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>
+#include <jpeglib.h>
+
+namespace photoboss {
+
+namespace {
+
+    // libjpeg reports fatal errors through error_exit, which must not
+    // return. Jump back to decodeInto() instead of aborting the process.
+    struct ErrorManager {
+        jpeg_error_mgr base;
+        std::jmp_buf jump;
+    };
+
+    void onError(j_common_ptr cinfo)
+    {
+        std::longjmp(reinterpret_cast<ErrorManager*>(cinfo->err)->jump, 1);
+    }
+
+    void onMessage(j_common_ptr)
+    {
+        // Corrupt-data warnings are expected on real-world photos; stay quiet.
+    }
+
+    // All libjpeg calls live in this frame together with the setjmp, and the
+    // frame holds no objects with destructors, so a longjmp skips nothing.
+    bool decodeInto(jpeg_decompress_struct& cinfo, ErrorManager& err,
+        const QByteArray& bytes, int minLongSide, JpegDecoder::Output output, QImage& out)
+    {
+        if (setjmp(err.jump))
+            return false;
+
+        jpeg_mem_src(&cinfo, reinterpret_cast<const unsigned char*>(bytes.constData()),
+            static_cast<unsigned long>(bytes.size()));
+        if (jpeg_read_header(&cinfo, TRUE) != JPEG_HEADER_OK)
+            return false;
+
+        const int longSide = static_cast<int>(std::max(cinfo.image_width, cinfo.image_height));
+        cinfo.scale_num = 1;
+        cinfo.scale_denom = static_cast<unsigned int>(JpegDecoder::scaleDenominator(longSide, minLongSide));
+        // BGRX matches QImage::Format_RGB32 (0xffRRGGBB) on little-endian
+        cinfo.out_color_space = output == JpegDecoder::Output::Luma ? JCS_GRAYSCALE : JCS_EXT_BGRX;
+        cinfo.dct_method = JDCT_ISLOW;
+
+        jpeg_start_decompress(&cinfo);
+
+        out = QImage(static_cast<int>(cinfo.output_width), static_cast<int>(cinfo.output_height),
+            output == JpegDecoder::Output::Luma ? QImage::Format_Grayscale8 : QImage::Format_RGB32);
+        if (out.isNull())
+            return false;
+
+        while (cinfo.output_scanline < cinfo.output_height) {
+            JSAMPROW row = out.scanLine(static_cast<int>(cinfo.output_scanline));
+            jpeg_read_scanlines(&cinfo, &row, 1);
+        }
+
+        jpeg_finish_decompress(&cinfo);
+        return true;
+    }
+
+} // namespace
+
+bool JpegDecoder::isJpeg(const QByteArray& bytes)
+{
+    return bytes.size() > 3
+        && static_cast<unsigned char>(bytes[0]) == 0xFF
+        && static_cast<unsigned char>(bytes[1]) == 0xD8
+        && static_cast<unsigned char>(bytes[2]) == 0xFF;
+}
+
+int JpegDecoder::scaleDenominator(int longSide, int minLongSide)
+{
+    // libjpeg rounds scaled dimensions up
+    for (int denom : { 8, 4, 2 }) {
+        if ((longSide + denom - 1) / denom >= minLongSide)
+            return denom;
+    }
+    return 1;
+}
+
+int JpegDecoder::estimateQuality(const QByteArray& bytes)
+{
+    // Annex K luminance table, the one cjpeg / libjpeg scale by quality
+    static constexpr int StandardLuma[64] = {
+        16, 11, 10, 16, 24, 40, 51, 61,
+        12, 12, 14, 19, 26, 58, 60, 55,
+        14, 13, 16, 24, 40, 57, 69, 56,
+        14, 17, 22, 29, 51, 87, 80, 62,
+        18, 22, 37, 56, 68, 109, 103, 77,
+        24, 35, 55, 64, 81, 104, 113, 92,
+        49, 64, 78, 87, 103, 121, 120, 101,
+        72, 92, 95, 98, 112, 100, 103, 99
+    };
+    // DQT entries come in zigzag order; natural index of each
+    static constexpr int ZigzagToNatural[64] = {
+        0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+        12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+        35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+        58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+    };
+
+    if (!isJpeg(bytes))
+        return 0;
+
+    const auto* data = reinterpret_cast<const unsigned char*>(bytes.constData());
+    const qsizetype size = bytes.size();
+    qsizetype pos = 2;
+
+    while (pos + 4 <= size) {
+        if (data[pos] != 0xFF)
+            return 0;
+        const unsigned char marker = data[pos + 1];
+        if (marker == 0xFF) {   // fill byte
+            ++pos;
+            continue;
+        }
+        if (marker == 0xDA || marker == 0xD9)   // SOS / EOI: no tables after this
+            return 0;
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {   // no payload
+            pos += 2;
+            continue;
+        }
+
+        const int length = (data[pos + 2] << 8) | data[pos + 3];
+        const qsizetype end = pos + 2 + length;
+        if (length < 2 || end > size)
+            return 0;
+
+        if (marker == 0xDB) {
+            // One or more tables: Pq/Tq byte, then 64 entries of 8 or 16 bits
+            qsizetype t = pos + 4;
+            while (t < end) {
+                const int precision = data[t] >> 4;
+                const int id = data[t] & 0x0F;
+                const int entryBytes = precision ? 2 : 1;
+                if (t + 1 + 64 * entryBytes > end)
+                    return 0;
+
+                if (id == 0) {
+                    // The scaled table is StandardLuma * scale / 100 clamped to
+                    // [1, max], so the ratio of sums over the unclamped entries
+                    // recovers the IJG scale factor
+                    const int maxEntry = precision ? 32767 : 255;
+                    qint64 sum = 0;
+                    qint64 standard = 0;
+                    int floored = 0;
+                    for (int i = 0; i < 64; ++i) {
+                        const unsigned char* entry = data + t + 1 + i * entryBytes;
+                        const int value = precision ? (entry[0] << 8) | entry[1] : entry[0];
+                        if (value <= 1) {
+                            ++floored;
+                        } else if (value < maxEntry) {
+                            sum += value;
+                            standard += StandardLuma[ZigzagToNatural[i]];
+                        }
+                    }
+                    if (standard == 0)
+                        return floored ? 100 : 1;
+
+                    const double scale = 100.0 * double(sum) / double(standard);
+                    const double quality = scale <= 100.0 ? (200.0 - scale) / 2.0 : 5000.0 / scale;
+                    return std::clamp(static_cast<int>(quality + 0.5), 1, 100);
+                }
+                t += 1 + 64 * entryBytes;
+            }
+        }
+        pos = end;
+    }
+    return 0;
+}
+
+std::optional<QImage> JpegDecoder::decode(const QByteArray& bytes, int minLongSide, Output output)
+{
+    if (!isJpeg(bytes))
+        return std::nullopt;
+
+    jpeg_decompress_struct cinfo;
+    ErrorManager err;
+    cinfo.err = jpeg_std_error(&err.base);
+    err.base.error_exit = onError;
+    err.base.output_message = onMessage;
+    jpeg_create_decompress(&cinfo);
+
+    QImage img;
+    const bool ok = decodeInto(cinfo, err, bytes, minLongSide, output, img);
+    jpeg_destroy_decompress(&cinfo);
+
+    if (!ok || img.isNull())
+        return std::nullopt;
+    return img;
+}
+
+} // namespace photoboss
@@ -3,13 +3,22 @@
 #include "pipeline/SimilarityEngine.h"
 #include "util/AppSettings.h"
 #include "util/ScopedTimer.h"
+#include <QDebug>
 #include <QElapsedTimer>
+#include <atomic>
+#include <thread>
 
 namespace photoboss {
     ResultProcessor::ResultProcessor(Queue<std::shared_ptr<HashedImageResult>>& queue,
         Queue<ThumbnailRequestPtr>& thumbnailQueue,
+        bool batch,
+        int threads,
+        QString indexPath,
         QObject* parent) :
         StageBase(parent),
+        m_batch_(batch),
+        m_threads_(std::max(threads, 1)),
+        m_indexPath_(std::move(indexPath)),
         m_input_(queue),
         m_thumbnailOutput_(thumbnailQueue),
         m_items_()
@@ -18,78 +27,117 @@ namespace photoboss {
     }
 
     void ResultProcessor::doRun() {
-        SimilarityEngine engine;
-        std::shared_ptr<HashedImageResult> item;
+        SimilarityEngine::Config cfg;
+        cfg.concurrent = !m_batch_ && m_threads_ > 1;
+        SimilarityEngine engine(cfg);
 
-        int processedCount = 0;
-        bool firstEmit = false;
+        // Files unchanged since the last scan of this root skip the probe.
+        // Batch mode regroups everything and only writes the index.
+        if (!m_indexPath_.isEmpty() && !m_batch_) {
+            SCOPED_TIMER("ResultProcessor::attach");
+            engine.attach(SimilarityIndexFile::open(m_indexPath_, engine.fingerprint()));
+        }
 
-        while (m_input_.wait_and_pop(item)) {
+        // Called by this thread and the helpers alike
+        const auto ingest = [&](std::shared_ptr<HashedImageResult> item) {
             SCOPED_TIMER("ResultProcessor");
-            Q_ASSERT(!item->hashes.empty());
+            const QString fullPath = item->fileIdentity.path() + "/" + item->fileIdentity.name();
 
-            if (!firstEmit) {
-                emit status(QString("Processing Hashed results..."));
-                firstEmit = true;
+            // Nothing to compare; reported at the end instead
+            if (item->failure != FileFailure::None) {
+                std::lock_guard lock(m_itemsMutex_);
+                m_failures_.files.push_back({ fullPath, item->failure });
+                return;
             }
+            Q_ASSERT(!item->digest.empty());
 
-            engine.addImage(item);
-            processedCount++;
-            emit incrementProgress(1);
-
-            QString fullPath = item->fileIdentity.path() + "/" + item->fileIdentity.name();
-            m_pathToItem_[fullPath] = item;
-            m_items_.push_back(std::move(item));
+            // Recorded first, so a group holding it finds its decoded image.
+            // The engine copies what it needs: in online mode nothing else
+            // of the result is kept.
+            {
+                std::lock_guard lock(m_itemsMutex_);
+                if (item->decodedImage) {
+                    m_decoded_.insert(fullPath, *item->decodedImage);
+                    item->decodedImage.reset();
+                }
+                if (m_batch_)
+                    m_items_.push_back(item);
+            }
+            // Batch mode groups once everything is in; nothing to show yet
+            if (!m_batch_)
+                engine.addImage(item);
+        };
 
-            auto delta = engine.getGroupDelta();
+        const auto emitDelta = [&](const SimilarityEngine::GroupDelta& delta) {
+            for (const auto& m : delta.merged)
+                emit groupMerged(m);
 
             for (const auto& g : delta.newlyFormed) {
                 emit groupAdded(g);
-                m_emittedGroups_.insert(g.id);
-                m_emittedSizes_[g.id] = static_cast<int>(g.images.size());
                 for (const auto& img : g.images) {
-                    if (!m_thumbnailRequested_.contains(img.path)) {
-                        auto thumbReq = std::make_shared<ThumbnailRequest>();
-                        thumbReq->path = img.path;
-                        thumbReq->rotation = img.rotation;
-                        thumbReq->width = settings::ThumbnailWidth;
-                        thumbReq->height = settings::ThumbnailWidth;
-                        auto srcIt = m_pathToItem_.find(img.path);
-                        if (srcIt != m_pathToItem_.end()) {
-                            thumbReq->preDecoded = srcIt.value()->decodedImage;
-                            thumbReq->fileIdentity.emplace(srcIt.value()->fileIdentity);
-                        }
-                        m_thumbnailOutput_.push(std::move(thumbReq));
-                        m_thumbnailRequested_.insert(img.path);
-                    }
+                    requestThumbnail(img);
                 }
             }
 
             for (const auto& g : delta.grown) {
-                emit groupUpdated(g);
-                int prevSize = m_emittedSizes_[g.id];
-                m_emittedSizes_[g.id] = static_cast<int>(g.images.size());
-                int newSize = static_cast<int>(g.images.size());
-                for (int i = prevSize; i < newSize; i++) {
-                    const auto& img = g.images[i];
-                    if (!m_thumbnailRequested_.contains(img.path)) {
-                        auto thumbReq = std::make_shared<ThumbnailRequest>();
-                        thumbReq->path = img.path;
-                        thumbReq->rotation = img.rotation;
-                        thumbReq->width = settings::ThumbnailWidth;
-                        thumbReq->height = settings::ThumbnailWidth;
-                        auto srcIt = m_pathToItem_.find(img.path);
-                        if (srcIt != m_pathToItem_.end()) {
-                            thumbReq->preDecoded = srcIt.value()->decodedImage;
-                            thumbReq->fileIdentity.emplace(srcIt.value()->fileIdentity);
-                        }
-                        m_thumbnailOutput_.push(std::move(thumbReq));
-                        m_thumbnailRequested_.insert(img.path);
-                    }
+                emit groupGrown(g);
+                for (const auto& img : g.added) {
+                    requestThumbnail(img);
                 }
             }
+        };
+
+        // Helpers only feed the engine; progress, deltas and thumbnails
+        // stay on this thread
+        std::atomic<int> helperProgress{ 0 };
+        std::vector<std::thread> helpers;
+        for (int t = 1; t < m_threads_ && cfg.concurrent; ++t) {
+            helpers.emplace_back([&] {
+                std::shared_ptr<HashedImageResult> next;
+                while (m_input_.wait_and_pop(next)) {
+                    ingest(std::move(next));
+                    helperProgress.fetch_add(1, std::memory_order_relaxed);
+                }
+            });
+        }
+
+        std::shared_ptr<HashedImageResult> item;
+        bool firstEmit = false;
+
+        while (m_input_.wait_and_pop(item)) {
+            if (!firstEmit) {
+                emit status(QString("Processing Hashed results..."));
+                firstEmit = true;
+            }
+
+            ingest(std::move(item));
+            emit incrementProgress(1 + helperProgress.exchange(0, std::memory_order_relaxed));
+
+            if (!m_batch_)
+                emitDelta(engine.getGroupDelta());
+        }
+
+        for (std::thread& helper : helpers)
+            helper.join();
+        if (const int rest = helperProgress.exchange(0))
+            emit incrementProgress(rest);
+        if (!m_batch_)
+            emitDelta(engine.getGroupDelta());
+
+        if (m_batch_ && !m_items_.empty()) {
+            emit status(QString("Grouping %1 images...").arg(m_items_.size()));
+            engine.addBatch(m_items_);
+            m_items_ = {};
+            for (const auto& g : engine.getGroupDelta().newlyFormed) {
+                emit groupAdded(g);
+                for (const auto& img : g.images)
+                    requestThumbnail(img);
+            }
         }
 
+        if (const size_t images = engine.imageCount())
+            qDebug() << "SimilarityEngine:" << engine.memoryUsage() / images << "bytes per image over" << images << "images";
+
         emit status(QString("Compiling final groups..."));
         auto groups = engine.getGroups();
         std::vector<ImageGroup> result;
@@ -98,11 +146,47 @@ namespace photoboss {
                 result.push_back(g);
             }
         }
-emit groupingFinished(result);
+        if (!m_failures_.files.empty()) {
+            emit failuresFound(m_failures_);
+        }
+        emit groupingFinished(result);
+
+        // A cancelled scan saves what it reached; the rest is probed as new
+        // next time
+        if (!m_indexPath_.isEmpty()) {
+            SCOPED_TIMER("ResultProcessor::save");
+            if (!engine.save(m_indexPath_))
+                qWarning() << "Could not write similarity index" << m_indexPath_;
+        }
         m_thumbnailOutput_.producer_done();
     }
- 
- 
+
+    void ResultProcessor::requestThumbnail(const ImageEntry& img)
+    {
+        if (m_thumbnailRequested_.contains(img.path))
+            return;
+
+        auto thumbReq = std::make_shared<ThumbnailRequest>();
+        thumbReq->path = img.path;
+        thumbReq->rotation = img.rotation;
+        thumbReq->width = settings::ThumbnailWidth;
+        thumbReq->height = settings::ThumbnailWidth;
+        {
+            std::lock_guard lock(m_itemsMutex_);
+            auto decoded = m_decoded_.find(img.path);
+            if (decoded != m_decoded_.end()) {
+                thumbReq->preDecoded = decoded.value();
+                m_decoded_.erase(decoded);
+            }
+        }
+        // The thumbnail cache keys on name, directory, size and time
+        const qsizetype slash = img.path.lastIndexOf('/');
+        thumbReq->fileIdentity.emplace(img.path.mid(slash + 1), img.path.left(slash), img.format,
+            img.fileSize, img.lastModified);
+        m_thumbnailOutput_.push(std::move(thumbReq));
+        m_thumbnailRequested_.insert(img.path);
+    }
+
     void ResultProcessor::onStop()
     {
         m_thumbnailOutput_.producer_done();
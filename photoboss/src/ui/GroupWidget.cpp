@@ -26,20 +26,24 @@ namespace photoboss {
 
         m_rootLayout_->addLayout(m_currentRow_);
 
-        updateGroup(group);
+        appendImages(group.images, 0, group.bestIndex);
 
         m_rootLayout_->addStretch(); // push content to top
     }
 
-    void GroupWidget::updateGroup(const ImageGroup& group)
+    void GroupWidget::addImages(const GroupGrowth& growth)
     {
-        m_header_->setText(tr("Group (%1 images)").arg(group.images.size()));
+        appendImages(growth.added, growth.firstIndex, growth.bestIndex);
+    }
 
+    void GroupWidget::appendImages(const std::vector<ImageEntry>& images, int firstIndex, int bestIndex)
+    {
         int oldCount = static_cast<int>(m_thumbs_.size());
+        Q_ASSERT(firstIndex <= oldCount);
 
         // Add any missing thumbs
-        for (int i = oldCount; i < static_cast<int>(group.images.size()); ++i) {
-            const auto& entry = group.images[i];
+        for (int i = oldCount; i < firstIndex + static_cast<int>(images.size()); ++i) {
+            const auto& entry = images[i - firstIndex];
             auto* thumb = new ImageThumbWidget(entry, this);
             m_thumbs_.push_back(thumb);
             m_thumbsByPath_[entry.path] = thumb;
@@ -59,23 +63,25 @@ namespace photoboss {
             m_currentRow_->addWidget(thumb);
         }
 
-        if (m_userModified_) {
-            // User has manually changed selections — only set defaults for newly added thumbs
-            for (int i = oldCount; i < m_thumbs_.size(); ++i) {
-                if (i == group.bestIndex)
-                    m_thumbs_[i]->setState(ImageThumbWidget::State::Keep);
-                else
-                    m_thumbs_[i]->setState(ImageThumbWidget::State::Delete);
-            }
-        } else {
-            // Pipeline mode: keep all thumb states in sync with bestIndex
-            for (int i = 0; i < m_thumbs_.size(); ++i) {
-                if (i == group.bestIndex)
-                    m_thumbs_[i]->setState(ImageThumbWidget::State::Keep);
-                else
-                    m_thumbs_[i]->setState(ImageThumbWidget::State::Delete);
-            }
+        m_header_->setText(tr("Group (%1 images)").arg(m_thumbs_.size()));
+
+        // Newly added thumbs get defaults either way
+        for (int i = oldCount; i < m_thumbs_.size(); ++i) {
+            if (i == bestIndex)
+                m_thumbs_[i]->setState(ImageThumbWidget::State::Keep);
+            else
+                m_thumbs_[i]->setState(ImageThumbWidget::State::Delete);
+        }
+
+        // Pipeline mode: the old best gives way when bestIndex moves. Every
+        // other thumb already matches, so only the two change.
+        if (!m_userModified_ && bestIndex != m_bestIndex_) {
+            if (m_bestIndex_ >= 0 && m_bestIndex_ < oldCount)
+                m_thumbs_[m_bestIndex_]->setState(ImageThumbWidget::State::Delete);
+            if (bestIndex >= 0 && bestIndex < oldCount)
+                m_thumbs_[bestIndex]->setState(ImageThumbWidget::State::Keep);
         }
+        m_bestIndex_ = bestIndex;
     }
 
     void GroupWidget::onThumbClicked(ImageThumbWidget* clicked)
@@ -114,18 +114,16 @@ void MainWindow::wireConnections()
             }
         }
         else if (state == Pipeline::PipelineState::Stopped) {
-            const QString folder = getCurrentFolder();
-            if (!folder.isEmpty()) {
-                m_pipeline_controller_->uiQueue()->reset();
-                clearResults();
-                for (auto* widget : m_phase_indicators_) {
-                    widget->prepareForScan();
-                }
-                m_pipeline_controller_->start({ folder, m_ui_->subfolders->isChecked() });
-            }
+            startScan(false);
         }
     });
 
+    // Groups only once every image is hashed, so nothing shows until then
+    connect(m_ui_->actionRegroup, &QAction::triggered, this, [this]() {
+        if (m_pipeline_controller_->state() == Pipeline::PipelineState::Stopped)
+            startScan(true);
+    });
+
     connect(m_pipeline_controller_->uiQueue(), &UiUpdateQueue::snapshotReady,
             this, &MainWindow::applySnapshot, Qt::QueuedConnection);
 
@@ -159,16 +157,18 @@ void MainWindow::applySnapshot(const UiSnapshot& snap)
 {
     m_lastSnapshot_ = snap;
 
+    // Each pending group in turn: growth applies on top of what was added
     int processed = 0;
-    while (!snap.pendingGroups.empty() && processed < settings::MainWindowBatchProcessSize) {
-        m_thumbnailManager_->processPendingGroup(snap.pendingGroups.front());
+    while (processed < static_cast<int>(snap.pendingGroups.size()) && processed < settings::MainWindowBatchProcessSize) {
+        m_thumbnailManager_->processPendingGroup(snap.pendingGroups[processed]);
         ++processed;
     }
     if (processed > 0) {
         m_pipeline_controller_->uiQueue()->commitProcessed(processed);
     }
 
-    m_thumbnailManager_->processUpdatedGroups(snap.updatedGroups);
+    m_thumbnailManager_->processGrownGroups(snap.grownGroups);
+    m_thumbnailManager_->removeGroups(snap.removedGroups);
     m_thumbnailManager_->distributeThumbnails(snap.thumbnailCache);
 
     updatePhaseProgress(snap);
@@ -217,6 +217,22 @@ void MainWindow::updatePhaseProgress(const UiSnapshot& snap)
     }
 }
 
+void MainWindow::startScan(bool batchGrouping)
+{
+    const QString folder = getCurrentFolder();
+    if (folder.isEmpty())
+        return;
+
+    m_pipeline_controller_->uiQueue()->reset();
+    clearResults();
+    for (auto* widget : m_phase_indicators_) {
+        widget->prepareForScan();
+    }
+    ScanRequest request(folder, m_ui_->subfolders->isChecked());
+    request.batchGrouping = batchGrouping;
+    m_pipeline_controller_->start(request);
+}
+
 void MainWindow::clearResults()
 {
     m_thumbnailManager_->clearResults();
@@ -230,6 +246,7 @@ void MainWindow::onPipelineStateChanged(Pipeline::PipelineState state)
         m_scan_button_->setText(tr("Stop Scan"));
         m_scan_button_->setEnabled(true);
         m_browse_button_->setEnabled(false);
+        m_ui_->actionRegroup->setEnabled(false);
         m_btn_delete_->setVisible(false);
         break;
 
@@ -243,13 +260,30 @@ void MainWindow::onPipelineStateChanged(Pipeline::PipelineState state)
         m_scan_button_->setText(tr("Start Scan"));
         m_scan_button_->setEnabled(true);
         m_browse_button_->setEnabled(true);
-
-        if (m_thumbnailManager_->foundDuplicates()) {
-            m_status_bar_->showMessage(
-                QString("%1 Duplicates found -- Scan Complete").arg(m_thumbnailManager_->groupCount()));
-        }
-        else {
-            m_status_bar_->showMessage("No duplicates found -- Scan Complete");
+        m_ui_->actionRegroup->setEnabled(true);
+
+        {
+            QString message = m_thumbnailManager_->foundDuplicates()
+                ? QString("%1 Duplicates found -- Scan Complete").arg(m_thumbnailManager_->groupCount())
+                : QString("No duplicates found -- Scan Complete");
+
+            const FailureSummary& failures = m_lastSnapshot_.failures;
+            QString details;
+            if (!failures.files.empty()) {
+                message += QString(" -- %1 file(s) skipped (%2 unreadable, %3 damaged, %4 unsupported)")
+                    .arg(failures.files.size())
+                    .arg(failures.count(FileFailure::Unreadable))
+                    .arg(failures.count(FileFailure::Undecodable))
+                    .arg(failures.count(FileFailure::Unsupported));
+
+                constexpr int MaxListed = 20;
+                for (int i = 0; i < static_cast<int>(failures.files.size()) && i < MaxListed; ++i)
+                    details += (i ? "\n" : "") + failures.files[i].path;
+                if (static_cast<int>(failures.files.size()) > MaxListed)
+                    details += QString("\n... and %1 more").arg(failures.files.size() - MaxListed);
+            }
+            m_status_bar_->showMessage(message);
+            m_status_bar_->setToolTip(details);
         }
 
         updateDeleteButtonState();
@@ -41,7 +41,7 @@ QWidget* ThumbnailManager::rootWidget() const
 
 void ThumbnailManager::processPendingGroup(const ImageGroup& group)
 {
-    if (m_groupWidgets_.contains(group.id))
+    if (m_groupWidgets_.contains(group.id) || m_retiredGroupIds_.contains(group.id))
         return;
 
     auto* widget = new GroupWidget(group, m_container_);
@@ -60,36 +60,75 @@ void ThumbnailManager::processPendingGroup(const ImageGroup& group)
     }
 
     connect(widget, &GroupWidget::previewImage, m_previewPane_, &PreviewPane::showImage);
+
+    // Growth that arrived while the group was still pending
+    auto deferred = m_deferredGrowth_.find(group.id);
+    if (deferred != m_deferredGrowth_.end()) {
+        applyGrowth(widget, deferred.value());
+        m_deferredGrowth_.erase(deferred);
+    }
 }
 
-void ThumbnailManager::processUpdatedGroups(const QMap<quint64, ImageGroup>& updatedGroups)
+void ThumbnailManager::processGrownGroups(const QMap<quint64, GroupGrowth>& grownGroups)
 {
-    for (auto it = updatedGroups.constBegin(); it != updatedGroups.constEnd(); ++it) {
+    for (auto it = grownGroups.constBegin(); it != grownGroups.constEnd(); ++it) {
         quint64 id = it.key();
-        const ImageGroup& group = it.value();
-        if (!m_groupWidgets_.contains(id))
+        const GroupGrowth& growth = it.value();
+        if (m_retiredGroupIds_.contains(id))
+            continue;
+
+        if (GroupWidget* widget = m_groupWidgets_.value(id)) {
+            applyGrowth(widget, growth);
+            continue;
+        }
+
+        auto deferred = m_deferredGrowth_.find(id);
+        if (deferred == m_deferredGrowth_.end()) {
+            m_deferredGrowth_.insert(id, growth);
+        } else {
+            deferred.value().added.insert(deferred.value().added.end(), growth.added.begin(), growth.added.end());
+            deferred.value().bestIndex = growth.bestIndex;
+        }
+    }
+}
+
+void ThumbnailManager::applyGrowth(GroupWidget* widget, const GroupGrowth& growth)
+{
+    widget->addImages(growth);
+
+    // Only the new thumbs can be waiting for a pixmap
+    const auto& thumbsByPath = widget->thumbsByPath();
+    for (const auto& entry : growth.added) {
+        auto* thumb = thumbsByPath.value(entry.path);
+        if (thumb)
+            assignThumbnailToWidget(entry.path, thumb);
+    }
+}
+
+void ThumbnailManager::removeGroups(const QSet<quint64>& ids)
+{
+    bool removed = false;
+    for (quint64 id : ids) {
+        m_retiredGroupIds_.insert(id);
+        m_deferredGrowth_.remove(id);
+        GroupWidget* widget = m_groupWidgets_.take(id);
+        if (!widget)
             continue;
 
-        m_groupWidgets_[id]->updateGroup(group);
-        auto* widget = m_groupWidgets_[id];
-
-        for (const auto& entry : group.images) {
-            bool alreadyWaiting = false;
-            auto waiters = m_thumbnailWaiters_.values(entry.path);
-            for (auto* w : waiters) {
-                if (w->parentWidget() == widget) {
-                    alreadyWaiting = true;
-                    break;
-                }
-            }
-            if (!alreadyWaiting) {
-                const auto& thumbsByPath = widget->thumbsByPath();
-                auto* thumb = thumbsByPath.value(entry.path);
-                if (thumb)
-                    assignThumbnailToWidget(entry.path, thumb);
-            }
+        for (auto it = m_thumbnailWaiters_.begin(); it != m_thumbnailWaiters_.end();) {
+            if (it.value()->parentWidget() == widget)
+                it = m_thumbnailWaiters_.erase(it);
+            else
+                ++it;
         }
+        m_layout_->removeWidget(widget);
+        widget->deleteLater();
+        removed = true;
     }
+
+    // Its selected images went with it
+    if (removed)
+        emit selectionChanged();
 }
 
 void ThumbnailManager::distributeThumbnails(const QMap<QString, QPixmap>& thumbnails)
@@ -112,6 +151,8 @@ void ThumbnailManager::clearResults()
         delete item;
     }
     m_groupWidgets_.clear();
+    m_retiredGroupIds_.clear();
+    m_deferredGrowth_.clear();
     m_thumbnailWaiters_.clear();
     m_thumbnailCache_.clear();
     m_scanFoundDuplicates_ = false;
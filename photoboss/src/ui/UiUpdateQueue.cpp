@@ -17,12 +17,13 @@ void UiUpdateQueue::reset()
 {
     QMutexLocker lock(&m_mutex);
     m_pendingGroups.clear();
-    m_updatedGroups.clear();
-    m_modifiedGroupIds_.clear();
+    m_grownGroups_.clear();
+    m_removedGroupIds_.clear();
     m_thumbnailCache.clear();
     m_thumbnailWaiters.clear();
     m_phaseProgress.clear();
     m_statusMessage.clear();
+    m_failures = {};
     m_pipelineState = Pipeline::PipelineState::Stopped;
     m_totalFiles = 0;
     m_dirty = true;
@@ -49,11 +50,31 @@ void UiUpdateQueue::addPendingGroup(const ImageGroup& group)
     scheduleSnapshotEmit();
 }
 
-void UiUpdateQueue::updateGroup(const ImageGroup& group)
+void UiUpdateQueue::growGroup(const GroupGrowth& growth)
 {
+    // Growth between two snapshots reaches the UI as one
     QMutexLocker lock(&m_mutex);
-    m_updatedGroups[group.id] = group;
-    m_modifiedGroupIds_.insert(group.id);
+    auto it = m_grownGroups_.find(growth.id);
+    if (it == m_grownGroups_.end()) {
+        m_grownGroups_.insert(growth.id, growth);
+    } else {
+        GroupGrowth& pending = it.value();
+        pending.added.insert(pending.added.end(), growth.added.begin(), growth.added.end());
+        pending.bestIndex = growth.bestIndex;
+    }
+    m_dirty = true;
+    lock.unlock();
+    scheduleSnapshotEmit();
+}
+
+void UiUpdateQueue::mergeGroup(const GroupMerge& merge)
+{
+    // The survivor comes through addPendingGroup() / growGroup(); the
+    // absorbed group may still sit in m_pendingGroups, which only
+    // commitProcessed() trims, so the UI drops it by id instead
+    QMutexLocker lock(&m_mutex);
+    m_grownGroups_.remove(merge.absorbed);
+    m_removedGroupIds_.insert(merge.absorbed);
     m_dirty = true;
     lock.unlock();
     scheduleSnapshotEmit();
@@ -121,21 +142,29 @@ void UiUpdateQueue::setPipelineState(Pipeline::PipelineState state)
     scheduleSnapshotEmit();
 }
 
+void UiUpdateQueue::setFailures(const FailureSummary& failures)
+{
+    QMutexLocker lock(&m_mutex);
+    m_failures = failures;
+    m_dirty = true;
+    lock.unlock();
+    scheduleSnapshotEmit();
+}
+
 UiSnapshot UiUpdateQueue::snapshot()
 {
     QMutexLocker lock(&m_mutex);
     UiSnapshot snap;
     snap.pendingGroups = m_pendingGroups;
-    for (quint64 id : m_modifiedGroupIds_) {
-        auto it = m_updatedGroups.find(id);
-        if (it != m_updatedGroups.end())
-            snap.updatedGroups.insert(id, it.value());
-    }
-    m_modifiedGroupIds_.clear();
+    snap.grownGroups = std::move(m_grownGroups_);
+    m_grownGroups_.clear();
+    snap.removedGroups = m_removedGroupIds_;
+    m_removedGroupIds_.clear();
     snap.thumbnailCache = m_thumbnailCache;
     snap.thumbnailWaiters = m_thumbnailWaiters;
     snap.phaseProgress = m_phaseProgress;
     snap.statusMessage = m_statusMessage;
+    snap.failures = m_failures;
     snap.pipelineState = m_pipelineState;
     return snap;
 }
@@ -0,0 +1,81 @@
+#include "util/CpuFeatures.h"
+
+#if defined(PHOTOBOSS_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace photoboss {
+
+#if defined(PHOTOBOSS_X86)
+    static void cpuid(int leaf, int subleaf, unsigned regs[4])
+    {
+#if defined(_MSC_VER)
+        int r[4];
+        __cpuidex(r, leaf, subleaf);
+        for (int i = 0; i < 4; ++i) regs[i] = static_cast<unsigned>(r[i]);
+#else
+        __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    }
+
+    // XCR0 tells us which register files the OS saves on context switch.
+    static unsigned long long xgetbv0()
+    {
+#if defined(_MSC_VER)
+        return _xgetbv(0);
+#else
+        unsigned lo, hi;
+        __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        return (static_cast<unsigned long long>(hi) << 32) | lo;
+#endif
+    }
+
+    static CpuFeatures detect()
+    {
+        CpuFeatures f;
+        unsigned regs[4] = {};
+
+        cpuid(0, 0, regs);
+        const unsigned maxLeaf = regs[0];
+
+        cpuid(1, 0, regs);
+        const bool osxsave = (regs[2] & (1u << 27)) != 0;
+        const bool avx = (regs[2] & (1u << 28)) != 0;
+        const unsigned long long xcr0 = osxsave ? xgetbv0() : 0;
+        const bool ymmEnabled = (xcr0 & 0x6) == 0x6;
+        // opmask, upper ZMM0-15 and ZMM16-31 state as well
+        const bool zmmEnabled = (xcr0 & 0xE6) == 0xE6;
+
+        if (maxLeaf >= 7) {
+            cpuid(7, 0, regs);
+            f.avx2 = avx && ymmEnabled && (regs[1] & (1u << 5)) != 0;
+            f.sha = (regs[1] & (1u << 29)) != 0;
+            f.avx512popcnt = f.avx2 && zmmEnabled
+                && (regs[1] & (1u << 16)) != 0      // AVX512F
+                && (regs[2] & (1u << 14)) != 0;     // AVX512_VPOPCNTDQ
+        }
+        return f;
+    }
+#else
+    static CpuFeatures detect()
+    {
+        CpuFeatures f;
+#if defined(PHOTOBOSS_NEON)
+        // Advanced SIMD is mandatory on AArch64.
+        f.neon = true;
+#endif
+        return f;
+    }
+#endif
+
+    const CpuFeatures& CpuFeatures::get()
+    {
+        static const CpuFeatures features = detect();
+        return features;
+    }
+
+}